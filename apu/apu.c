@@ -0,0 +1,688 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// Local libraries
+#include "apu.h"
+#include "blep.h"
+#include "resampler.h"
+#include "../cpu/cpu-struct.h"
+#include "../cpu/memorybus.h"
+#include "../cpu/scheduler.h"
+
+
+// --  Helpers  --
+
+// Which of the 8 steps of each duty cycle are high, first step in bit 7
+static const uint8_t duty_patterns[4] = {0x01, 0x81, 0x87, 0x7E};
+
+// The noise channel's base periods, picked by the bottom 3 bits of NR43
+static const uint8_t noise_divisors[8] = {8, 16, 32, 48, 64, 80, 96, 112};
+
+// What the registers read back as: bits that don't exist (or can only be written) read as 1
+static const uint8_t read_masks[APU_REGISTER_COUNT] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,       // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,       // (nothing), NR21-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,       // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,       // (nothing), NR41-NR44
+    0x00, 0x00, 0x70,                   // NR50-NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    // Wave RAM
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+// Samples get mixed this many at a time
+#define MIX_CHUNK 256
+
+static inline uint8_t *reg (apu *self, uint16_t address) {
+    return &self->registers[address - APU_FIRST_REGISTER];
+}
+
+// Each channel's 5 registers start here (NRx0)
+static inline uint16_t channel_base (ApuChannel index) {
+    return NR10_ADDRESS + index * 5;
+}
+
+// What a channel's putting out right now, 0-15
+static uint8_t channel_level (apu *self, ApuChannel index) {
+
+    channel *ch = &self->channels[index];
+
+    if (!ch->enabled || !ch->dac_enabled) {
+        return 0;
+    }
+
+    switch (index) {
+        case CHANNEL_SQUARE1:
+        case CHANNEL_SQUARE2:
+            return ((duty_patterns[ch->duty] >> (7 - ch->position)) & 1) ? ch->volume : 0;
+        case CHANNEL_WAVE: {
+            uint8_t sample = *reg(self, WAVE_RAM_ADDRESS + ch->position / 2);
+            sample = (ch->position & 1) ? (sample & 0x0F) : (sample >> 4);
+            return sample >> ch->wave_shift;
+        }
+        default:
+            return (~ch->lfsr & 1) ? ch->volume : 0;
+    }
+
+}
+
+// Something about a channel changed at time, so if its output did too, that's a step
+static void update_output (apu *self, ApuChannel index, uint64_t time) {
+
+    channel *ch = &self->channels[index];
+
+    if (!self->audio) {
+        return;
+    }
+
+    uint8_t level = channel_level(self, index);
+    if (level != ch->level) {
+        blep_add_step(&ch->output, &self->kernel, time, ((float) level - ch->level) / 15.0f);
+        ch->level = level;
+    }
+
+}
+
+// How long each waveform step takes, going by the frequency registers (or NR43 for noise). 0 means it's stopped
+static void update_period (apu *self, ApuChannel index) {
+
+    channel *ch = &self->channels[index];
+
+    switch (index) {
+        case CHANNEL_SQUARE1:
+        case CHANNEL_SQUARE2:
+            ch->period = (2048 - ch->frequency) * 4;
+            break;
+        case CHANNEL_WAVE:
+            ch->period = (2048 - ch->frequency) * 2;
+            break;
+        default: {
+            uint8_t nr43 = *reg(self, NR43_ADDRESS);
+            // Shifts of 14 and 15 stop the shift register altogether
+            ch->period = ((nr43 >> 4) >= 14) ? 0 : (uint32_t) noise_divisors[nr43 & 0x07] << (nr43 >> 4);
+            break;
+        }
+    }
+
+}
+
+
+// --  Synthesis  --
+
+// Run a channel's waveform up to (but not including) until, one step at a time
+static void run_channel (apu *self, ApuChannel index, uint64_t until) {
+
+    channel *ch = &self->channels[index];
+
+    if (!ch->enabled || ch->period == 0) {
+        return;
+    }
+
+    bool narrow = *reg(self, NR43_ADDRESS) & 0x08;
+
+    while (ch->next_step < until) {
+
+        switch (index) {
+            case CHANNEL_SQUARE1:
+            case CHANNEL_SQUARE2:
+                ch->position = (ch->position + 1) & 7;
+                break;
+            case CHANNEL_WAVE:
+                ch->position = (ch->position + 1) & 31;
+                break;
+            default: {
+                uint16_t bit = (ch->lfsr ^ (ch->lfsr >> 1)) & 1;
+                ch->lfsr = (ch->lfsr >> 1) | (bit << 14);
+                if (narrow) {
+                    ch->lfsr = (ch->lfsr & ~0x40) | (bit << 6);
+                }
+                break;
+            }
+        }
+
+        update_output(self, index, ch->next_step);
+        ch->next_step += ch->period;
+    }
+
+}
+
+// Catch every channel up to now. If nobody's been reading samples and the buffers are about to fill up, the oldest
+// ones get thrown away first
+static void sync (apu *self, uint64_t now) {
+
+    if (now <= self->synced) {
+        return;
+    }
+
+    // Without audio the waveforms don't matter, just the time
+    if (!self->audio) {
+        self->synced = now;
+        return;
+    }
+
+    blep_buffer *first = &self->channels[0].output;
+    if (blep_samples_ready(first, now) >= BLEP_BUFFER_SIZE) {
+        uint32_t done = blep_samples_ready(first, self->synced);
+        for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+            blep_read(&self->channels[i].output, NULL, done);
+        }
+    }
+
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        run_channel(self, i, now);
+    }
+    self->synced = now;
+
+}
+
+
+// --  Frame sequencer  --
+
+// The frequency square 1's sweep wants to go to next. Going past 2047 shuts the channel off
+static uint16_t sweep_frequency (apu *self) {
+
+    channel *ch = &self->channels[CHANNEL_SQUARE1];
+    uint8_t nr10 = *reg(self, NR10_ADDRESS);
+    uint16_t delta = ch->shadow_frequency >> (nr10 & 0x07);
+    uint16_t frequency = (nr10 & 0x08) ? ch->shadow_frequency - delta : ch->shadow_frequency + delta;
+
+    if (frequency > 2047) {
+        ch->enabled = false;
+        update_output(self, CHANNEL_SQUARE1, self->synced);
+    }
+    return frequency;
+
+}
+
+static void clock_length (apu *self) {
+
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        channel *ch = &self->channels[i];
+        if (ch->length_enabled && ch->length > 0) {
+            ch->length -= 1;
+            if (ch->length == 0) {
+                ch->enabled = false;
+                update_output(self, i, self->synced);
+            }
+        }
+    }
+
+}
+
+static void clock_sweep (apu *self) {
+
+    channel *ch = &self->channels[CHANNEL_SQUARE1];
+    uint8_t nr10 = *reg(self, NR10_ADDRESS);
+    uint8_t period = (nr10 >> 4) & 0x07;
+
+    ch->sweep_timer -= 1;
+    if (ch->sweep_timer > 0) {
+        return;
+    }
+    ch->sweep_timer = (period != 0) ? period : 8;
+
+    if (!ch->sweep_enabled || period == 0) {
+        return;
+    }
+
+    uint16_t frequency = sweep_frequency(self);
+    if (frequency <= 2047 && (nr10 & 0x07) != 0) {
+        ch->shadow_frequency = frequency;
+        ch->frequency = frequency;
+        *reg(self, NR13_ADDRESS) = frequency & 0xFF;
+        *reg(self, NR14_ADDRESS) = (*reg(self, NR14_ADDRESS) & ~0x07) | (frequency >> 8);
+        update_period(self, CHANNEL_SQUARE1);
+        // And it checks again straight away, which can shut the channel off a step early
+        sweep_frequency(self);
+    }
+
+}
+
+static void clock_envelopes (apu *self) {
+
+    static const ApuChannel with_envelope[3] = {CHANNEL_SQUARE1, CHANNEL_SQUARE2, CHANNEL_NOISE};
+
+    for (uint8_t i = 0; i < 3; i++) {
+
+        channel *ch = &self->channels[with_envelope[i]];
+        if (ch->envelope_period == 0) {
+            continue;
+        }
+
+        ch->envelope_timer -= 1;
+        if (ch->envelope_timer > 0) {
+            continue;
+        }
+        ch->envelope_timer = ch->envelope_period;
+
+        if (ch->envelope_up && ch->volume < 15) {
+            ch->volume += 1;
+        } else if (!ch->envelope_up && ch->volume > 0) {
+            ch->volume -= 1;
+        }
+        update_output(self, with_envelope[i], self->synced);
+    }
+
+}
+
+// EVENT_APU_FRAME_SEQUENCER: length counters on every other tick, sweep on ticks 2 and 6, envelopes on tick 7
+static void sequencer_tick (void *context, uint64_t time) {
+
+    apu *self = context;
+    sync(self, time);
+
+    if (self->powered) {
+        if ((self->sequencer_step & 1) == 0) {
+            clock_length(self);
+        }
+        if (self->sequencer_step == 2 || self->sequencer_step == 6) {
+            clock_sweep(self);
+        }
+        if (self->sequencer_step == 7) {
+            clock_envelopes(self);
+        }
+    }
+    self->sequencer_step = (self->sequencer_step + 1) & 7;
+
+    schedule_event(&self->cpu->scheduler, EVENT_APU_FRAME_SEQUENCER, time + FRAME_SEQUENCER_CYCLES);
+
+}
+
+
+// --  Registers  --
+
+static void trigger (apu *self, ApuChannel index) {
+
+    channel *ch = &self->channels[index];
+    uint8_t envelope = *reg(self, channel_base(index) + 2);
+
+    ch->enabled = ch->dac_enabled;
+    if (ch->length == 0) {
+        ch->length = (index == CHANNEL_WAVE) ? 256 : 64;
+    }
+    ch->next_step = self->synced + ch->period;
+
+    if (index == CHANNEL_WAVE) {
+        ch->position = 0;
+    } else {
+        ch->volume = envelope >> 4;
+        ch->envelope_up = envelope & 0x08;
+        ch->envelope_period = envelope & 0x07;
+        ch->envelope_timer = (ch->envelope_period != 0) ? ch->envelope_period : 8;
+    }
+
+    if (index == CHANNEL_NOISE) {
+        ch->lfsr = 0x7FFF;
+    }
+
+    if (index == CHANNEL_SQUARE1) {
+        uint8_t nr10 = *reg(self, NR10_ADDRESS);
+        uint8_t period = (nr10 >> 4) & 0x07;
+        ch->shadow_frequency = ch->frequency;
+        ch->sweep_timer = (period != 0) ? period : 8;
+        ch->sweep_enabled = period != 0 || (nr10 & 0x07) != 0;
+        if (nr10 & 0x07) {
+            sweep_frequency(self);
+        }
+    }
+
+    update_output(self, index, self->synced);
+
+}
+
+// Turning the APU off clears every register (but not wave RAM), and nothing but NR52 can be written until it's on
+static void set_power (apu *self, bool powered) {
+
+    if (!powered) {
+        memset(self->registers, 0, WAVE_RAM_ADDRESS - APU_FIRST_REGISTER);
+        for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+            channel *ch = &self->channels[i];
+            ch->enabled = false;
+            ch->dac_enabled = false;
+            ch->length_enabled = false;
+            ch->length = 0;
+            ch->frequency = 0;
+            ch->duty = 0;
+            update_period(self, i);
+            update_output(self, i, self->synced);
+        }
+    } else if (!self->powered) {
+        self->sequencer_step = 0;
+    }
+    self->powered = powered;
+
+}
+
+static uint8_t apu_read (void *context, uint16_t address) {
+
+    apu *self = context;
+
+    if (address == NR52_ADDRESS) {
+        sync(self, self->cpu->cycles);
+        uint8_t status = self->powered ? 0x80 : 0x00;
+        for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+            status |= self->channels[i].enabled << i;
+        }
+        return status | read_masks[address - APU_FIRST_REGISTER];
+    }
+    return *reg(self, address) | read_masks[address - APU_FIRST_REGISTER];
+
+}
+
+static void apu_write (void *context, uint16_t address, uint8_t value) {
+
+    apu *self = context;
+    sync(self, self->cpu->cycles);
+
+    if (address >= WAVE_RAM_ADDRESS) {
+        *reg(self, address) = value;
+        return;
+    }
+    if (address == NR52_ADDRESS) {
+        set_power(self, value & 0x80);
+        return;
+    }
+    if (!self->powered) {
+        return;
+    }
+
+    *reg(self, address) = value;
+
+    // Which channel (if any) this belongs to, and which of its registers it is
+    uint8_t offset = address - APU_FIRST_REGISTER;
+    ApuChannel index = offset / 5;
+
+    if (index >= CHANNEL_COUNT) {
+        // NR50 and NR51 only matter when mixing
+        return;
+    }
+    channel *ch = &self->channels[index];
+
+    switch (offset % 5) {
+
+        // NR10 is read straight from the registers when sweeping, and NR30 turns the wave channel's DAC on and off
+        case 0:
+            if (index == CHANNEL_WAVE) {
+                ch->dac_enabled = value & 0x80;
+                if (!ch->dac_enabled) {
+                    ch->enabled = false;
+                }
+                update_output(self, index, self->synced);
+            }
+            break;
+
+        // Length, and the duty cycle for the squares
+        case 1:
+            if (index == CHANNEL_WAVE) {
+                ch->length = 256 - value;
+            } else {
+                ch->length = 64 - (value & 0x3F);
+            }
+            if (index <= CHANNEL_SQUARE2) {
+                ch->duty = value >> 6;
+                update_output(self, index, self->synced);
+            }
+            break;
+
+        // Envelope (which also decides whether the DAC is on), or the wave channel's volume
+        case 2:
+            if (index == CHANNEL_WAVE) {
+                static const uint8_t shifts[4] = {4, 0, 1, 2};
+                ch->wave_shift = shifts[(value >> 5) & 0x03];
+            } else {
+                ch->dac_enabled = (value & 0xF8) != 0;
+                if (!ch->dac_enabled) {
+                    ch->enabled = false;
+                }
+            }
+            update_output(self, index, self->synced);
+            break;
+
+        // Bottom 8 bits of the frequency, or the noise channel's clock
+        case 3:
+            if (index != CHANNEL_NOISE) {
+                ch->frequency = (ch->frequency & 0x700) | value;
+                update_period(self, index);
+            } else {
+                // The noise channel might've been stopped, so it starts counting again from here
+                update_period(self, index);
+                ch->next_step = self->synced + ch->period;
+            }
+            break;
+
+        // Top 3 bits of the frequency, length enable, and trigger
+        default:
+            if (index != CHANNEL_NOISE) {
+                ch->frequency = (ch->frequency & 0xFF) | ((value & 0x07) << 8);
+                update_period(self, index);
+            }
+            ch->length_enabled = value & 0x40;
+            if (value & 0x80) {
+                trigger(self, index);
+            }
+            break;
+    }
+
+}
+
+
+// --  Output  --
+
+void set_apu_audio (apu *self, bool audio) {
+
+    sync(self, self->cpu->cycles);
+    if (audio == self->audio) {
+        return;
+    }
+    self->audio = audio;
+
+    // Coming back on, the buffers start over from silence, and every waveform picks up from its start from here
+    if (audio) {
+        set_apu_output_rate(self, self->resampler.output_rate);
+        for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+            channel *ch = &self->channels[i];
+            init_blep_buffer(&ch->output, self->synced);
+            ch->level = 0;
+            ch->next_step = self->synced + ch->period;
+            update_output(self, i, self->synced);
+        }
+    }
+
+}
+
+void restart_apu_output (apu *self) {
+
+    if (!self->audio) {
+        return;
+    }
+
+    // The waveforms carry on from where they are, unless they're running and behind (from an APU that had audio
+    // off, where nothing stepped them)
+    clear_resampler(&self->resampler);
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        channel *ch = &self->channels[i];
+        init_blep_buffer(&ch->output, self->synced);
+        ch->level = 0;
+        if (ch->enabled && ch->period != 0 && ch->next_step < self->synced) {
+            ch->next_step = self->synced + ch->period;
+        }
+        update_output(self, i, self->synced);
+    }
+
+}
+
+void copy_apu (apu *to, const apu *from) {
+
+    if (from->audio) {
+        *to = *from;
+        return;
+    }
+
+    memcpy(to, from, offsetof(apu, channels));
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        memcpy(&to->channels[i], &from->channels[i], offsetof(channel, output));
+    }
+    to->resampler.output_rate = from->resampler.output_rate;
+
+}
+
+uint32_t apu_samples_ready (apu *self) {
+
+    sync(self, self->cpu->cycles);
+    if (!self->audio) {
+        return 0;
+    }
+    return blep_samples_ready(&self->channels[0].output, self->synced);
+
+}
+
+// Mix count samples of every channel into left and right (count is at most MIX_CHUNK). Master volume is 1-8 for
+// each side, and with all four channels flat out on both that's as loud as it gets, so that's 1
+static void mix_channels (apu *self, float *left, float *right, uint32_t count) {
+
+    uint8_t nr50 = *reg(self, NR50_ADDRESS);
+    uint8_t nr51 = *reg(self, NR51_ADDRESS);
+    float left_volume = (((nr50 >> 4) & 0x07) + 1) / 32.0f;
+    float right_volume = ((nr50 & 0x07) + 1) / 32.0f;
+
+    float samples[CHANNEL_COUNT][MIX_CHUNK] __attribute__((aligned(16)));
+    float left_gains[CHANNEL_COUNT];
+    float right_gains[CHANNEL_COUNT];
+
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        blep_read(&self->channels[i].output, samples[i], count);
+        left_gains[i] = ((nr51 >> (4 + i)) & 1) ? left_volume : 0;
+        right_gains[i] = ((nr51 >> i) & 1) ? right_volume : 0;
+    }
+
+    uint32_t s = 0;
+
+#if defined(__SSE2__)
+    __m128 left_gain[CHANNEL_COUNT];
+    __m128 right_gain[CHANNEL_COUNT];
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        left_gain[i] = _mm_set1_ps(left_gains[i]);
+        right_gain[i] = _mm_set1_ps(right_gains[i]);
+    }
+
+    for (; s + 4 <= count; s += 4) {
+        __m128 l = _mm_setzero_ps();
+        __m128 r = _mm_setzero_ps();
+        for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+            __m128 v = _mm_load_ps(samples[i] + s);
+            l = _mm_add_ps(l, _mm_mul_ps(v, left_gain[i]));
+            r = _mm_add_ps(r, _mm_mul_ps(v, right_gain[i]));
+        }
+        _mm_storeu_ps(left + s, l);
+        _mm_storeu_ps(right + s, r);
+    }
+#endif
+
+    for (; s < count; s++) {
+        left[s] = 0;
+        right[s] = 0;
+        for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+            left[s] += samples[i][s] * left_gains[i];
+            right[s] += samples[i][s] * right_gains[i];
+        }
+    }
+
+}
+
+uint32_t read_apu_samples (apu *self, int16_t *out, uint32_t count) {
+
+    uint32_t ready = apu_samples_ready(self);
+    if (count > ready) {
+        count = ready;
+    }
+
+    float left[MIX_CHUNK];
+    float right[MIX_CHUNK];
+
+    for (uint32_t done = 0; done < count; ) {
+
+        uint32_t chunk = (count - done < MIX_CHUNK) ? count - done : MIX_CHUNK;
+        mix_channels(self, left, right, chunk);
+
+        for (uint32_t s = 0; s < chunk; s++) {
+            out[(done + s) * 2] = (int16_t) (left[s] * 32767.0f);
+            out[(done + s) * 2 + 1] = (int16_t) (right[s] * 32767.0f);
+        }
+        done += chunk;
+    }
+
+    return count;
+
+}
+
+bool set_apu_output_rate (apu *self, uint32_t rate) {
+    if (!resampler_rate_ok(BLEP_SAMPLE_RATE, rate)) {
+        return false;
+    }
+    init_resampler(&self->resampler, BLEP_SAMPLE_RATE, rate);
+    return true;
+}
+
+uint32_t read_apu_blocks (apu *self, int16_t *out, uint32_t max_blocks) {
+
+    uint32_t ready = apu_samples_ready(self);
+    resampler *output = &self->resampler;
+    float left[MIX_CHUNK];
+    float right[MIX_CHUNK];
+
+    for (uint32_t block = 0; block < max_blocks; block++) {
+
+        // Mix enough to make a whole block out of, if there's that much
+        uint32_t needed = resampler_input_needed(output, AUDIO_BLOCK_FRAMES);
+        while (output->input_count < needed) {
+
+            uint32_t chunk = needed - output->input_count;
+            if (chunk > MIX_CHUNK) {
+                chunk = MIX_CHUNK;
+            }
+            if (chunk > ready) {
+                return block;
+            }
+            mix_channels(self, left, right, chunk);
+            resampler_write(output, left, right, chunk);
+            ready -= chunk;
+        }
+
+        resample(output, out + block * AUDIO_BLOCK_FRAMES * 2, AUDIO_BLOCK_FRAMES);
+    }
+
+    return max_blocks;
+
+}
+
+void init_apu (apu *self, cpu *cpu) {
+
+    memset(self, 0, sizeof(apu));
+    self->cpu = cpu;
+    self->synced = cpu->cycles;
+    self->audio = true;
+
+    init_blep_kernel(&self->kernel);
+    set_apu_output_rate(self, 48000);
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        init_blep_buffer(&self->channels[i].output, cpu->cycles);
+        update_period(self, i);
+    }
+
+    // What the boot ROM leaves behind (minus the beep, which is long over)
+    self->powered = true;
+    *reg(self, NR50_ADDRESS) = 0x77;
+    *reg(self, NR51_ADDRESS) = 0xF3;
+
+    for (uint16_t address = APU_FIRST_REGISTER; address < APU_FIRST_REGISTER + APU_REGISTER_COUNT; address++) {
+        map_io_register(&cpu->bus, address, apu_read, apu_write, self);
+    }
+    set_event_handler(&cpu->scheduler, EVENT_APU_FRAME_SEQUENCER, sequencer_tick, self);
+    schedule_event(&cpu->scheduler, EVENT_APU_FRAME_SEQUENCER, cpu->cycles + FRAME_SEQUENCER_CYCLES);
+
+}
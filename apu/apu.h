@@ -0,0 +1,159 @@
+#ifndef APU_H
+#define APU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "blep.h"
+#include "resampler.h"
+#include "../cpu/cpu-struct.h"
+
+/* -- APU --
+    Four channels: two square waves (the first one with a frequency sweep), one that plays 32 4-bit samples out of
+    wave RAM, and one noise channel. Each one's output only ever changes at a handful of moments: when its waveform
+    moves on a step, when the frame sequencer (512 times a second) changes its volume or shuts it off, and when a
+    register gets written.
+
+    So nothing gets stepped every clock cycle. Whenever a register gets written (or the frame sequencer ticks), every
+    channel first catches up to that clock cycle in one go, jumping straight from one waveform step to the next and
+    dropping a band-limited step into its buffer (see blep.h) every time its output changes. Then the write happens,
+    at exactly the clock cycle it happened on. Samples get mixed when somebody reads them, and either come out as
+    they are (read_apu_samples) or go through the resampler first (read_apu_blocks, see resampler.h).
+
+    With audio off (set_apu_audio) there are no samples at all: the waveforms don't get stepped and nothing goes
+    into the buffers. Everything a game can read back still works the same, though: the frame sequencer keeps
+    running length counters, envelopes and the sweep, so channels still shut themselves off on time and NR52 says so.
+*/
+
+#define NR10_ADDRESS 0xFF10
+#define NR11_ADDRESS 0xFF11
+#define NR12_ADDRESS 0xFF12
+#define NR13_ADDRESS 0xFF13
+#define NR14_ADDRESS 0xFF14
+#define NR21_ADDRESS 0xFF16
+#define NR22_ADDRESS 0xFF17
+#define NR23_ADDRESS 0xFF18
+#define NR24_ADDRESS 0xFF19
+#define NR30_ADDRESS 0xFF1A
+#define NR31_ADDRESS 0xFF1B
+#define NR32_ADDRESS 0xFF1C
+#define NR33_ADDRESS 0xFF1D
+#define NR34_ADDRESS 0xFF1E
+#define NR41_ADDRESS 0xFF20
+#define NR42_ADDRESS 0xFF21
+#define NR43_ADDRESS 0xFF22
+#define NR44_ADDRESS 0xFF23
+#define NR50_ADDRESS 0xFF24
+#define NR51_ADDRESS 0xFF25
+#define NR52_ADDRESS 0xFF26
+#define WAVE_RAM_ADDRESS 0xFF30
+
+// Everything from NR10 to the end of wave RAM
+#define APU_FIRST_REGISTER NR10_ADDRESS
+#define APU_REGISTER_COUNT 0x30
+
+// The frame sequencer ticks at 512 Hz
+#define FRAME_SEQUENCER_CYCLES 8192
+
+typedef enum {
+    CHANNEL_SQUARE1,
+    CHANNEL_SQUARE2,
+    CHANNEL_WAVE,
+    CHANNEL_NOISE,
+    CHANNEL_COUNT
+} ApuChannel;
+
+typedef struct Channel {
+
+    // On (the bit in NR52), and whether its DAC is: a channel with its DAC off can't be turned on
+    bool enabled;
+    bool dac_enabled;
+
+    // Length counter: the channel shuts off when it runs out, if length_enabled
+    uint16_t length;
+    bool length_enabled;
+
+    // Volume envelope (squares and noise)
+    uint8_t volume;
+    uint8_t envelope_period;
+    uint8_t envelope_timer;
+    bool envelope_up;
+
+    // The waveform: how many clock cycles each step takes, when the next one is, and where it's at (duty step, wave
+    // sample)
+    uint16_t frequency;
+    uint32_t period;
+    uint64_t next_step;
+    uint8_t position;
+    uint8_t duty;
+
+    // Frequency sweep (square 1 only)
+    uint16_t shadow_frequency;
+    uint8_t sweep_timer;
+    bool sweep_enabled;
+
+    // Wave channel volume, as a shift
+    uint8_t wave_shift;
+
+    // Noise channel shift register
+    uint16_t lfsr;
+
+    // What it's putting out right now (0-15), and where that goes
+    uint8_t level;
+    blep_buffer output;
+
+} channel;
+
+typedef struct APU {
+
+    cpu *cpu;
+
+    // The registers and wave RAM, the way they were last written
+    uint8_t registers[APU_REGISTER_COUNT];
+    bool powered;
+
+    // Whether samples get made at all
+    bool audio;
+
+    uint8_t sequencer_step;
+    // Every channel is caught up to here
+    uint64_t synced;
+
+    blep_kernel kernel;
+    channel channels[CHANNEL_COUNT];
+
+    // Mixed samples on their way to the output rate
+    resampler resampler;
+
+} apu;
+
+// Hook the APU's registers up to the bus and its frame sequencer to the scheduler
+void init_apu (apu *self, cpu *cpu);
+
+// Turn sample making off (or back on). Nothing the game can see changes either way
+void set_apu_audio (apu *self, bool audio);
+
+// Throw away the samples that haven't been read yet, and start over from where the APU's caught up to. For when
+// its state got changed without going through the bus (loading a save state)
+void restart_apu_output (apu *self);
+
+// Make to a copy of from (for cloning a whole emulator: it still points at from's cpu). With audio off the sample
+// buffers and the resampler are left out, since they'd start over anyway if it came back on, and they're most of
+// the struct
+void copy_apu (apu *to, const apu *from);
+
+// How many samples (at BLEP_SAMPLE_RATE) are ready to be read. Whoever's playing them has to keep up: the buffers
+// hold a bit over 60ms, and anything older than that gets thrown away
+uint32_t apu_samples_ready (apu *self);
+
+// Mix up to count stereo samples (left, right, left, right...) into out, at BLEP_SAMPLE_RATE. Returns how many it
+// got (none with audio off)
+uint32_t read_apu_samples (apu *self, int16_t *out, uint32_t count);
+
+// The rate read_apu_blocks puts samples out at (48 kHz to start with). Returns false (and keeps the old rate) for
+// one the resampler can't do: 0, or anything under about 4.1 kHz
+bool set_apu_output_rate (apu *self, uint32_t rate);
+// Mix and resample up to max_blocks blocks of AUDIO_BLOCK_FRAMES stereo samples into out. Returns how many it made:
+// only whole blocks come out, and whatever's left waits for the next call
+uint32_t read_apu_blocks (apu *self, int16_t *out, uint32_t max_blocks);
+
+#endif
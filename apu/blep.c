@@ -0,0 +1,85 @@
+// Standard libraries
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+// Local libraries
+#include "blep.h"
+
+
+// --  Kernel  --
+
+void init_blep_kernel (blep_kernel *self) {
+
+    const double pi = 3.14159265358979323846;
+    // Cut off a bit below the output's Nyquist frequency, so the steps don't ring right up against it
+    const double cutoff = 0.45;
+
+    for (uint8_t phase = 0; phase < BLEP_PHASES; phase++) {
+
+        double offset = (double) phase / BLEP_PHASES;
+        double sum = 0;
+
+        for (uint8_t tap = 0; tap < BLEP_WIDTH; tap++) {
+
+            // How far this tap is from the middle of the kernel, in samples
+            double x = tap - (BLEP_WIDTH / 2 - 1) - offset;
+            double sinc = (x == 0) ? 1.0 : sin(2 * pi * cutoff * x) / (2 * pi * cutoff * x);
+            // Blackman window over the whole width
+            double w = (x + BLEP_WIDTH / 2) / BLEP_WIDTH;
+            double window = 0.42 - 0.5 * cos(2 * pi * w) + 0.08 * cos(4 * pi * w);
+
+            self->taps[phase][tap] = sinc * window;
+            sum += sinc * window;
+        }
+
+        // Every version has to make a step of exactly 1, or the output would drift
+        for (uint8_t tap = 0; tap < BLEP_WIDTH; tap++) {
+            self->taps[phase][tap] /= sum;
+        }
+    }
+
+}
+
+
+// --  Buffer  --
+
+void init_blep_buffer (blep_buffer *self, uint64_t start) {
+
+    self->start = start;
+    self->level = 0;
+    memset(self->deltas, 0, sizeof(self->deltas));
+
+}
+
+void blep_add_step (blep_buffer *self, const blep_kernel *kernel, uint64_t time, float delta) {
+
+    uint64_t offset = time - self->start;
+    uint32_t sample = offset / BLEP_CYCLES_PER_SAMPLE;
+    const float *taps = kernel->taps[offset % BLEP_CYCLES_PER_SAMPLE];
+    float *deltas = self->deltas + sample;
+
+    for (uint8_t tap = 0; tap < BLEP_WIDTH; tap++) {
+        deltas[tap] += taps[tap] * delta;
+    }
+
+}
+
+void blep_read (blep_buffer *self, float *out, uint32_t count) {
+
+    float level = self->level;
+
+    for (uint32_t i = 0; i < count; i++) {
+        level += self->deltas[i];
+        if (out != NULL) {
+            out[i] = level;
+        }
+    }
+    self->level = level;
+
+    // Whatever's left (including the tails of steps that spill past what got read) moves down to the front
+    uint32_t left = BLEP_BUFFER_SIZE + BLEP_WIDTH - count;
+    memmove(self->deltas, self->deltas + count, left * sizeof(float));
+    memset(self->deltas + left, 0, count * sizeof(float));
+    self->start += (uint64_t) count * BLEP_CYCLES_PER_SAMPLE;
+
+}
@@ -0,0 +1,56 @@
+#ifndef BLEP_H
+#define BLEP_H
+
+#include <stdint.h>
+
+/* -- Band-limited steps --
+    Everything the APU's channels put out is flat, with sudden steps up or down. Sampling that straight would alias
+    like crazy, and stepping every channel every clock cycle to average it out would be way too slow. So instead, all
+    a channel does is say "at this clock cycle, my output went up or down by this much", and that step gets drawn
+    into the buffer as a band-limited step (BLEP): a windowed sinc, picked from one of BLEP_PHASES versions depending
+    on where between two samples the step landed. What actually gets stored is the difference between each sample
+    and the one before it, so a step only touches BLEP_WIDTH samples no matter how long it lasts, and reading the
+    buffer adds them back up.
+
+    Samples come out at BLEP_SAMPLE_RATE, one every BLEP_CYCLES_PER_SAMPLE clock cycles. Turning that into 44.1 or
+    48 kHz is somebody else's problem.
+*/
+
+#define BLEP_CYCLES_PER_SAMPLE 32
+#define BLEP_SAMPLE_RATE (4194304 / BLEP_CYCLES_PER_SAMPLE)
+#define BLEP_PHASES BLEP_CYCLES_PER_SAMPLE
+#define BLEP_WIDTH 16
+#define BLEP_BUFFER_SIZE 8192
+
+// The step shapes, one for every phase. Each one adds up to 1
+typedef struct BlepKernel {
+    float taps[BLEP_PHASES][BLEP_WIDTH];
+} blep_kernel;
+
+typedef struct BlepBuffer {
+
+    // The clock cycle sample 0 is at
+    uint64_t start;
+    // What the samples that have been read so far added up to
+    float level;
+    // Differences between each sample and the previous one. The extra BLEP_WIDTH is for steps near the end
+    float deltas[BLEP_BUFFER_SIZE + BLEP_WIDTH];
+
+} blep_buffer;
+
+void init_blep_kernel (blep_kernel *self);
+void init_blep_buffer (blep_buffer *self, uint64_t start);
+
+// Add a step of delta at clock cycle time. It has to be at or after start, and before the buffer fills up (see
+// blep_samples_ready)
+void blep_add_step (blep_buffer *self, const blep_kernel *kernel, uint64_t time, float delta);
+
+// How many samples are done by now: no step that happens from now on can change them
+static inline uint32_t blep_samples_ready (const blep_buffer *self, uint64_t now) {
+    return (now - self->start) / BLEP_CYCLES_PER_SAMPLE;
+}
+
+// Take count finished samples out of the buffer. out can be NULL to just throw them away
+void blep_read (blep_buffer *self, float *out, uint32_t count);
+
+#endif
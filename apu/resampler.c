@@ -0,0 +1,162 @@
+// Standard libraries
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// Local libraries
+#include "resampler.h"
+
+
+// --  Filter  --
+
+bool resampler_rate_ok (uint32_t input_rate, uint32_t output_rate) {
+
+    if (output_rate == 0) {
+        return false;
+    }
+
+    // Same as resampler_input_needed, for a block starting as late as it can (just short of one input sample in)
+    uint64_t last = (uint64_t) input_rate * (AUDIO_BLOCK_FRAMES - 1) / output_rate + 1;
+    return last + RESAMPLER_TAPS <= RESAMPLER_INPUT_SIZE;
+
+}
+
+void init_resampler (resampler *self, uint32_t input_rate, uint32_t output_rate) {
+
+    const double pi = 3.14159265358979323846;
+
+    memset(self, 0, sizeof(resampler));
+    self->input_rate = input_rate;
+    self->output_rate = output_rate;
+    self->step = ((uint64_t) input_rate << 32) / output_rate;
+
+    // Cut off a bit under the output's Nyquist frequency (or the input's, going up), in cycles per input sample
+    double cutoff = 0.5 * 0.9 * ((output_rate < input_rate) ? (double) output_rate / input_rate : 1.0);
+
+    for (uint16_t phase = 0; phase < RESAMPLER_PHASES; phase++) {
+
+        double offset = (double) phase / RESAMPLER_PHASES;
+        double sum = 0;
+
+        for (uint8_t tap = 0; tap < RESAMPLER_TAPS; tap++) {
+
+            double x = tap - (RESAMPLER_TAPS / 2 - 1) - offset;
+            double sinc = (x == 0) ? 1.0 : sin(2 * pi * cutoff * x) / (2 * pi * cutoff * x);
+            // Blackman window over the whole width
+            double w = (x + RESAMPLER_TAPS / 2) / RESAMPLER_TAPS;
+            double window = 0.42 - 0.5 * cos(2 * pi * w) + 0.08 * cos(4 * pi * w);
+
+            self->taps[phase][tap] = sinc * window;
+            sum += sinc * window;
+        }
+
+        // Flat stays flat, whatever the phase
+        for (uint8_t tap = 0; tap < RESAMPLER_TAPS; tap++) {
+            self->taps[phase][tap] /= sum;
+        }
+    }
+
+}
+
+void clear_resampler (resampler *self) {
+
+    self->position = 0;
+    self->input_count = 0;
+
+}
+
+
+// --  Input  --
+
+uint32_t resampler_space (const resampler *self) {
+    return RESAMPLER_INPUT_SIZE - self->input_count;
+}
+
+uint32_t resampler_input_needed (const resampler *self, uint32_t count) {
+
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t last = self->position + (uint64_t) (count - 1) * self->step;
+    return (uint32_t) (last >> 32) + RESAMPLER_TAPS;
+
+}
+
+uint32_t resampler_write (resampler *self, const float *left, const float *right, uint32_t count) {
+
+    if (count > resampler_space(self)) {
+        count = resampler_space(self);
+    }
+    memcpy(self->input[0] + self->input_count, left, count * sizeof(float));
+    memcpy(self->input[1] + self->input_count, right, count * sizeof(float));
+    self->input_count += count;
+    return count;
+
+}
+
+
+// --  Output  --
+
+// One output sample: the input from here on through one version of the filter
+static inline float convolve (const float *input, const float *taps) {
+
+#if defined(__SSE2__)
+    __m128 sum = _mm_setzero_ps();
+    for (uint8_t i = 0; i < RESAMPLER_TAPS; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input + i), _mm_load_ps(taps + i)));
+    }
+    // Add up the four lanes
+    __m128 pairs = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+#else
+    float sum = 0;
+    for (uint8_t i = 0; i < RESAMPLER_TAPS; i++) {
+        sum += input[i] * taps[i];
+    }
+    return sum;
+#endif
+
+}
+
+// Take out the DC offset and turn it into a 16-bit sample
+static inline int16_t finish_sample (resampler *self, uint8_t side, float sample) {
+
+    float output = sample - self->dc_input[side] + 0.999f * self->dc_output[side];
+    self->dc_input[side] = sample;
+    self->dc_output[side] = output;
+
+    output *= 32767.0f;
+    if (output > 32767.0f) {
+        return 32767;
+    }
+    if (output < -32768.0f) {
+        return -32768;
+    }
+    return (int16_t) output;
+
+}
+
+void resample (resampler *self, int16_t *out, uint32_t count) {
+
+    for (uint32_t i = 0; i < count; i++) {
+
+        uint32_t index = self->position >> 32;
+        const float *taps = self->taps[(self->position >> 24) & (RESAMPLER_PHASES - 1)];
+
+        out[i * 2] = finish_sample(self, 0, convolve(self->input[0] + index, taps));
+        out[i * 2 + 1] = finish_sample(self, 1, convolve(self->input[1] + index, taps));
+
+        self->position += self->step;
+    }
+
+    // Drop the input that's behind where the next output sample falls
+    uint32_t used = self->position >> 32;
+    self->input_count -= used;
+    memmove(self->input[0], self->input[0] + used, self->input_count * sizeof(float));
+    memmove(self->input[1], self->input[1] + used, self->input_count * sizeof(float));
+    self->position -= (uint64_t) used << 32;
+
+}
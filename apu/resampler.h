@@ -0,0 +1,68 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* -- Resampler --
+    Takes the mixed APU output at its own rate (BLEP_SAMPLE_RATE, 131072 Hz) down to whatever the sound card wants
+    (44.1 or 48 kHz, usually) with a polyphase FIR: a low-pass filter kept in RESAMPLER_PHASES versions, each shifted
+    by a fraction of an input sample, so every output sample is one dot product of RESAMPLER_TAPS input samples with
+    the version closest to where it falls. With SSE that's 4 taps per instruction for each side.
+
+    It also takes out the DC offset (the channels only ever put out 0 to 15, never anything negative), the way the
+    capacitor on the real thing's output does.
+
+    Everything lives in the struct, so nothing gets allocated while it's running.
+*/
+
+#define RESAMPLER_TAPS 32
+#define RESAMPLER_PHASES 256
+// Enough input for a block at anything down to about 4.1 kHz (see resampler_rate_ok)
+#define RESAMPLER_INPUT_SIZE 8192
+
+// Output comes in blocks of this many stereo samples
+#define AUDIO_BLOCK_FRAMES 256
+
+typedef struct Resampler {
+
+    uint32_t input_rate;
+    uint32_t output_rate;
+
+    // How many input samples go by for each output sample, and where the next output sample falls in the input,
+    // both 32.32 fixed point
+    uint64_t step;
+    uint64_t position;
+
+    // The filter, one version per phase
+    float taps[RESAMPLER_PHASES][RESAMPLER_TAPS] __attribute__((aligned(16)));
+
+    // Input that hasn't been used up yet, left and right
+    float input[2][RESAMPLER_INPUT_SIZE] __attribute__((aligned(16)));
+    uint32_t input_count;
+
+    // DC blocker: the last input and output on each side
+    float dc_input[2];
+    float dc_output[2];
+
+} resampler;
+
+// Whether going from input_rate to output_rate works: the input for a whole block has to fit in the buffer
+bool resampler_rate_ok (uint32_t input_rate, uint32_t output_rate);
+void init_resampler (resampler *self, uint32_t input_rate, uint32_t output_rate);
+// Throw away the input, keeping the filter
+void clear_resampler (resampler *self);
+
+// How many more input samples fit, and how many have to be in there before the next count output samples can be
+// made
+uint32_t resampler_space (const resampler *self);
+uint32_t resampler_input_needed (const resampler *self, uint32_t count);
+
+// Add up to count input samples, as many as there's space for. Returns how many that was
+uint32_t resampler_write (resampler *self, const float *left, const float *right, uint32_t count);
+
+// Make count stereo output samples (left, right, left, right...) into out. There has to be enough input for them
+// (see resampler_input_needed)
+void resample (resampler *self, int16_t *out, uint32_t count);
+
+#endif
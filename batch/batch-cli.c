@@ -0,0 +1,131 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+// Local libraries
+#include "batch.h"
+
+/* -- Batch CLI --
+    gameboy-batch [-t threads] [-p] [-f frames] [-s state] [-d] [-a] [-i] [-j] [-J] [-H] rom...
+
+    Runs every ROM given for the same number of frames (3600, a minute of play, unless -f says otherwise) and
+    prints how far each one got. -t picks the number of threads (one per core by default), -p pins them to cores,
+    -s starts every ROM from a save state instead of power-on, -d and -a turn drawing and audio on, and -i sticks
+    to the interpreter (no block cache). -j turns the JIT on, and -J does too but checks every translated run
+    against the interpreter (both need a JIT_RECOMPILER build on x86-64). -H prints the state hash each one
+    finished on too, to check that runs which should've come out the same did.
+*/
+
+static double seconds_since (const struct timespec *start) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+
+}
+
+static void usage (const char *name) {
+    fprintf(stderr, "usage: %s [-t threads] [-p] [-f frames] [-s state] [-d] [-a] [-i] [-j] [-J] [-H] rom...\n", name);
+}
+
+int main (int argc, char **argv) {
+
+    batch_options options;
+    default_batch_options(&options);
+    uint64_t frames = 3600;
+    const char *state_path = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "t:pf:s:daijJH")) != -1) {
+        switch (option) {
+            case 't':
+                options.threads = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                options.pin_threads = true;
+                break;
+            case 'f':
+                frames = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                state_path = optarg;
+                break;
+            case 'd':
+                options.draw = true;
+                break;
+            case 'a':
+                options.audio = true;
+                break;
+            case 'i':
+                options.block_cache = false;
+                break;
+            case 'j':
+                options.jit = true;
+                break;
+            case 'J':
+                options.jit_verify = true;
+                break;
+            case 'H':
+                options.hash = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+#if !defined(JIT_RECOMPILER) || !defined(__x86_64__)
+    if (options.jit || options.jit_verify) {
+        fprintf(stderr, "built without the JIT (make JIT_RECOMPILER=1 on x86-64), running the block cache instead\n");
+    }
+#endif
+
+    uint32_t count = argc - optind;
+    batch_job *jobs = calloc(count, sizeof(batch_job));
+    if (jobs == NULL) {
+        return 1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        jobs[i].rom_path = argv[optind + i];
+        jobs[i].state_path = state_path;
+        jobs[i].frames = frames;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!run_batch(jobs, count, &options)) {
+        fprintf(stderr, "couldn't start the batch\n");
+        free(jobs);
+        return 1;
+    }
+    double elapsed = seconds_since(&start);
+
+    int status = 0;
+    uint64_t total_frames = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!jobs[i].ok) {
+            printf("%s: couldn't load\n", jobs[i].rom_path);
+            status = 1;
+            continue;
+        }
+        printf("%s: %llu frames, %llu cycles", jobs[i].rom_path,
+            (unsigned long long) jobs[i].frames_run, (unsigned long long) jobs[i].cycles);
+        if (options.hash) {
+            printf(", state hash %016llx", (unsigned long long) jobs[i].hash);
+        }
+        printf("\n");
+        total_frames += jobs[i].frames_run;
+    }
+    printf("%u jobs, %llu frames in %.3fs (%.0f frames/s)\n", count, (unsigned long long) total_frames, elapsed,
+        (elapsed > 0) ? total_frames / elapsed : 0.0);
+
+    free(jobs);
+    return status;
+
+}
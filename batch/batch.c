@@ -0,0 +1,301 @@
+// Pinning threads needs the GNU extensions
+#define _GNU_SOURCE
+// Standard libraries
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+// Local libraries
+#include "batch.h"
+#include "../cpu/block-cache.h"
+#include "../cpu/jit.h"
+#include "../state/savestate.h"
+#include "../state/statehash.h"
+
+
+typedef struct JobDeque {
+
+    pthread_mutex_t lock;
+    // Job numbers, waiting in [front, back)
+    uint32_t *jobs;
+    uint32_t front;
+    uint32_t back;
+
+} job_deque;
+
+typedef struct Worker {
+
+    pthread_t thread;
+    bool started;
+    uint32_t index;
+    // For picking who to steal from
+    uint32_t random;
+
+    job_deque deque;
+    struct Batch *batch;
+
+} worker;
+
+typedef struct Batch {
+
+    batch_job *jobs;
+    const batch_options *options;
+
+    worker *workers;
+    uint32_t worker_count;
+
+} batch;
+
+
+void default_batch_options (batch_options *self) {
+
+    self->threads = 0;
+    self->pin_threads = false;
+    self->draw = false;
+    self->audio = false;
+    self->block_cache = true;
+    self->jit = false;
+    self->jit_verify = false;
+    self->hash = false;
+
+}
+
+
+// --  Deques  --
+
+// The owner works from the back
+static bool take_job (job_deque *self, uint32_t *job) {
+
+    pthread_mutex_lock(&self->lock);
+    bool found = self->front < self->back;
+    if (found) {
+        *job = self->jobs[--self->back];
+    }
+    pthread_mutex_unlock(&self->lock);
+    return found;
+
+}
+
+// Thieves work from the front, so they get the jobs the owner would've got to last
+static bool steal_job (job_deque *self, uint32_t *job) {
+
+    pthread_mutex_lock(&self->lock);
+    bool found = self->front < self->back;
+    if (found) {
+        *job = self->jobs[self->front++];
+    }
+    pthread_mutex_unlock(&self->lock);
+    return found;
+
+}
+
+// xorshift32
+static uint32_t next_random (worker *self) {
+
+    uint32_t x = self->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    self->random = x;
+    return x;
+
+}
+
+static bool next_job (worker *self, uint32_t *job) {
+
+    if (take_job(&self->deque, job)) {
+        return true;
+    }
+
+    // Go around everybody else once, starting somewhere random
+    batch *b = self->batch;
+    uint32_t start = next_random(self) % b->worker_count;
+    for (uint32_t i = 0; i < b->worker_count; i++) {
+        worker *victim = &b->workers[(start + i) % b->worker_count];
+        if (victim != self && steal_job(&victim->deque, job)) {
+            return true;
+        }
+    }
+    return false;
+
+}
+
+
+// --  Running  --
+
+static void run_job (emu *emulator, batch_job *job, const batch_options *options) {
+
+    job->ok = init_emu(emulator, job->rom_path);
+    if (!job->ok) {
+        return;
+    }
+
+    set_ppu_headless(&emulator->ppu, !options->draw);
+    set_apu_audio(&emulator->apu, options->audio);
+    if (options->block_cache || options->jit || options->jit_verify) {
+        enable_block_cache(&emulator->cpu);
+    }
+    if (options->jit || options->jit_verify) {
+        enable_jit(&emulator->cpu, options->jit_verify);
+    }
+
+    if (job->state_path != NULL && !load_state_file(emulator, job->state_path)) {
+        job->ok = false;
+        free_emu(emulator);
+        return;
+    }
+
+    // Only the pages written since the last frame get hashed again, so it's cheap enough to do every frame
+    bool hash = options->hash || job->frame_hashes != NULL;
+    state_hash hashes;
+    if (hash) {
+        init_state_hash(&hashes, emulator);
+    }
+
+    while (job->frames_run < job->frames) {
+        run_frame(emulator);
+        if (hash) {
+            job->hash = update_state_hash(&hashes, emulator);
+            if (job->frame_hashes != NULL) {
+                job->frame_hashes[job->frames_run] = job->hash;
+            }
+        }
+        job->frames_run++;
+        if (job->frame_done != NULL && !job->frame_done(job->context, emulator)) {
+            break;
+        }
+    }
+
+    job->cycles = emulator->cpu.cycles;
+    free_emu(emulator);
+
+}
+
+static void pin_thread (uint32_t index) {
+
+#if defined(__linux__)
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    // Not being able to pin isn't worth stopping over
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void) index;
+#endif
+
+}
+
+static void work (worker *self) {
+
+    // Big enough (the whole address space, the framebuffer, the audio buffers) that it only gets allocated once
+    emu *emulator = malloc(sizeof(emu));
+    if (emulator == NULL) {
+        return;
+    }
+
+    uint32_t job;
+    while (next_job(self, &job)) {
+        run_job(emulator, &self->batch->jobs[job], self->batch->options);
+    }
+
+    free(emulator);
+
+}
+
+static void *run_worker (void *context) {
+
+    worker *self = context;
+    if (self->batch->options->pin_threads) {
+        pin_thread(self->index);
+    }
+    work(self);
+    return NULL;
+
+}
+
+bool run_batch (batch_job *jobs, uint32_t count, const batch_options *options) {
+
+    batch_options defaults;
+    if (options == NULL) {
+        default_batch_options(&defaults);
+        options = &defaults;
+    }
+
+    uint32_t threads = options->threads;
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cores > 0) ? (uint32_t) cores : 1;
+    }
+    // No point in threads that would never get a job
+    if (threads > count) {
+        threads = (count > 0) ? count : 1;
+    }
+
+    batch b = {
+        .jobs = jobs,
+        .options = options,
+        .workers = calloc(threads, sizeof(worker)),
+        .worker_count = threads
+    };
+    uint32_t *queued = malloc(((size_t) count + 1) * sizeof(uint32_t));
+    if (b.workers == NULL || queued == NULL) {
+        free(b.workers);
+        free(queued);
+        return false;
+    }
+
+    // Deal the jobs out round-robin, every worker's share next to the last one's in queued. Each share goes in
+    // backwards, so the owner (taking from the back) starts with the first one it was dealt
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        worker *w = &b.workers[i];
+        w->index = i;
+        w->random = 0x9E3779B9u * (i + 1);
+        w->batch = &b;
+        pthread_mutex_init(&w->deque.lock, NULL);
+
+        uint32_t share = (count > i) ? (count - i + threads - 1) / threads : 0;
+        w->deque.jobs = queued + next;
+        w->deque.back = share;
+        for (uint32_t k = 0; k < share; k++) {
+            w->deque.jobs[share - 1 - k] = i + k * threads;
+        }
+        next += share;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        jobs[i].ok = false;
+        jobs[i].frames_run = 0;
+        jobs[i].cycles = 0;
+        jobs[i].hash = 0;
+    }
+
+    // A thread that doesn't start just leaves its jobs for the others to steal. If none of them do, they all get
+    // run right here
+    uint32_t started = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        b.workers[i].started = pthread_create(&b.workers[i].thread, NULL, run_worker, &b.workers[i]) == 0;
+        started += b.workers[i].started;
+    }
+    if (started == 0) {
+        work(&b.workers[0]);
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        if (b.workers[i].started) {
+            pthread_join(b.workers[i].thread, NULL);
+        }
+    }
+
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&b.workers[i].deque.lock);
+    }
+    free(b.workers);
+    free(queued);
+    return true;
+
+}
@@ -0,0 +1,73 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../emulator/emulator.h"
+
+/* -- Batch runner --
+    Runs a pile of jobs (a ROM and how many frames to run it for) on a pool of threads, one emulator per thread.
+    Every thread reuses its emulator from one job to the next, so there's one allocation per thread, not per job.
+
+    The jobs get dealt out round-robin at the start, each thread keeping its share in its own deque. A thread takes
+    its next job from the back of its own deque, and once that's empty it steals from the front of somebody else's
+    (starting from a random one, so the thieves don't all pile onto the same thread). Short jobs and long jobs end
+    up evened out without anybody handing work around from the middle.
+
+    Nothing gets added once it's started, so a thread that finds every deque empty is done.
+*/
+
+typedef struct BatchJob {
+
+    const char *rom_path;
+    // A save state to start from (see savestate.h), or NULL to start from power-on
+    const char *state_path;
+    // How many frames to run (at most)
+    uint64_t frames;
+
+    // Called after every frame, if it's set. Returning false ends the job there. It runs on whichever thread got
+    // the job, so anything it touches besides its own context and the emulator has to be thread-safe
+    bool (*frame_done) (void *context, emu *emulator);
+    void *context;
+
+    // Somewhere to put the state hash (see statehash.h) after every frame, with room for frames of them, or NULL.
+    // Two jobs that should be running the same game the same way went apart at the first frame where these differ
+    uint64_t *frame_hashes;
+
+    // Filled in once it's run: whether the ROM (and the state) loaded, and how far it got
+    bool ok;
+    uint64_t frames_run;
+    uint64_t cycles;
+    // The state hash it finished on, if the options asked for one (or frame_hashes did)
+    uint64_t hash;
+
+} batch_job;
+
+typedef struct BatchOptions {
+
+    // How many threads (0 for one per core), and whether to pin each one to its own core
+    uint32_t threads;
+    bool pin_threads;
+
+    // Whether the PPU draws frames and the APU makes samples. Both off by default: the game sees the same thing
+    // either way, and most batch jobs never look at either
+    bool draw;
+    bool audio;
+
+    bool block_cache;
+    // Translate hot blocks into machine code (see jit.h, it needs a JIT_RECOMPILER build on x86-64 to do anything),
+    // and whether to check every translated run against the interpreter too. Either one needs the block cache, so
+    // it turns that on as well
+    bool jit;
+    bool jit_verify;
+    // Whether to keep every job's state hash, which costs a little for every page the game writes each frame
+    bool hash;
+
+} batch_options;
+
+void default_batch_options (batch_options *self);
+
+// Run every job, and return once they're all done. Returns false if there wasn't the memory to even start
+bool run_batch (batch_job *jobs, uint32_t count, const batch_options *options);
+
+#endif
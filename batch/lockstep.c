@@ -0,0 +1,697 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// Local libraries
+#include "lockstep.h"
+#include "../cpu/cpu.h"
+#include "../cpu/decoder.h"
+#include "../cpu/flags-register.h"
+#include "../cpu/instructions-helpers.h"
+
+
+// The instructions lanes can run together. Everything else goes one lane at a time
+typedef enum {
+    VECTOR_NONE,
+    VECTOR_NOP,
+    VECTOR_LD_R_R,      // LD r, r'
+    VECTOR_LD_R_N,      // LD r, n
+    VECTOR_ALU_R,       // ADD/ADC/SUB/SBC/AND/XOR/OR/CP A, r
+    VECTOR_ALU_N,       // ...and A, n
+    VECTOR_INC_R,
+    VECTOR_DEC_R,
+    VECTOR_LD_RR_NN,    // LD BC/DE/HL/SP, nn
+    VECTOR_INC_RR,
+    VECTOR_DEC_RR,
+    VECTOR_CPL,
+    VECTOR_SCF,
+    VECTOR_CCF,
+    VECTOR_JP,
+    VECTOR_JP_CC,
+    VECTOR_JR,
+    VECTOR_JR_CC
+} VectorKind;
+
+// The 8-bit ALU operations, in the order opcodes 0x80-0xBF (and bits 3-5 of 0xC6-0xFE) have them
+typedef enum {
+    ALU_ADD,
+    ALU_ADC,
+    ALU_SUB,
+    ALU_SBC,
+    ALU_AND,
+    ALU_XOR,
+    ALU_OR,
+    ALU_CP
+} AluOperation;
+
+
+// --  Decoding  --
+
+// Which kind of instruction an opcode is, going by its bits: xx yyy zzz, with y and z usually being registers in
+// the order B, C, D, E, H, L, (HL), A
+static VectorKind classify (uint8_t opcode) {
+
+    uint8_t x = opcode >> 6;
+    uint8_t y = (opcode >> 3) & 7;
+    uint8_t z = opcode & 7;
+
+    switch (x) {
+        case 0:
+            switch (opcode) {
+                case 0x00: return VECTOR_NOP;
+                case 0x18: return VECTOR_JR;
+                case 0x2F: return VECTOR_CPL;
+                case 0x37: return VECTOR_SCF;
+                case 0x3F: return VECTOR_CCF;
+            }
+            if (z == 0 && y >= 4) {
+                return VECTOR_JR_CC;
+            }
+            if (z == 1 && !(y & 1)) {
+                return VECTOR_LD_RR_NN;
+            }
+            if (z == 3) {
+                return (y & 1) ? VECTOR_DEC_RR : VECTOR_INC_RR;
+            }
+            if (y != LANE_UNUSED) {
+                if (z == 4) {
+                    return VECTOR_INC_R;
+                }
+                if (z == 5) {
+                    return VECTOR_DEC_R;
+                }
+                if (z == 6) {
+                    return VECTOR_LD_R_N;
+                }
+            }
+            return VECTOR_NONE;
+        case 1:
+            // Anything with (HL) goes to memory, and 0x76 is HALT
+            return (y == LANE_UNUSED || z == LANE_UNUSED) ? VECTOR_NONE : VECTOR_LD_R_R;
+        case 2:
+            return (z == LANE_UNUSED) ? VECTOR_NONE : VECTOR_ALU_R;
+        default:
+            if (opcode == 0xC3) {
+                return VECTOR_JP;
+            }
+            if (z == 2 && y < 4) {
+                return VECTOR_JP_CC;
+            }
+            if (z == 6) {
+                return VECTOR_ALU_N;
+            }
+            return VECTOR_NONE;
+    }
+
+}
+
+// NZ, Z, NC, C
+static inline bool condition_holds (uint8_t condition, uint8_t f) {
+
+    bool flag = get_flag(f, (condition & 2) ? FLAG_CARRY : FLAG_ZERO);
+    return (condition & 1) ? flag : !flag;
+
+}
+
+
+// --  Lanes  --
+
+// A lane's registers from its cpu into the arrays...
+static void load_lane (lockstep *self, uint8_t lane) {
+
+    cpu *c = &self->emulators[lane]->cpu;
+
+    self->registers[LANE_B][lane] = c->cpu_registers.b;
+    self->registers[LANE_C][lane] = c->cpu_registers.c;
+    self->registers[LANE_D][lane] = c->cpu_registers.d;
+    self->registers[LANE_E][lane] = c->cpu_registers.e;
+    self->registers[LANE_H][lane] = c->cpu_registers.h;
+    self->registers[LANE_L][lane] = c->cpu_registers.l;
+    self->registers[LANE_A][lane] = c->cpu_registers.a;
+    self->f[lane] = get_f(c);
+    self->pc[lane] = c->pc;
+    self->sp[lane] = c->sp;
+
+}
+
+// ...and back
+static void store_lane (lockstep *self, uint8_t lane) {
+
+    cpu *c = &self->emulators[lane]->cpu;
+
+    c->cpu_registers.b = self->registers[LANE_B][lane];
+    c->cpu_registers.c = self->registers[LANE_C][lane];
+    c->cpu_registers.d = self->registers[LANE_D][lane];
+    c->cpu_registers.e = self->registers[LANE_E][lane];
+    c->cpu_registers.h = self->registers[LANE_H][lane];
+    c->cpu_registers.l = self->registers[LANE_L][lane];
+    c->cpu_registers.a = self->registers[LANE_A][lane];
+    set_f(c, self->f[lane]);
+    c->pc = self->pc[lane];
+    c->sp = self->sp[lane];
+
+}
+
+// One instruction on one lane, the normal way (or straight to the next event, if it's halted, like execute() does)
+static void step_lane (lockstep *self, uint8_t lane) {
+
+    cpu *c = &self->emulators[lane]->cpu;
+
+    store_lane(self, lane);
+    if (c->halted) {
+        c->cycles += (c->scheduler.next - c->cycles + 3) & ~3ULL;
+    } else {
+        c->cycles += step(c);
+    }
+    load_lane(self, lane);
+
+}
+
+// Handle whatever's due on one lane. Returns false once the lane has run as far as it was asked to
+static bool lane_events (lockstep *self, uint8_t lane) {
+
+    cpu *c = &self->emulators[lane]->cpu;
+
+    store_lane(self, lane);
+    run_events(&c->scheduler, c->cycles);
+    load_lane(self, lane);
+
+    return event_pending(&c->scheduler, EVENT_RUN_END);
+
+}
+
+
+// --  Register operations, every lane at once  --
+
+#if defined(__SSE2__)
+
+static inline __m128i lane_mask (uint32_t lanes) {
+
+    uint8_t mask[LOCKSTEP_LANES] __attribute__((aligned(16)));
+    for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        mask[lane] = (lanes & (1u << lane)) ? 0xFF : 0x00;
+    }
+    return _mm_load_si128((const __m128i *) mask);
+
+}
+
+static inline __m128i load_lanes (const uint8_t *lanes) {
+    return _mm_load_si128((const __m128i *) lanes);
+}
+
+// Only the lanes in mask get written
+static inline void store_lanes (uint8_t *lanes, __m128i value, __m128i mask) {
+    __m128i old = _mm_load_si128((const __m128i *) lanes);
+    _mm_store_si128((__m128i *) lanes, _mm_or_si128(_mm_and_si128(value, mask), _mm_andnot_si128(mask, old)));
+}
+
+static inline __m128i zero_lanes (__m128i result) {
+    return _mm_and_si128(_mm_cmpeq_epi8(result, _mm_setzero_si128()), _mm_set1_epi8((char) FLAG_ZERO));
+}
+
+// H and C from the carries (or borrows) out of every bit: bit 3's is H, bit 7's is C. SSE2 can only shift 16 bits
+// at a time, but with everything else masked off first nothing gets shifted into the lane next door
+static inline __m128i carry_flags (__m128i carries) {
+
+    __m128i half = _mm_slli_epi16(_mm_and_si128(carries, _mm_set1_epi8(0x08)), 2);
+    __m128i full = _mm_srli_epi16(_mm_and_si128(carries, _mm_set1_epi8((char) 0x80)), 3);
+    return _mm_or_si128(half, full);
+
+}
+
+static void vector_alu (lockstep *self, uint8_t operation, __m128i right, __m128i mask) {
+
+    __m128i a = load_lanes(self->registers[LANE_A]);
+    __m128i f = load_lanes(self->f);
+    __m128i result;
+    __m128i flags;
+
+    // C as 0 or 1, for ADC and SBC
+    __m128i carry = _mm_setzero_si128();
+    if (operation == ALU_ADC || operation == ALU_SBC) {
+        carry = _mm_srli_epi16(_mm_and_si128(f, _mm_set1_epi8(FLAG_CARRY)), 4);
+    }
+
+    switch (operation) {
+        case ALU_ADD:
+        case ALU_ADC: {
+            result = _mm_add_epi8(_mm_add_epi8(a, right), carry);
+            // A bit carries out if both inputs had it, or either did and the result doesn't
+            __m128i either = _mm_or_si128(a, right);
+            __m128i carries = _mm_or_si128(_mm_and_si128(a, right), _mm_andnot_si128(result, either));
+            flags = _mm_or_si128(zero_lanes(result), carry_flags(carries));
+            break;
+        }
+        case ALU_SUB:
+        case ALU_SBC:
+        case ALU_CP: {
+            result = _mm_sub_epi8(_mm_sub_epi8(a, right), carry);
+            // A bit borrows if only the right side had it, or both sides matched and the result has it
+            __m128i same = _mm_xor_si128(a, right);
+            __m128i borrows = _mm_or_si128(_mm_andnot_si128(a, right), _mm_andnot_si128(same, result));
+            flags = _mm_or_si128(_mm_or_si128(zero_lanes(result), carry_flags(borrows)),
+                _mm_set1_epi8(FLAG_SUBTRACT));
+            break;
+        }
+        case ALU_AND:
+            result = _mm_and_si128(a, right);
+            flags = _mm_or_si128(zero_lanes(result), _mm_set1_epi8(FLAG_HALF_CARRY));
+            break;
+        case ALU_XOR:
+            result = _mm_xor_si128(a, right);
+            flags = zero_lanes(result);
+            break;
+        default:
+            result = _mm_or_si128(a, right);
+            flags = zero_lanes(result);
+            break;
+    }
+
+    if (operation != ALU_CP) {
+        store_lanes(self->registers[LANE_A], result, mask);
+    }
+    store_lanes(self->f, flags, mask);
+
+}
+
+static void vector_inc_dec (lockstep *self, uint8_t reg, bool decrement, __m128i mask) {
+
+    __m128i value = load_lanes(self->registers[reg]);
+    __m128i f = load_lanes(self->f);
+    __m128i low = _mm_set1_epi8(0x0F);
+    __m128i result;
+    __m128i half;
+
+    // H when the low nibble wraps: it's 0 after going up, or F after going down
+    if (decrement) {
+        result = _mm_sub_epi8(value, _mm_set1_epi8(1));
+        half = _mm_cmpeq_epi8(_mm_and_si128(result, low), low);
+    } else {
+        result = _mm_add_epi8(value, _mm_set1_epi8(1));
+        half = _mm_cmpeq_epi8(_mm_and_si128(result, low), _mm_setzero_si128());
+    }
+
+    // C stays what it was
+    __m128i flags = _mm_or_si128(zero_lanes(result), _mm_and_si128(half, _mm_set1_epi8(FLAG_HALF_CARRY)));
+    if (decrement) {
+        flags = _mm_or_si128(flags, _mm_set1_epi8(FLAG_SUBTRACT));
+    }
+    flags = _mm_or_si128(flags, _mm_and_si128(f, _mm_set1_epi8(FLAG_CARRY)));
+
+    store_lanes(self->registers[reg], result, mask);
+    store_lanes(self->f, flags, mask);
+
+}
+
+static void vector_load (lockstep *self, uint8_t reg, __m128i value, __m128i mask) {
+    store_lanes(self->registers[reg], value, mask);
+}
+
+static void vector_flags (lockstep *self, VectorKind kind, __m128i mask) {
+
+    __m128i f = load_lanes(self->f);
+    __m128i zero = _mm_and_si128(f, _mm_set1_epi8((char) FLAG_ZERO));
+    __m128i carry = _mm_and_si128(f, _mm_set1_epi8(FLAG_CARRY));
+
+    switch (kind) {
+        case VECTOR_CPL:
+            store_lanes(self->registers[LANE_A], _mm_xor_si128(load_lanes(self->registers[LANE_A]),
+                _mm_set1_epi8((char) 0xFF)), mask);
+            f = _mm_or_si128(f, _mm_set1_epi8(FLAG_SUBTRACT | FLAG_HALF_CARRY));
+            break;
+        case VECTOR_SCF:
+            f = _mm_or_si128(zero, _mm_set1_epi8(FLAG_CARRY));
+            break;
+        default:
+            f = _mm_or_si128(zero, _mm_xor_si128(carry, _mm_set1_epi8(FLAG_CARRY)));
+            break;
+    }
+    store_lanes(self->f, f, mask);
+
+}
+
+#else
+
+// Without SSE2 it's the same thing, one lane at a time
+typedef uint32_t lanes_mask;
+
+static inline lanes_mask lane_mask (uint32_t lanes) {
+    return lanes;
+}
+
+static void vector_alu (lockstep *self, uint8_t operation, const uint8_t *right, lanes_mask mask) {
+
+    for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+
+        if (!(mask & (1u << lane))) {
+            continue;
+        }
+
+        uint8_t a = self->registers[LANE_A][lane];
+        uint8_t b = right[lane];
+        uint8_t carry = (operation == ALU_ADC || operation == ALU_SBC) && get_flag(self->f[lane], FLAG_CARRY);
+        uint8_t result;
+        uint8_t flags;
+
+        switch (operation) {
+            case ALU_ADD:
+            case ALU_ADC:
+                result = a + b + carry;
+                flags = flag_if(((a & 0xF) + (b & 0xF) + carry) > 0xF, FLAG_HALF_CARRY) |
+                    flag_if((a + b + carry) > 0xFF, FLAG_CARRY);
+                break;
+            case ALU_SUB:
+            case ALU_SBC:
+            case ALU_CP:
+                result = a - b - carry;
+                flags = FLAG_SUBTRACT | flag_if((a & 0xF) < (b & 0xF) + carry, FLAG_HALF_CARRY) |
+                    flag_if(a < b + carry, FLAG_CARRY);
+                break;
+            case ALU_AND:
+                result = a & b;
+                flags = FLAG_HALF_CARRY;
+                break;
+            case ALU_XOR:
+                result = a ^ b;
+                flags = 0;
+                break;
+            default:
+                result = a | b;
+                flags = 0;
+                break;
+        }
+
+        if (operation != ALU_CP) {
+            self->registers[LANE_A][lane] = result;
+        }
+        self->f[lane] = flags | flag_if(result == 0, FLAG_ZERO);
+    }
+
+}
+
+static void vector_inc_dec (lockstep *self, uint8_t reg, bool decrement, lanes_mask mask) {
+
+    for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        if (mask & (1u << lane)) {
+            uint8_t result = self->registers[reg][lane] + (decrement ? -1 : 1);
+            bool half = decrement ? (result & 0xF) == 0xF : (result & 0xF) == 0;
+            self->registers[reg][lane] = result;
+            self->f[lane] = (self->f[lane] & FLAG_CARRY) | flag_if(result == 0, FLAG_ZERO) |
+                flag_if(half, FLAG_HALF_CARRY) | flag_if(decrement, FLAG_SUBTRACT);
+        }
+    }
+
+}
+
+static void vector_load (lockstep *self, uint8_t reg, const uint8_t *value, lanes_mask mask) {
+
+    for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        if (mask & (1u << lane)) {
+            self->registers[reg][lane] = value[lane];
+        }
+    }
+
+}
+
+static void vector_flags (lockstep *self, VectorKind kind, lanes_mask mask) {
+
+    for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+
+        if (!(mask & (1u << lane))) {
+            continue;
+        }
+        uint8_t f = self->f[lane];
+        switch (kind) {
+            case VECTOR_CPL:
+                self->registers[LANE_A][lane] ^= 0xFF;
+                f |= FLAG_SUBTRACT | FLAG_HALF_CARRY;
+                break;
+            case VECTOR_SCF:
+                f = (f & FLAG_ZERO) | FLAG_CARRY;
+                break;
+            default:
+                f = (f & FLAG_ZERO) | ((f & FLAG_CARRY) ^ FLAG_CARRY);
+                break;
+        }
+        self->f[lane] = f;
+    }
+
+}
+
+#endif
+
+
+// --  Running  --
+
+// Whether every lane in group has the same code in a page. They're all the same ROM, so in ROM it's enough for
+// them to have the same banks in (see lockstep_group), but RAM has to be compared. Nothing running in lockstep
+// writes memory, so once a page has been compared it stays the same until the lanes split up
+static bool same_page (lockstep *self, uint32_t group, uint8_t page) {
+
+    if (page < 0x80) {
+        return true;
+    }
+
+    const uint8_t *first = self->emulators[__builtin_ctz(group)]->cpu.bus.read_pages[page];
+    if (first == NULL) {
+        return false;
+    }
+    for (uint32_t lanes = group & (group - 1); lanes != 0; lanes &= lanes - 1) {
+        const uint8_t *other = self->emulators[__builtin_ctz(lanes)]->cpu.bus.read_pages[page];
+        if (other == NULL || memcmp(other, first, BUS_PAGE_SIZE) != 0) {
+            return false;
+        }
+    }
+    return true;
+
+}
+
+// The lanes (out of ready) that can run along with the first ready one: same PC, same ROM banks in, and nothing
+// pending that the normal cpu has to deal with. Returns 0 if there isn't anybody (one lane on its own is quicker
+// the normal way)
+static uint32_t lockstep_group (lockstep *self, uint32_t ready) {
+
+    uint8_t leader = __builtin_ctz(ready);
+    cpu *first = &self->emulators[leader]->cpu;
+
+    if (first->halted || first->ime_scheduled || classify(read_byte(&first->bus, self->pc[leader])) == VECTOR_NONE) {
+        return 0;
+    }
+
+    uint32_t group = 1u << leader;
+    for (uint32_t lanes = ready & (ready - 1); lanes != 0; lanes &= lanes - 1) {
+        uint8_t lane = __builtin_ctz(lanes);
+        cpu *c = &self->emulators[lane]->cpu;
+        if (self->pc[lane] == self->pc[leader] && !c->halted && !c->ime_scheduled &&
+            c->bus.rom_bank == first->bus.rom_bank && c->bus.rom_bank_low == first->bus.rom_bank_low) {
+            group |= 1u << lane;
+        }
+    }
+
+    return (group & (group - 1)) ? group : 0;
+
+}
+
+// Run the lanes in group together for as long as they can: until one of them has an event due, the next
+// instruction isn't one they can run together, or a conditional jump sends them different ways. Returns false if
+// they couldn't run anything together after all (code in RAM that isn't the same everywhere)
+static bool run_lockstep (lockstep *self, uint32_t group) {
+
+    uint8_t leader = __builtin_ctz(group);
+    memorybus *bus = &self->emulators[leader]->cpu.bus;
+    uint16_t pc = self->pc[leader];
+    uint32_t count = __builtin_popcount(group);
+
+    // They all go the same number of cycles while they're together, so they can only go as far as the lane with
+    // the earliest event
+    uint64_t budget = UINT64_MAX;
+    for (uint32_t lanes = group; lanes != 0; lanes &= lanes - 1) {
+        cpu *c = &self->emulators[__builtin_ctz(lanes)]->cpu;
+        if (c->scheduler.next - c->cycles < budget) {
+            budget = c->scheduler.next - c->cycles;
+        }
+    }
+    uint64_t elapsed = 0;
+    // Lanes that took a conditional jump the others didn't
+    uint32_t taken = 0;
+    uint16_t target = 0;
+    // The last page that's been checked for being the same everywhere (see same_page)
+    int16_t checked_page = -1;
+
+#if defined(__SSE2__)
+    __m128i mask = lane_mask(group);
+    #define LANES(reg) load_lanes(self->registers[reg])
+    #define IMMEDIATE _mm_set1_epi8((char) immediate)
+#else
+    lanes_mask mask = lane_mask(group);
+    uint8_t n[LOCKSTEP_LANES];
+    #define LANES(reg) self->registers[reg]
+    #define IMMEDIATE (memset(n, immediate & 0xFF, sizeof(n)), n)
+#endif
+
+    while (elapsed < budget && taken == 0) {
+
+        uint8_t instruction = read_byte(bus, pc);
+        VectorKind kind = classify(instruction);
+        const opcode *op = &primary_table[instruction];
+        if (kind == VECTOR_NONE) {
+            break;
+        }
+        uint8_t first_page = pc >> 8;
+        uint8_t last_page = (pc + op->length - 1) >> 8;
+        if (first_page != checked_page || last_page != checked_page) {
+            if (!same_page(self, group, first_page) || !same_page(self, group, last_page)) {
+                break;
+            }
+            checked_page = (first_page == last_page) ? first_page : -1;
+        }
+
+        uint16_t immediate = (op->length == 2) ? read_byte(bus, pc + 1) : (op->length == 3) ? read_word(bus, pc + 1) : 0;
+        uint8_t y = (instruction >> 3) & 7;
+        uint8_t z = instruction & 7;
+        uint8_t pair = y >> 1;
+        pc += op->length;
+        elapsed += op->cycles;
+
+        switch (kind) {
+            case VECTOR_LD_R_R:
+                vector_load(self, y, LANES(z), mask);
+                break;
+            case VECTOR_LD_R_N:
+                vector_load(self, y, IMMEDIATE, mask);
+                break;
+            case VECTOR_ALU_R:
+                vector_alu(self, y, LANES(z), mask);
+                break;
+            case VECTOR_ALU_N:
+                vector_alu(self, y, IMMEDIATE, mask);
+                break;
+            case VECTOR_INC_R:
+            case VECTOR_DEC_R:
+                vector_inc_dec(self, y, kind == VECTOR_DEC_R, mask);
+                break;
+            case VECTOR_CPL:
+            case VECTOR_SCF:
+            case VECTOR_CCF:
+                vector_flags(self, kind, mask);
+                break;
+            // The 16-bit ones go a lane at a time: the pairs aren't next to each other here, and SP is 16 bits
+            case VECTOR_LD_RR_NN:
+            case VECTOR_INC_RR:
+            case VECTOR_DEC_RR:
+                for (uint32_t lanes = group; lanes != 0; lanes &= lanes - 1) {
+                    uint8_t lane = __builtin_ctz(lanes);
+                    uint8_t *high = self->registers[pair * 2];
+                    uint8_t *low = self->registers[pair * 2 + 1];
+                    uint16_t value = (pair == 3) ? self->sp[lane] : (high[lane] << 8) | low[lane];
+                    value = (kind == VECTOR_LD_RR_NN) ? immediate : (kind == VECTOR_INC_RR) ? value + 1 : value - 1;
+                    if (pair == 3) {
+                        self->sp[lane] = value;
+                    } else {
+                        high[lane] = value >> 8;
+                        low[lane] = value & 0xFF;
+                    }
+                }
+                break;
+            case VECTOR_JP:
+                pc = immediate;
+                break;
+            case VECTOR_JR:
+                pc += (int8_t) immediate;
+                break;
+            case VECTOR_JP_CC:
+            case VECTOR_JR_CC:
+                target = (kind == VECTOR_JP_CC) ? immediate : pc + (int8_t) immediate;
+                for (uint32_t lanes = group; lanes != 0; lanes &= lanes - 1) {
+                    uint8_t lane = __builtin_ctz(lanes);
+                    if (condition_holds((kind == VECTOR_JP_CC) ? y : y - 4, self->f[lane])) {
+                        taken |= 1u << lane;
+                    }
+                }
+                // Everybody the same way: still together
+                if (taken == group) {
+                    pc = target;
+                    elapsed += 4;
+                    taken = 0;
+                }
+                break;
+            default:
+                break;
+        }
+
+        self->lockstep_instructions += count;
+    }
+    #undef LANES
+    #undef IMMEDIATE
+
+    for (uint32_t lanes = group; lanes != 0; lanes &= lanes - 1) {
+        uint8_t lane = __builtin_ctz(lanes);
+        bool jumped = taken & (1u << lane);
+        self->pc[lane] = jumped ? target : pc;
+        self->emulators[lane]->cpu.cycles += elapsed + (jumped ? 4 : 0);
+    }
+    return elapsed > 0;
+
+}
+
+void init_lockstep (lockstep *self, emu **emulators, uint8_t lanes) {
+
+    memset(self, 0, sizeof(lockstep));
+    self->lanes = (lanes > LOCKSTEP_LANES) ? LOCKSTEP_LANES : lanes;
+    for (uint8_t lane = 0; lane < self->lanes; lane++) {
+        self->emulators[lane] = emulators[lane];
+    }
+
+}
+
+void run_lockstep_frame (lockstep *self) {
+
+    // Every lane runs to the end of its own frame, like run_frame()
+    uint32_t running = 0;
+    for (uint8_t lane = 0; lane < self->lanes; lane++) {
+        emu *e = self->emulators[lane];
+        if (e->frame_end > e->cpu.cycles) {
+            schedule_event(&e->cpu.scheduler, EVENT_RUN_END, e->frame_end);
+            running |= 1u << lane;
+        }
+        load_lane(self, lane);
+    }
+
+    while (running != 0) {
+
+        // Events first, for every lane that's got one due
+        uint32_t ready = 0;
+        for (uint32_t lanes = running; lanes != 0; lanes &= lanes - 1) {
+            uint8_t lane = __builtin_ctz(lanes);
+            cpu *c = &self->emulators[lane]->cpu;
+            if (c->cycles >= c->scheduler.next && !lane_events(self, lane)) {
+                running &= ~(1u << lane);
+                continue;
+            }
+            ready |= 1u << lane;
+        }
+        if (ready == 0) {
+            break;
+        }
+
+        uint32_t group = lockstep_group(self, ready);
+        if (group != 0 && run_lockstep(self, group)) {
+            ready &= ~group;
+        }
+
+        for (uint32_t lanes = ready; lanes != 0; lanes &= lanes - 1) {
+            step_lane(self, __builtin_ctz(lanes));
+            self->scalar_instructions++;
+        }
+    }
+
+    for (uint8_t lane = 0; lane < self->lanes; lane++) {
+        store_lane(self, lane);
+        self->emulators[lane]->frame_end += FRAME_CYCLES;
+        self->emulators[lane]->frames++;
+    }
+
+}
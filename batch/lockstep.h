@@ -0,0 +1,64 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdint.h>
+#include "../emulator/emulator.h"
+
+/* -- Lockstep --
+    Runs up to LOCKSTEP_LANES emulators of the same ROM side by side, one lane each, for when the same game gets
+    played over and over with different inputs. Every lane has its own memory, cartridge RAM, PPU and so on (they're
+    still whole emulators), but while they run here their registers get pulled out into arrays, one per register
+    with an entry per lane. That way one SSE instruction works on the same register in all 16 lanes at once.
+
+    Lanes that are at the same PC run together for as long as the instructions only touch registers: loads between
+    registers and immediates, the 8-bit ALU, INC/DEC, and jumps. A conditional jump that sends them different ways
+    splits them up, and so does the first lane's next event. Everything else (memory, the stack, CB opcodes, HALT,
+    interrupts, events) and every lane that's somewhere else goes through the normal cpu one lane at a time, with
+    its registers put back in its cpu for it first. Lanes running the same code drift back together at the next
+    loop or jump they share.
+
+    The lanes have to be running the same ROM: code in ROM is taken to be the same everywhere as long as the same
+    banks are in.
+
+    Between calls everything's back in the emulators, so they can be looked at (or run on their own) as usual.
+*/
+
+// One 8-bit register for every lane fills an SSE register
+#define LOCKSTEP_LANES 16
+
+// Where each register lives, numbered the way opcodes number them (6 would be (HL), so it's left empty)
+enum LockstepRegister {
+    LANE_B,
+    LANE_C,
+    LANE_D,
+    LANE_E,
+    LANE_H,
+    LANE_L,
+    LANE_UNUSED,
+    LANE_A
+};
+
+typedef struct Lockstep {
+
+    emu *emulators[LOCKSTEP_LANES];
+    uint8_t lanes;
+
+    // Every lane's registers while it runs
+    uint8_t registers[8][LOCKSTEP_LANES] __attribute__((aligned(16)));
+    uint8_t f[LOCKSTEP_LANES] __attribute__((aligned(16)));
+    uint16_t pc[LOCKSTEP_LANES];
+    uint16_t sp[LOCKSTEP_LANES];
+
+    // How many instructions ran in lockstep (counted once per lane) and how many one lane at a time
+    uint64_t lockstep_instructions;
+    uint64_t scalar_instructions;
+
+} lockstep;
+
+// Run these emulators (up to LOCKSTEP_LANES of them, already set up with init_emu) together
+void init_lockstep (lockstep *self, emu **emulators, uint8_t lanes);
+
+// Run one frame on every lane
+void run_lockstep_frame (lockstep *self);
+
+#endif
@@ -0,0 +1,351 @@
+// Standard libraries
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+// Local libraries
+#include "cartridge.h"
+#include "../cpu/memorybus.h"
+
+
+// --  Header  --
+
+// Which mapper goes with which cartridge type (0x0147). Returns false for the ones we can't run
+static bool parse_type (cartridge *self, uint8_t type) {
+
+    self->type = type;
+    self->has_battery = false;
+    self->has_clock = false;
+
+    switch (type) {
+        case 0x00: // ROM ONLY
+        case 0x08: // ROM+RAM
+            self->mapper = MBC_NONE;
+            break;
+        case 0x09: // ROM+RAM+BATTERY
+            self->mapper = MBC_NONE;
+            self->has_battery = true;
+            break;
+        case 0x01: // MBC1
+        case 0x02: // MBC1+RAM
+            self->mapper = MBC_1;
+            break;
+        case 0x03: // MBC1+RAM+BATTERY
+            self->mapper = MBC_1;
+            self->has_battery = true;
+            break;
+        case 0x0F: // MBC3+TIMER+BATTERY
+        case 0x10: // MBC3+TIMER+RAM+BATTERY
+            self->mapper = MBC_3;
+            self->has_clock = true;
+            self->has_battery = true;
+            break;
+        case 0x11: // MBC3
+        case 0x12: // MBC3+RAM
+            self->mapper = MBC_3;
+            break;
+        case 0x13: // MBC3+RAM+BATTERY
+            self->mapper = MBC_3;
+            self->has_battery = true;
+            break;
+        case 0x19: // MBC5
+        case 0x1A: // MBC5+RAM
+        case 0x1C: // MBC5+RUMBLE
+        case 0x1D: // MBC5+RUMBLE+RAM
+            self->mapper = MBC_5;
+            break;
+        case 0x1B: // MBC5+RAM+BATTERY
+        case 0x1E: // MBC5+RUMBLE+RAM+BATTERY
+            self->mapper = MBC_5;
+            self->has_battery = true;
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+
+}
+
+// How much cartridge RAM the header (0x0149) asks for
+static size_t ram_size_from_header (uint8_t code) {
+
+    switch (code) {
+        case 0x01: return 0x800;    // Never used officially, but some homebrew does
+        case 0x02: return 0x2000;
+        case 0x03: return 0x8000;
+        case 0x04: return 0x20000;
+        case 0x05: return 0x10000;
+        default: return 0;
+    }
+
+}
+
+// The header checksum only covers 0x0134-0x014C, so this is the one part of the ROM we read when loading
+static bool check_header (const uint8_t *rom) {
+
+    uint8_t checksum = 0;
+    for (uint16_t address = HEADER_TITLE; address <= 0x014C; address++) {
+        checksum = checksum - rom[address] - 1;
+    }
+    return checksum == rom[HEADER_CHECKSUM];
+
+}
+
+bool global_checksum_ok (const cartridge *self) {
+
+    uint16_t checksum = 0;
+    for (size_t address = 0; address < self->rom_size; address++) {
+        if (address != HEADER_GLOBAL_CHECKSUM && address != HEADER_GLOBAL_CHECKSUM + 1) {
+            checksum += self->rom[address];
+        }
+    }
+    return checksum == ((self->rom[HEADER_GLOBAL_CHECKSUM] << 8) | self->rom[HEADER_GLOBAL_CHECKSUM + 1]);
+
+}
+
+
+// --  Loading  --
+
+bool load_cartridge (cartridge *self, const char *path) {
+
+    memset(self, 0, sizeof(cartridge));
+
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) < 0 || info.st_size < 2 * ROM_BANK_SIZE) {
+        close(file);
+        return false;
+    }
+
+    // MAP_PRIVATE so the pages are shared with everybody else who has this ROM open, but we could never write to
+    // the file by accident. The mapping stays valid after closing the file
+    void *rom = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (rom == MAP_FAILED) {
+        return false;
+    }
+
+    self->rom = rom;
+    self->rom_size = info.st_size;
+    self->rom_users = malloc(sizeof(uint32_t));
+    if (self->rom_users == NULL) {
+        munmap(rom, info.st_size);
+        self->rom = NULL;
+        return false;
+    }
+    *self->rom_users = 1;
+    // Anything after the last full bank can't be switched in anyway
+    self->rom_banks = self->rom_size / ROM_BANK_SIZE;
+
+    if (!parse_type(self, self->rom[HEADER_TYPE])) {
+        unload_cartridge(self);
+        return false;
+    }
+
+    memcpy(self->title, self->rom + HEADER_TITLE, 16);
+    self->title[16] = '\0';
+    self->header_checksum_ok = check_header(self->rom);
+
+    // Cartridge RAM gets at least a whole bank, so the pages in 0xA000-0xBFFF always have somewhere to point. It
+    // gets its memory once it's plugged into a bus
+    self->ram_size = ram_size_from_header(self->rom[HEADER_RAM_SIZE]);
+    if (self->ram_size > 0) {
+        self->ram_banks = (self->ram_size + RAM_BANK_SIZE - 1) / RAM_BANK_SIZE;
+    }
+
+    self->rom_bank = 1;
+    // Without a mapper there's nothing to turn the RAM on with (ROM+RAM carts), it's just always there
+    self->ram_enabled = (self->mapper == MBC_NONE);
+
+    return true;
+
+}
+
+void unload_cartridge (cartridge *self) {
+
+    if (self->rom != NULL && __atomic_sub_fetch(self->rom_users, 1, __ATOMIC_ACQ_REL) == 0) {
+        munmap((void *) self->rom, self->rom_size);
+        free(self->rom_users);
+    }
+
+    self->rom = NULL;
+    self->rom_users = NULL;
+
+}
+
+void share_cartridge (cartridge *self) {
+
+    if (self->rom != NULL) {
+        __atomic_add_fetch(self->rom_users, 1, __ATOMIC_ACQ_REL);
+    }
+
+}
+
+
+// --  Banking  --
+
+// Point 0x0000-0x7FFF at the right ROM banks
+static void map_rom (cartridge *self) {
+
+    uint16_t low = 0;
+    uint16_t high = self->rom_bank;
+
+    if (self->mapper == MBC_1) {
+        // The upper two bits apply to the switchable bank, and in mode 1 to bank 0's slot too (that's how the 1MB+
+        // MBC1 carts get at banks 0x20, 0x40 and 0x60)
+        high = (self->bank_high << 5) | self->rom_bank;
+        if (self->banking_mode == 1) {
+            low = self->bank_high << 5;
+        }
+    }
+
+    // Bank numbers past the end of the ROM wrap around, like the missing address lines on the real thing
+    low %= self->rom_banks;
+    high %= self->rom_banks;
+
+    map_pages(self->bus, 0x00, 0x40, self->rom + low * ROM_BANK_SIZE, NULL);
+    map_pages(self->bus, 0x40, 0x40, self->rom + high * ROM_BANK_SIZE, NULL);
+
+    self->bus->rom_bank_low = low;
+    self->bus->rom_bank = high;
+
+}
+
+// Point 0xA000-0xBFFF at the right RAM bank, or send it to the handlers when there's nothing to point at
+static void map_ram (cartridge *self) {
+
+    bool clock_selected = (self->mapper == MBC_3 && self->ram_bank >= 0x08);
+
+    if (self->ram_page == 0 || !self->ram_enabled || clock_selected) {
+        map_pages(self->bus, 0xA0, 0x20, NULL, NULL);
+        self->bus->ram_bank = BUS_NO_RAM_BANK;
+        return;
+    }
+
+    uint8_t bank = self->ram_bank;
+    if (self->mapper == MBC_1) {
+        bank = (self->banking_mode == 1) ? self->bank_high : 0;
+    }
+    bank %= self->ram_banks;
+
+    map_memory(self->bus, 0xA0, 0x20, self->ram_page + bank * (RAM_BANK_SIZE / BUS_PAGE_SIZE), true);
+    self->bus->ram_bank = bank;
+
+}
+
+// Cartridge RAM when it's turned off (or missing, or MBC3 has a clock register showing there instead)
+static uint8_t ram_read (void *context, uint16_t address) {
+
+    cartridge *self = context;
+
+    if (self->ram_enabled && self->mapper == MBC_3 && self->ram_bank >= 0x08 && self->ram_bank <= 0x0C) {
+        return self->clock[self->ram_bank - 0x08];
+    }
+
+    // Nothing's driving the bus
+    return 0xFF;
+
+}
+static void ram_write (void *context, uint16_t address, uint8_t value) {
+
+    cartridge *self = context;
+
+    if (self->ram_enabled && self->mapper == MBC_3 && self->ram_bank >= 0x08 && self->ram_bank <= 0x0C) {
+        self->clock[self->ram_bank - 0x08] = value;
+    }
+
+}
+
+// Writes to ROM are how the game talks to the mapper
+static void mapper_write (void *context, uint16_t address, uint8_t value) {
+
+    cartridge *self = context;
+
+    switch (self->mapper) {
+
+        case MBC_NONE:
+            return;
+
+        case MBC_1:
+            if (address < 0x2000) {
+                self->ram_enabled = (value & 0x0F) == 0x0A;
+            } else if (address < 0x4000) {
+                // Bank 0 can't go here, it turns into 1
+                self->rom_bank = value & 0x1F;
+                if (self->rom_bank == 0) {
+                    self->rom_bank = 1;
+                }
+            } else if (address < 0x6000) {
+                self->bank_high = value & 0x03;
+            } else {
+                self->banking_mode = value & 0x01;
+            }
+            break;
+
+        case MBC_3:
+            if (address < 0x2000) {
+                self->ram_enabled = (value & 0x0F) == 0x0A;
+            } else if (address < 0x4000) {
+                self->rom_bank = value & 0x7F;
+                if (self->rom_bank == 0) {
+                    self->rom_bank = 1;
+                }
+            } else if (address < 0x6000) {
+                // 0x00-0x03 pick a RAM bank, 0x08-0x0C a clock register
+                self->ram_bank = value;
+            } else {
+                // Writing 0 and then 1 latches the clock. It doesn't tick yet, so there's nothing to copy
+                self->clock_latch = value;
+            }
+            break;
+
+        case MBC_5:
+            if (address < 0x2000) {
+                self->ram_enabled = (value & 0x0F) == 0x0A;
+            } else if (address < 0x3000) {
+                // MBC5 can map bank 0 here, unlike the others
+                self->rom_bank = (self->rom_bank & 0x100) | value;
+            } else if (address < 0x4000) {
+                self->rom_bank = (self->rom_bank & 0xFF) | ((value & 0x01) << 8);
+            } else if (address < 0x6000) {
+                self->ram_bank = value & 0x0F;
+            }
+            break;
+
+    }
+
+    map_rom(self);
+    map_ram(self);
+
+}
+
+void insert_cartridge (cartridge *self, memorybus *bus) {
+
+    self->bus = bus;
+    if (self->ram_banks > 0) {
+        self->ram_page = add_memory(bus, self->ram_banks * (RAM_BANK_SIZE / BUS_PAGE_SIZE));
+    }
+
+    map_handlers(bus, 0x00, 0x80, NULL, mapper_write, self);
+    map_handlers(bus, 0xA0, 0x20, ram_read, ram_write, self);
+
+    map_rom(self);
+    map_ram(self);
+
+}
+
+void remap_cartridge (cartridge *self) {
+
+    map_rom(self);
+    map_ram(self);
+
+}
@@ -0,0 +1,93 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../cpu/memorybus.h"
+
+/* -- Cartridge --
+    The ROM file is mmapped read-only, and the memory bus's page pointers point straight into it. Nothing gets
+    copied: switching banks is just pointing 0x4000-0x7FFF (or 0x0000-0x3FFF, for MBC1) somewhere else, and only
+    the parts of the ROM that actually get run ever get read from disk. Every emulator running the same ROM shares
+    the same pages of it too, since it's the same file.
+
+    Supports cartridges without a mapper, MBC1, MBC3 and MBC5. MBC3's clock registers can be selected, latched,
+    read and written, but they don't tick by themselves yet.
+*/
+
+typedef enum {
+    MBC_NONE,
+    MBC_1,
+    MBC_3,
+    MBC_5
+} MapperType;
+
+// Where the header is, and what's in it
+#define HEADER_TITLE 0x0134
+#define HEADER_TYPE 0x0147
+#define HEADER_ROM_SIZE 0x0148
+#define HEADER_RAM_SIZE 0x0149
+#define HEADER_CHECKSUM 0x014D
+#define HEADER_GLOBAL_CHECKSUM 0x014E
+
+#define ROM_BANK_SIZE 0x4000
+#define RAM_BANK_SIZE 0x2000
+
+typedef struct Cartridge {
+
+    // The whole ROM file, mapped read-only, and how many cartridges share the mapping (see share_cartridge)
+    const uint8_t *rom;
+    size_t rom_size;
+    uint16_t rom_banks;
+    uint32_t *rom_users;
+
+    // Cartridge RAM lives in the bus's memory, from this page of it on (0 if there isn't any, see add_memory)
+    uint16_t ram_page;
+    size_t ram_size;
+    uint8_t ram_banks;
+
+    // From the header
+    char title[17];
+    uint8_t type;
+    MapperType mapper;
+    bool has_battery;
+    bool has_clock;
+    // The boot ROM refuses to run anything with a wrong header checksum, so it's good to know
+    bool header_checksum_ok;
+
+    // Mapper registers
+    bool ram_enabled;
+    uint16_t rom_bank;
+    uint8_t ram_bank;
+    // MBC1: the 2-bit register that's either the upper ROM bank bits or the RAM bank, depending on mode
+    uint8_t bank_high;
+    uint8_t banking_mode;
+    // MBC3: the clock registers (seconds, minutes, hours, days low, days high/flags), and the latch sequence
+    uint8_t clock[5];
+    uint8_t clock_latch;
+
+    // The bus it's plugged into (see insert_cartridge)
+    memorybus *bus;
+
+} cartridge;
+
+// Map the ROM file at path and read its header. Returns false if it can't be opened or isn't a cartridge we
+// can run (too small, or a mapper we don't support)
+bool load_cartridge (cartridge *self, const char *path);
+// Unmap the ROM, if nobody else is using it
+void unload_cartridge (cartridge *self);
+// Count one more user of the ROM, for a struct copy of the cartridge that's going to share it. Each of them has
+// to be unloaded
+void share_cartridge (cartridge *self);
+
+// Plug the cartridge into a memory bus: ROM and cartridge RAM (which the bus gets the memory for) get mapped, and
+// writes to ROM go to the mapper
+void insert_cartridge (cartridge *self, memorybus *bus);
+// Map ROM and RAM banks again, for when the mapper registers got changed without going through the bus
+void remap_cartridge (cartridge *self);
+
+// The global checksum covers the whole ROM, so it isn't checked when loading (that would read every page of it)
+bool global_checksum_ok (const cartridge *self);
+
+#endif
@@ -0,0 +1,108 @@
+// Standard libraries
+#include <stdint.h>
+// Local libraries
+#include "alu-tables.h"
+#include "flags-register.h"
+
+/* How these get built
+    There's no generator program and no big blob of numbers checked in: each entry is written as a formula of its
+    own index, and the preprocessor stamps that formula out once per index. ALU_HEX_n(M, 0x) calls M with every
+    n-digit hex number, gluing one digit on at a time (0x -> 0x3 -> 0x3F -> ...), so each entry ends up with its
+    index as a plain number and the compiler folds the whole thing down to a constant.
+*/
+
+#define ALU_HEX_1(M, p) M(p##0) M(p##1) M(p##2) M(p##3) M(p##4) M(p##5) M(p##6) M(p##7) \
+    M(p##8) M(p##9) M(p##A) M(p##B) M(p##C) M(p##D) M(p##E) M(p##F)
+#define ALU_HEX_2(M, p) ALU_HEX_1(M, p##0) ALU_HEX_1(M, p##1) ALU_HEX_1(M, p##2) ALU_HEX_1(M, p##3) \
+    ALU_HEX_1(M, p##4) ALU_HEX_1(M, p##5) ALU_HEX_1(M, p##6) ALU_HEX_1(M, p##7) \
+    ALU_HEX_1(M, p##8) ALU_HEX_1(M, p##9) ALU_HEX_1(M, p##A) ALU_HEX_1(M, p##B) \
+    ALU_HEX_1(M, p##C) ALU_HEX_1(M, p##D) ALU_HEX_1(M, p##E) ALU_HEX_1(M, p##F)
+#define ALU_HEX_3(M, p) ALU_HEX_2(M, p##0) ALU_HEX_2(M, p##1) ALU_HEX_2(M, p##2) ALU_HEX_2(M, p##3) \
+    ALU_HEX_2(M, p##4) ALU_HEX_2(M, p##5) ALU_HEX_2(M, p##6) ALU_HEX_2(M, p##7) \
+    ALU_HEX_2(M, p##8) ALU_HEX_2(M, p##9) ALU_HEX_2(M, p##A) ALU_HEX_2(M, p##B) \
+    ALU_HEX_2(M, p##C) ALU_HEX_2(M, p##D) ALU_HEX_2(M, p##E) ALU_HEX_2(M, p##F)
+#define ALU_HEX_4(M, p) ALU_HEX_3(M, p##0) ALU_HEX_3(M, p##1) ALU_HEX_3(M, p##2) ALU_HEX_3(M, p##3) \
+    ALU_HEX_3(M, p##4) ALU_HEX_3(M, p##5) ALU_HEX_3(M, p##6) ALU_HEX_3(M, p##7) \
+    ALU_HEX_3(M, p##8) ALU_HEX_3(M, p##9) ALU_HEX_3(M, p##A) ALU_HEX_3(M, p##B) \
+    ALU_HEX_3(M, p##C) ALU_HEX_3(M, p##D) ALU_HEX_3(M, p##E) ALU_HEX_3(M, p##F)
+
+// Flag bits
+#define ALU_Z(x) ((x) ? FLAG_ZERO : 0)
+#define ALU_N(x) ((x) ? FLAG_SUBTRACT : 0)
+#define ALU_H(x) ((x) ? FLAG_HALF_CARRY : 0)
+#define ALU_C(x) ((x) ? FLAG_CARRY : 0)
+
+
+// --  ADD, ADC, SUB, SBC and CP  --
+
+#define ADD_F(a, b, c) (ALU_Z((((a) + (b) + (c)) & 0xFF) == 0) | \
+    ALU_H(((a) & 0xF) + ((b) & 0xF) + (c) > 0xF) | ALU_C((a) + (b) + (c) > 0xFF))
+#define SUB_F(a, b, c) (ALU_Z((((a) - (b) - (c)) & 0xFF) == 0) | ALU_N(1) | \
+    ALU_H(((a) & 0xF) < ((b) & 0xF) + (c)) | ALU_C((a) < (b) + (c)))
+
+#define ADD_ENTRY(i) (ADD_F((i) >> 8, (i) & 0xFF, 0) | (ADD_F((i) >> 8, (i) & 0xFF, 1) >> 4)),
+#define SUB_ENTRY(i) (SUB_F((i) >> 8, (i) & 0xFF, 0) | (SUB_F((i) >> 8, (i) & 0xFF, 1) >> 4)),
+
+const uint8_t alu_add_flags[0x10000] = { ALU_HEX_4(ADD_ENTRY, 0x) };
+const uint8_t alu_sub_flags[0x10000] = { ALU_HEX_4(SUB_ENTRY, 0x) };
+
+
+// --  Shifts and rotates  --
+
+// What comes out, given which one it is (o), the carry going in (c) and the value (v)
+#define SHIFT_RESULT(o, c, v) ( \
+    (o) == SHIFT_RLC ? (((v) << 1) | ((v) >> 7)) & 0xFF : \
+    (o) == SHIFT_RRC ? ((v) >> 1) | (((v) & 1) << 7) : \
+    (o) == SHIFT_RL ? (((v) << 1) | (c)) & 0xFF : \
+    (o) == SHIFT_RR ? ((v) >> 1) | ((c) << 7) : \
+    (o) == SHIFT_SLA ? ((v) << 1) & 0xFF : \
+    (o) == SHIFT_SRA ? ((v) >> 1) | ((v) & 0x80) : \
+    (o) == SHIFT_SWAP ? (((v) << 4) | ((v) >> 4)) & 0xFF : \
+    (v) >> 1)
+// The bit that falls off the end goes into the carry (SWAP just clears it)
+#define SHIFT_CARRY(o, v) ( \
+    (o) == SHIFT_SWAP ? 0 : \
+    ((o) == SHIFT_RLC || (o) == SHIFT_RL || (o) == SHIFT_SLA) ? (v) >> 7 : \
+    (v) & 1)
+
+#define SHIFT_F(o, c, v) (ALU_Z(SHIFT_RESULT(o, c, v) == 0) | ALU_C(SHIFT_CARRY(o, v)))
+#define SHIFT_ENTRY(i) (SHIFT_RESULT((i) >> 9, ((i) >> 8) & 1, (i) & 0xFF) | \
+    (SHIFT_F((i) >> 9, ((i) >> 8) & 1, (i) & 0xFF) << 8)),
+
+const uint16_t alu_shift[8 * 2 * 256] = { ALU_HEX_3(SHIFT_ENTRY, 0x) };
+
+
+// --  INC and DEC  --
+
+// The lower nibble carried if it was F, and borrowed if it was 0
+#define INC_ENTRY(i) ((((i) + 1) & 0xFF) | \
+    ((ALU_Z((((i) + 1) & 0xFF) == 0) | ALU_H(((i) & 0xF) == 0xF)) << 8)),
+#define DEC_ENTRY(i) ((((i) - 1) & 0xFF) | \
+    ((ALU_Z((((i) - 1) & 0xFF) == 0) | ALU_N(1) | ALU_H(((i) & 0xF) == 0)) << 8)),
+
+const uint16_t alu_incdec[2 * 256] = { ALU_HEX_2(INC_ENTRY, 0x) ALU_HEX_2(DEC_ENTRY, 0x) };
+
+
+// --  DAA  --
+
+/* After an addition, any nibble above 9 (or that carried) gets 6 added to it, and going over 0x99 sets the carry.
+    After a subtraction, only the nibbles that borrowed get 6 taken away, and the carry stays as it was */
+#define DAA_SUBTRACT(i) (((i) >> 10) & 1)
+#define DAA_HALF_CARRY(i) (((i) >> 9) & 1)
+#define DAA_CARRY(i) (((i) >> 8) & 1)
+#define DAA_A(i) ((i) & 0xFF)
+
+#define DAA_CORRECTION(i) ( \
+    DAA_SUBTRACT(i) ? \
+        ((DAA_HALF_CARRY(i) ? 0x06 : 0) | (DAA_CARRY(i) ? 0x60 : 0)) : \
+        ((DAA_HALF_CARRY(i) || (DAA_A(i) & 0xF) > 0x9 ? 0x06 : 0) | (DAA_CARRY(i) || DAA_A(i) > 0x99 ? 0x60 : 0)))
+#define DAA_RESULT(i) ((DAA_SUBTRACT(i) ? DAA_A(i) - DAA_CORRECTION(i) : DAA_A(i) + DAA_CORRECTION(i)) & 0xFF)
+#define DAA_CARRY_OUT(i) (DAA_CARRY(i) || (!DAA_SUBTRACT(i) && DAA_A(i) > 0x99))
+
+#define DAA_ENTRY(i) (DAA_RESULT(i) | \
+    ((ALU_Z(DAA_RESULT(i) == 0) | ALU_N(DAA_SUBTRACT(i)) | ALU_C(DAA_CARRY_OUT(i))) << 8)),
+
+const uint16_t alu_daa[8 * 256] = {
+    ALU_HEX_2(DAA_ENTRY, 0x0) ALU_HEX_2(DAA_ENTRY, 0x1) ALU_HEX_2(DAA_ENTRY, 0x2) ALU_HEX_2(DAA_ENTRY, 0x3)
+    ALU_HEX_2(DAA_ENTRY, 0x4) ALU_HEX_2(DAA_ENTRY, 0x5) ALU_HEX_2(DAA_ENTRY, 0x6) ALU_HEX_2(DAA_ENTRY, 0x7)
+};
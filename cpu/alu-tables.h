@@ -0,0 +1,58 @@
+#ifndef ALU_TABLES_H
+#define ALU_TABLES_H
+
+#include <stdint.h>
+
+/* -- ALU tables --
+    Every 8-bit ALU instruction only has a handful of inputs (A, the operand, and maybe the carry flag), so instead of
+    working the answer out bit by bit, we look it up. The tables are constants, so the compiler fills them in while
+    building (see alu-tables.c) and they just sit in the executable, nothing gets done at startup.
+
+    Entries with "result | F << 8" hold the result in the low byte and the F register in the high byte.
+
+    The arithmetic tables only hold F, since the result is just one addition. They're the big ones (64KB each), so
+    each byte packs F for both carries: carry in 0 in the upper nibble, carry in 1 in the lower one. Altogether
+    everything here adds up to a bit over 140KB, small enough to live in L2.
+*/
+
+// The CB shifts and rotates, in the same order as their opcodes (RLC is 0xCB 0x00, RRC is 0xCB 0x08, ...)
+typedef enum {
+    SHIFT_RLC,
+    SHIFT_RRC,
+    SHIFT_RL,
+    SHIFT_RR,
+    SHIFT_SLA,
+    SHIFT_SRA,
+    SHIFT_SWAP,
+    SHIFT_SRL
+} ShiftOperation;
+
+typedef enum {
+    ARITH_ADD,
+    ARITH_ADC,
+    ARITH_SUB,      // Also CP, which just doesn't keep the result
+    ARITH_SBC
+} ArithOperation;
+
+typedef enum {
+    INCDEC_INC,
+    INCDEC_DEC
+} IncDecOperation;
+
+// F after A + operand + carry, indexed by A << 8 | operand
+extern const uint8_t alu_add_flags[0x10000];
+// F after A - operand - carry, indexed by A << 8 | operand
+extern const uint8_t alu_sub_flags[0x10000];
+// result | F << 8, indexed by ShiftOperation << 9 | carry in << 8 | value
+extern const uint16_t alu_shift[8 * 2 * 256];
+// result | F << 8 without the carry flag (INC and DEC leave it alone), indexed by IncDecOperation << 8 | value
+extern const uint16_t alu_incdec[2 * 256];
+// result | F << 8 for DAA, indexed by the subtract, half carry and carry flags (F >> 4 & 7) << 8 | A
+extern const uint16_t alu_daa[8 * 256];
+
+// Get F for a given carry out of the packed arithmetic tables
+static inline uint8_t arith_flags (const uint8_t *table, uint8_t left, uint8_t right, uint8_t carry) {
+    return (uint8_t) ((table[(left << 8) | right] << (carry << 2)) & 0xF0);
+}
+
+#endif
@@ -0,0 +1,288 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+// Local libraries
+#include "block-cache.h"
+#include "cpu.h"
+#include "cpu-struct.h"
+#include "decoder.h"
+#include "instructions.h"
+#include "jit.h"
+#include "memorybus.h"
+
+
+// --  Helpers  --
+
+// The ROM or cartridge RAM bank an address belongs to. Anything else counts as bank 0
+static inline uint16_t bank_at (cpu *self, uint16_t address) {
+    if (address < 0x4000) {
+        return self->bus.rom_bank_low;
+    }
+    if (address < 0x8000) {
+        return self->bus.rom_bank;
+    }
+    if (address >= 0xA000 && address < 0xC000) {
+        return self->bus.ram_bank;
+    }
+    return 0;
+}
+
+// Where a block lives in the cache. Different banks share the same addresses, so mix the bank in
+static inline uint32_t block_index (uint16_t address, uint16_t bank) {
+    return (address ^ (bank * 0x2F1)) & (BLOCK_CACHE_SIZE - 1);
+}
+
+// Anything that changes where the PC goes (or whether interrupts can fire) has to be the last thing in a block
+static bool ends_block (opcode_handler handler) {
+    return handler == jp_nn || handler == jp_cc_nn || handler == jp_hl ||
+        handler == jr_e || handler == jr_cc_e ||
+        handler == call_nn || handler == call_cc_nn ||
+        handler == ret || handler == ret_cc || handler == reti || handler == rst ||
+        handler == halt || handler == stop || handler == ei || handler == illegal;
+}
+
+// Blocks can't be made from the I/O registers or OAM (reading those can change from one moment to the next), and
+// they can't run across the edge of a ROM or RAM bank, since the other side might be switched out from under them
+static inline bool can_cache (uint16_t address) {
+    return address < 0xFE00 || address >= 0xFF80;
+}
+static inline uint8_t region_of (uint16_t address) {
+    if (address < 0x8000) {
+        return address < 0x4000 ? 0 : 1;
+    }
+    return (address >= 0xA000 && address < 0xC000) ? 2 : 3;
+}
+static inline bool same_region (uint16_t start, uint16_t address) {
+    return region_of(start) == region_of(address);
+}
+
+// Echo RAM (0xE000-0xFDFF) is the same memory as 0xC000-0xDDFF, so code there can be rewritten through either.
+// Returns the other address for the same byte, or the address itself if it doesn't have one
+static inline uint16_t echo_of (uint16_t address) {
+    if (address >= 0xC000 && address < 0xDE00) {
+        return address + 0x2000;
+    }
+    if (address >= 0xE000 && address < 0xFE00) {
+        return address - 0x2000;
+    }
+    return address;
+}
+
+static inline void mark_code (block_cache *cache, uint16_t address) {
+    cache->code_map[address >> 3] |= (uint8_t) (1 << (address & 7));
+}
+static inline void unmark_code (block_cache *cache, uint16_t address) {
+    cache->code_map[address >> 3] &= (uint8_t) ~(1 << (address & 7));
+}
+
+// Does this block have a byte at address?
+static inline bool block_covers (const block *b, uint16_t address) {
+    return b->valid && address >= b->start && address < b->end;
+}
+
+
+// --  Invalidation  --
+
+// Called by the memory bus when something writes to an address that's marked in code_map
+static void code_written (void *context, uint16_t address) {
+
+    block_cache *cache = context;
+    uint16_t echo = echo_of(address);
+    bool found = false;
+
+    // This is slow, but it only happens when a game actually rewrites code it already ran
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        block *b = &cache->blocks[i];
+        if (b->start >= 0x8000 && (block_covers(b, address) || block_covers(b, echo))) {
+            b->valid = false;
+            found = true;
+        }
+    }
+
+    if (found) {
+        cache->generation += 1;
+    } else {
+        // The block that marked this byte got replaced a while ago, so stop asking about it
+        unmark_code(cache, address);
+        unmark_code(cache, echo);
+    }
+
+}
+
+void block_cache_flush (block_cache *cache) {
+
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        cache->blocks[i].valid = false;
+    }
+    memset(cache->code_map, 0, sizeof(cache->code_map));
+    cache->generation += 1;
+
+}
+
+
+// --  Setup  --
+
+void enable_block_cache (cpu *self) {
+
+    if (self->blocks != NULL) {
+        return;
+    }
+
+    self->blocks = calloc(1, sizeof(block_cache));
+    if (self->blocks == NULL) {
+        // Not the end of the world, we just keep interpreting one instruction at a time
+        return;
+    }
+
+    self->bus.code_map = self->blocks->code_map;
+    self->bus.code_written = code_written;
+    self->bus.code_context = self->blocks;
+
+}
+
+void disable_block_cache (cpu *self) {
+
+    // The JIT keeps its code in the blocks, so it has to go first
+    disable_jit(self);
+
+    self->bus.code_map = NULL;
+    self->bus.code_written = NULL;
+    self->bus.code_context = NULL;
+    unwatch_pages(&self->bus);
+
+    free(self->blocks);
+    self->blocks = NULL;
+
+}
+
+
+// --  Building and running blocks  --
+
+// Decode instructions from the current PC until something ends the block
+static void build_block (cpu *self, block *b, uint16_t start, uint16_t bank) {
+
+    uint16_t address = start;
+
+    b->start = start;
+    b->bank = bank;
+    b->count = 0;
+    b->hits = 0;
+    b->native_ops = 0;
+    b->native = NULL;
+
+    while (b->count < BLOCK_MAX_OPS) {
+
+        decoded_op *op = &b->ops[b->count];
+        decode_instruction(self, address, op);
+
+        // The instruction's last byte has to be somewhere we can cache too
+        uint16_t last = address + op->length - 1;
+        if (b->count > 0 && (!can_cache(last) || !same_region(start, last))) {
+            break;
+        }
+
+        b->count += 1;
+        address += op->length;
+
+        if (ends_block(op->handler)) {
+            break;
+        }
+    }
+
+    b->end = address;
+    b->valid = true;
+
+    // Code in RAM can be rewritten, so keep an eye on it (writes to its pages have to take the bus's slow path,
+    // which is the one that checks code_map). WRAM code gets watched through its echo too
+    if (start >= 0x8000) {
+        for (uint16_t i = start; i != b->end; i++) {
+            mark_code(self->blocks, i);
+            watch_page(&self->bus, i);
+            mark_code(self->blocks, echo_of(i));
+            watch_page(&self->bus, echo_of(i));
+        }
+    }
+
+}
+
+// Remember where b stopped for an event, to pick up there next time (see resume in block-cache.h)
+static inline void stop_block (block_cache *cache, block *b, uint8_t op, uint16_t pc) {
+
+    if (op < b->count) {
+        cache->resume = b;
+        cache->resume_op = op;
+        cache->resume_pc = pc;
+        cache->resume_generation = cache->generation;
+    }
+
+}
+
+void run_block (cpu *self) {
+
+    block_cache *cache = self->blocks;
+    uint16_t pc = self->pc;
+
+    // I/O and OAM just get interpreted normally
+    if (!can_cache(pc)) {
+        self->cycles += step(self);
+        return;
+    }
+
+    uint16_t bank = bank_at(self, pc);
+    uint32_t generation = cache->generation;
+    block *b;
+    uint8_t first = 0;
+
+    // Picking up where the last block stopped for an event
+    block *resume = cache->resume;
+    if (resume != NULL && resume->valid && resume->bank == bank && cache->resume_pc == pc &&
+        cache->resume_generation == generation) {
+        b = resume;
+        first = cache->resume_op;
+    } else {
+        b = &cache->blocks[block_index(pc, bank)];
+        if (!b->valid || b->start != pc || b->bank != bank) {
+            build_block(self, b, pc, bank);
+        }
+    }
+    cache->resume = NULL;
+
+    // If the JIT translated (the start of) this block, run that and interpret whatever it couldn't do. It stops
+    // early for events the same way the loop below does
+    if (self->jit != NULL) {
+        if (first == 0) {
+            jit_block_hit(self, b);
+        }
+        if (b->native != NULL && first < b->native_ops) {
+            first = jit_run(self, b, first);
+            if (first < b->native_ops || self->cycles >= self->scheduler.next) {
+                stop_block(cache, b, first, self->pc);
+                return;
+            }
+        }
+    }
+
+    for (uint8_t i = first; i < b->count; i++) {
+
+        const decoded_op *op = &b->ops[i];
+
+        // The clock goes forward one instruction at a time, exactly like step(), so whatever reads it (DIV, LY...)
+        // sees the same thing it would without the cache
+        self->pc += op->length;
+        self->cycles += op->cycles + op->handler(self, op->target, op->source, op->immediate);
+
+        // That instruction rewrote some code, maybe even the rest of this block, so go back to decoding from
+        // scratch. Or an event's due (the end of the frame, a timer overflow, a write to IF or IE that has to be
+        // looked at), and that can't wait for the rest of the block
+        if (cache->generation != generation) {
+            break;
+        }
+        if (self->cycles >= self->scheduler.next) {
+            stop_block(cache, b, i + 1, self->pc);
+            break;
+        }
+    }
+
+}
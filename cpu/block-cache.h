@@ -0,0 +1,71 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cpu-struct.h"
+#include "decoder.h"
+
+/* -- Block cache --
+    A basic block is a run of instructions that only ever gets entered at the top and left at the bottom (it ends at
+    the first jump, call, return, HALT, ...). Games spend most of their time going around the same few loops, so
+    instead of re-reading and re-decoding every byte each time, we decode a block once and keep it here, keyed by
+    its address and the ROM bank it came from.
+
+    Code in RAM can be rewritten (the OAM DMA routine in HRAM is the classic example), so blocks outside of ROM mark
+    their bytes in code_map, and the memory bus tells us when one of them is written so we can throw the block away.
+*/
+
+// The most instructions we'll put in one block. Longer runs just get split in two
+#define BLOCK_MAX_OPS 32
+// How many blocks fit in the cache. Has to be a power of two
+#define BLOCK_CACHE_SIZE 1024
+
+typedef struct Block {
+
+    bool valid;
+    uint16_t start;
+    // The address right after the last byte of the block
+    uint16_t end;
+    uint16_t bank;
+    uint8_t count;
+    decoded_op ops[BLOCK_MAX_OPS];
+
+    // Filled in by the JIT (jit.h) once the block gets hot: machine code for the first native_ops instructions
+    uint16_t hits;
+    uint8_t native_ops;
+    uint8_t (*native) (cpu *self, uint8_t first);
+
+} block;
+
+typedef struct BlockCache {
+
+    block blocks[BLOCK_CACHE_SIZE];
+    // One bit per address, set when a block in RAM covers it
+    uint8_t code_map[0x10000 / 8];
+    // Goes up every time a block is thrown away, so whoever is running one can tell it just got rewritten under them
+    uint32_t generation;
+
+    // The block that last stopped partway through for an event, and where. If the PC's still there once the event's
+    // done (no interrupt jumped away), it picks up from that instruction instead of building a new block from the
+    // middle of this one, which would make a block for nearly every address the events happened to land on
+    block *resume;
+    uint8_t resume_op;
+    uint16_t resume_pc;
+    uint32_t resume_generation;
+
+} block_cache;
+
+// Give the cpu a block cache (run() uses it from then on), or take it away again
+void enable_block_cache (cpu *self);
+void disable_block_cache (cpu *self);
+
+// Run the block at the current PC (decoding it first if it isn't cached yet), moving the cpu's clock along as it
+// goes. It stops after whichever instruction gets to the next event, so nothing happens any later than it would
+// one step() at a time
+void run_block (cpu *self);
+
+// Forget every block (for example, after loading a new ROM)
+void block_cache_flush (block_cache *cache);
+
+#endif
@@ -1,17 +1,30 @@
 #ifndef CPU_STRUCT_H
 #define CPU_STRUCT_H
 
+#include <stdbool.h>
+
+#include "flags-register.h"
 #include "registers.h"
 #include "memorybus.h"
+#include "scheduler.h"
 
 /* -- CPU -- 
     Contains:
      - The 8 main CPU registers
+     - The lazy flags: what the last flag-setting operation did, so F only gets worked out when it's needed
+       (see flags-register.h). Always go through get_f/set_f instead of touching cpu_registers.f directly.
      - The Program Counter (often abbreviated as PC): tells us which instruction the Game Boy is currently executing. 
        This 16-bit number is capable of addressing of the of 0xFFFF numbers that live in memory. 
        In fact, when we talk about the memory array we don't usually use the term "index", but instead the term "address".
      - SP: stack pointer, "points" to the top of the stack.
      - The memory bus
+     - IME (Interrupt Master Enable): whether interrupts are allowed to jump in at all. EI only turns it on after the
+       instruction that follows it, so we remember that it's pending.
+     - Whether the CPU is halted, waiting for an interrupt to wake it back up, or locked up for good after running an
+       opcode that doesn't exist (nothing wakes it up from that, not even an interrupt)
+     - How many clock cycles have gone by since it was turned on, which is the clock everything else runs on, and
+       the scheduler that says when the next thing besides the CPU needs to happen (see scheduler.h)
+     - The block cache and the JIT, if they're turned on (see block-cache.h and jit.h)
 
 
 */
@@ -19,10 +32,22 @@
 typedef struct CPU {
 
   registers cpu_registers;
+  lazy_flags flags;
   uint16_t pc;
   uint16_t sp;
   memorybus bus;
 
+  bool ime;
+  bool ime_scheduled;
+  bool halted;
+  bool locked;
+
+  uint64_t cycles;
+  scheduler scheduler;
+
+  struct BlockCache *blocks;
+  struct Jit *jit;
+
 } cpu;
 
 #endif
\ No newline at end of file
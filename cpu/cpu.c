@@ -1,27 +1,98 @@
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include "block-cache.h"
 #include "cpu.h"
+#include "decoder.h"
+#include "interrupts.h"
 #include "memorybus.h"
+#include "scheduler.h"
 
 
+// Everything zeroed, the memory bus mapped the default way, and interrupts hooked up
+void init_cpu (cpu *self) {
 
-void step (cpu *self) {
+    memset(self, 0, sizeof(cpu));
+    init_memorybus(&self->bus);
+    init_scheduler(&self->scheduler);
+    init_interrupts(self);
+
+}
+
+// Run one instruction and return how many clock cycles (T-cycles) it took
+uint8_t step (cpu *self) {
+
+    // A halted CPU just burns cycles until an interrupt wakes it up (a locked one, forever)
+    if (self->halted || self->locked) {
+        return 4;
+    }
+
+    // EI only kicks in after the instruction that follows it
+    bool enable_interrupts = self->ime_scheduled;
 
     // The byte that'll be used for our instruction set
-    uint8_t instruction_byte = read_byte(self->bus, self->pc);
+    uint8_t instruction_byte = read_byte(&self->bus, self->pc);
+    const opcode *op = &primary_table[instruction_byte];
+
+    // Read the inmediate value (if there is one) before moving the program counter past the whole instruction
+    uint16_t immediate = 0;
+    if (op->length == 2) {
+        immediate = read_byte(&self->bus, self->pc + 1);
+    } else if (op->length == 3) {
+        immediate = read_word(&self->bus, self->pc + 1);
+    }
+    self->pc += op->length;
+
+    uint8_t cycles = op->cycles + op->handler(self, op->target, op->source, immediate);
+
+    // Only if nothing (like a DI) cancelled it in the meantime
+    if (enable_interrupts && self->ime_scheduled) {
+        self->ime = true;
+        self->ime_scheduled = false;
+        check_interrupts(self);
+    }
+
+    return cycles;
+
+}
+
+// Run instructions until the next event is due (see run() below). Halted, there's nothing to run, so skip straight
+// to it. With the block cache turned on this goes a whole block at a time.
+// Building with THREADED_INTERPRETER swaps this for the computed-goto version in threaded.c
+#ifndef THREADED_INTERPRETER
+void execute (cpu *self) {
+
+    while (self->cycles < self->scheduler.next) {
+
+        if (self->halted) {
+            // Still in whole machine cycles (4 clock cycles each)
+            self->cycles += (self->scheduler.next - self->cycles + 3) & ~3ULL;
+            return;
+        }
+
+        // EI's delay is easier to get right one instruction at a time
+        if (self->blocks != NULL && !self->ime_scheduled) {
+            run_block(self);
+        } else {
+            self->cycles += step(self);
+        }
+    }
+
+}
+#endif
 
-    // Declare the next step in the program counter
-    uint16_t next_pc;
-    if (1 == 1) {
+// Keep running instructions until at least `cycles` clock cycles have gone by, and return how many actually did.
+// The CPU runs undisturbed until the next event is due, the event gets handled, and so on until the end
+uint32_t run (cpu *self, uint32_t cycles) {
 
-        execute();
+    uint64_t start = self->cycles;
+    schedule_event(&self->scheduler, EVENT_RUN_END, start + cycles);
 
-    } else {
-        // Unkown instruction found for: 0x%X
-        printf("Uh oh! Dingus got into an invalid memory address!!!! \n No instructions were found at your 0x%X", instruction_byte); 
-        // TODO: find a way to panic/abort without causting memory leakage
-        abort();
+    while (event_pending(&self->scheduler, EVENT_RUN_END)) {
+        execute(self);
+        run_events(&self->scheduler, self->cycles);
     }
 
-    self->pc = next_pc;
+    return self->cycles - start;
 
 }
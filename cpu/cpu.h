@@ -4,8 +4,15 @@
 #include <stdint.h>
 #include "cpu-struct.h"
 
-// The cpu's commands for every step in the program counter
-void step (cpu *self);
+// Set up a cpu (and the memory bus, scheduler and interrupts that come with it)
+void init_cpu (cpu *self);
+
+// The cpu's commands for every step in the program counter. Returns the clock cycles it took
+uint8_t step (cpu *self);
+// Run instructions until the next event is due, adding them to the cycle counter
+void execute (cpu *self);
+// Run instructions (and events) for (at least) a number of clock cycles. Returns how many actually went by
+uint32_t run (cpu *self, uint32_t cycles);
 
 
 #endif
\ No newline at end of file
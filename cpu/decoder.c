@@ -0,0 +1,50 @@
+// Standard libraries
+#include <stdint.h>
+// Local libraries
+#include "cpu-struct.h"
+#include "decoder.h"
+#include "instructions.h"
+#include "memorybus.h"
+#include "registers.h"
+
+// The opcodes themselves are listed in opcodes.def and cb-opcodes.def, these just turn them into tables
+
+const opcode primary_table[256] = {
+#define OPCODE(code, handler, target, source, length, cycles, mnemonic) \
+    [code] = { handler, target, source, length, cycles, mnemonic },
+#include "opcodes.def"
+#undef OPCODE
+};
+
+const opcode cb_table[256] = {
+#define CB_OPCODE(code, handler, target, source, length, cycles, mnemonic) \
+    [code] = { handler, target, source, length, cycles, mnemonic },
+#include "cb-opcodes.def"
+#undef CB_OPCODE
+};
+
+// Decode the instruction at address into out
+void decode_instruction (cpu *self, uint16_t address, decoded_op *out) {
+
+    uint8_t instruction_byte = read_byte(&self->bus, address);
+    const opcode *op = &primary_table[instruction_byte];
+
+    // Skip the prefix and go straight for the real instruction. Its length and cycles already count the prefix
+    if (instruction_byte == 0xCB) {
+        op = &cb_table[read_byte(&self->bus, address + 1)];
+        out->immediate = 0;
+    } else if (op->length == 2) {
+        out->immediate = read_byte(&self->bus, address + 1);
+    } else if (op->length == 3) {
+        out->immediate = read_word(&self->bus, address + 1);
+    } else {
+        out->immediate = 0;
+    }
+
+    out->handler = op->handler;
+    out->target = op->target;
+    out->source = op->source;
+    out->length = op->length;
+    out->cycles = op->cycles;
+
+}
@@ -0,0 +1,48 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stdint.h>
+#include "cpu-struct.h"
+
+/* -- Decoder --
+    Every opcode byte maps straight to a handler that's already bound to its operands, so decoding an instruction
+    is a single table lookup and running it is a single call. There's one table for normal opcodes and another for
+    the ones after the 0xCB prefix.
+*/
+
+// Every instruction handler looks like this (see instructions.h). It returns the extra cycles it took
+typedef uint8_t (*opcode_handler) (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+typedef struct Opcode {
+
+    opcode_handler handler;
+    uint8_t target;
+    uint8_t source;
+    // How many bytes the instruction takes, opcode included (so 1 to 3)
+    uint8_t length;
+    // Clock cycles (T-cycles, 4 to every M-cycle) when a conditional instruction doesn't take its branch
+    uint8_t cycles;
+    const char *mnemonic;
+
+} opcode;
+
+extern const opcode primary_table[256];
+extern const opcode cb_table[256];
+
+// An instruction at a specific address, already decoded: CB opcodes are resolved to their cb_table entry and the
+// inmediate value has already been read, so running it again is just a call.
+typedef struct DecodedOp {
+
+    opcode_handler handler;
+    uint16_t immediate;
+    uint8_t target;
+    uint8_t source;
+    uint8_t length;
+    uint8_t cycles;
+
+} decoded_op;
+
+// Decode the instruction at address into out
+void decode_instruction (cpu *self, uint16_t address, decoded_op *out);
+
+#endif
@@ -1,7 +1,7 @@
 #include <stdbool.h>
 #include <stdint.h>
-#include <string.h>
 
+#include "alu-tables.h"
 #include "flags-register.h"
 
 // If I knew this was also called the Program Status Word at the beginning, I would've called this file psw.c since that sounds way cooler
@@ -93,61 +93,22 @@ flagsregister ftoflag (uint8_t f) {
 
 }
 
-// Get the specific flag you want from the f register as a bool
-bool get_flag(uint8_t old_f, char *flag_name) {
+// Work out the F register from the last operation written down in lazy (see flags-register.h)
+uint8_t resolve_flags (const lazy_flags *lazy, uint8_t f) {
 
-  flagsregister flags_plural;
+    uint8_t zero = flag_if(lazy->result == 0, FLAG_ZERO);
 
-  flags_plural = ftoflag(old_f);
-
-  bool flag;
-
-  if (strcmp(flag_name, "zero") == 0) {
-    flag = flags_plural.zero;
-  }
-  else if (strcmp(flag_name, "subtract") == 0) {
-    flag = flags_plural.subtract;
-  }
-  else if (strcmp(flag_name, "half_carry") == 0) {
-    flag = flags_plural.half_carry;
-  }
-  else if (strcmp(flag_name, "carry") == 0) {
-    flag = flags_plural.carry;
-  }
-
-  return flag;
-  
-}
-
-// Give the function a flag name and the value you want it to be, and it'll set it inside the given f flag.
-uint8_t set_flag (uint8_t old_f, char *flag_name, bool value) {
-  
-  // Create a new data structure f
-  flagsregister fr;
-
-  // Initialize the new data structure f by reading from flag f's value
-  fr = ftoflag(old_f);
-
-  // By way of the flag_name, set the value of the structure f
-  if (strcmp(flag_name, "zero") == 0) {
-    fr.zero == value;
-  }
-  else if (strcmp(flag_name, "subtract") == 0) {
-    fr.subtract == value;
-  }
-  else if (strcmp(flag_name, "half_carry") == 0) {
-    fr.half_carry == value;
-  }
-  else if (strcmp(flag_name, "carry") == 0) {
-    fr.carry == value;
-  }
-
-  // Turn the data structure into the f register
-  uint8_t new_f = flagtof(fr);
-
-  // Return the value of this new f register
-  return new_f;
+    switch (lazy->operation) {
+        case FLAGS_ADD:
+            return arith_flags(alu_add_flags, lazy->left, lazy->right, lazy->carry);
+        case FLAGS_SUB:
+            return arith_flags(alu_sub_flags, lazy->left, lazy->right, lazy->carry);
+        case FLAGS_AND:
+            return zero | FLAG_HALF_CARRY;
+        case FLAGS_OR:
+            return zero;
+        default:
+            return f;
+    }
 
 }
-
-
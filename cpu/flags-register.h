@@ -1,6 +1,9 @@
 #ifndef FLAGS_REGISTER_H
 #define FLAGS_REGISTER_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 // The last four bits of flag f (right to left), which carry the flags
 typedef struct FlagsRegister {
     bool zero;
@@ -9,16 +12,84 @@ typedef struct FlagsRegister {
     bool carry;
 } flagsregister;
 
+// Where each flag lives in the f register. They can be OR'd together to get or set several at once
+typedef enum {
+    FLAG_ZERO = 0x80,
+    FLAG_SUBTRACT = 0x40,
+    FLAG_HALF_CARRY = 0x20,
+    FLAG_CARRY = 0x10
+} FlagMask;
+
+// Is the flag (or any of the flags) in mask set?
+static inline bool get_flag (uint8_t f, uint8_t mask) {
+    return (f & mask) != 0;
+}
+// Return f with the flags in mask all set to value
+static inline uint8_t set_flag (uint8_t f, uint8_t mask, bool value) {
+    return value ? (f | mask) : (f & ~mask);
+}
+// Return f with the flags in mask replaced by the ones in value (the rest are left alone)
+static inline uint8_t merge_flags (uint8_t f, uint8_t mask, uint8_t value) {
+    return (f & ~mask) | (value & mask);
+}
+// mask if condition is true, nothing if it isn't. Handy for building the value for merge_flags
+static inline uint8_t flag_if (bool condition, uint8_t mask) {
+    return condition ? mask : 0;
+}
+
+/* Lazy flags
+    Most instructions set flags that the next instruction overwrites before anybody looks at them, so instead of
+    working out Z/N/H/C every time, the common instructions just write down what they did here. The F register only
+    gets worked out (resolved) when something actually reads it: a conditional jump, PUSH AF, ADC/SBC, etc.
+    The ones that get their result out of the ALU tables (alu-tables.h) get F from there for free, so they set it
+    straight away instead.
+*/
+typedef enum {
+    FLAGS_RESOLVED,     // The F register is up to date, nothing to do
+    FLAGS_ADD,          // ADD and ADC: left + right + carry
+    FLAGS_SUB,          // SUB, SBC and CP: left - right - carry
+    FLAGS_AND,          // AND: Z from the result, H always set
+    FLAGS_OR            // OR and XOR: Z from the result, everything else cleared
+} FlagsOperation;
+
+typedef struct LazyFlags {
+    uint8_t operation;
+    uint8_t left;
+    uint8_t right;
+    uint8_t carry;
+    uint8_t result;
+} lazy_flags;
+
+// Work out the F register from the last operation (f is what it was the last time it got resolved)
+uint8_t resolve_flags (const lazy_flags *lazy, uint8_t f);
+
+// Zero and carry are what conditional jumps and ADC/SBC/RL/RR need, and they're cheap to get without resolving everything
+static inline bool lazy_zero (const lazy_flags *lazy, uint8_t f) {
+    if (lazy->operation == FLAGS_RESOLVED) {
+        return get_flag(f, FLAG_ZERO);
+    }
+    return lazy->result == 0;
+}
+static inline bool lazy_carry (const lazy_flags *lazy, uint8_t f) {
+    switch (lazy->operation) {
+        case FLAGS_RESOLVED:
+            return get_flag(f, FLAG_CARRY);
+        case FLAGS_ADD:
+            return (lazy->left + lazy->right + lazy->carry) > 0xFF;
+        case FLAGS_SUB:
+            return lazy->left < (lazy->right + lazy->carry);
+        default:
+            // AND, OR and XOR always clear it
+            return false;
+    }
+}
+
 // Function calls
 
 // Convert a flags-register type 8-bit 'f' register
 uint8_t flagtof (flagsregister flag);
 // Convert an 8-bit 'f' register to a flags-register type
 flagsregister ftoflag (uint8_t f);
-// Get the specific flag you want from the f register as a bool
-bool get_flag (uint8_t old_f, char *flag_name);
-// Return a flag with the flag_name flag changed to value
-uint8_t set_flag (uint8_t old_f, char *flag_name, bool value);
 
 
 
@@ -1,61 +1,61 @@
 // Standard libraries
 #include <stdbool.h>
 #include <stdint.h>
-#include <string.h>
 // Local libraries
+#include "alu-tables.h"
 #include "cpu-struct.h"
 #include "flags-register.h"
+#include "instructions-helpers.h"
 #include "registers.h"
 
-// --  Helpers  --
+// --  Flags  --
 
-// Arithmetic Instruction: Combination for ADD, ADC, SUB (and by extension CP), and SBC
-uint8_t arthins_a (cpu *self, uint8_t value, char *instruction) {
+// Get the real F register, working it out from the lazy flags first if needed
+uint8_t get_f (cpu *self) {
 
-    // Declare carry flag
-    bool carry = get_flag(self->cpu_registers.f, "carry");
+    if (self->flags.operation != FLAGS_RESOLVED) {
+        self->cpu_registers.f = resolve_flags(&self->flags, self->cpu_registers.f);
+        self->flags.operation = FLAGS_RESOLVED;
+    }
 
-    // Declare subtract flag
-    bool subtract = false;
+    return self->cpu_registers.f;
 
-    // Carry out arithmetic
-    uint8_t new_value;
-    if (strcmp(instruction, "ADD") == 0) {
+}
 
-        new_value = self->cpu_registers.a + value;
+// Overwrite the F register (POP AF, loading a state...). The lower nibble always stays zero
+void set_f (cpu *self, uint8_t value) {
 
-    } else if (strcmp(instruction, "ADC") == 0) {
+    self->cpu_registers.f = value & 0xF0;
+    self->flags.operation = FLAGS_RESOLVED;
 
-        new_value = self->cpu_registers.a + value + carry;
+}
 
-    } else if (strcmp(instruction, "SUB") == 0) {
 
-        new_value = self->cpu_registers.a - value;
-        subtract = true;
+// --  Helpers  --
 
-    } else if (strcmp(instruction, "SBC") == 0) {
+// Arithmetic Instruction: Combination for ADD, ADC, SUB (and by extension CP), and SBC
+uint8_t arthins_a (cpu *self, uint8_t value, ArithOperation operation) {
 
-        new_value = self->cpu_registers.a - value - carry;
-        subtract = true;
+    // Only ADC and SBC take the carry in
+    uint8_t carry = 0;
+    if (operation == ARITH_ADC || operation == ARITH_SBC) {
+        carry = carry_flag(self);
+    }
 
+    // Carry out arithmetic
+    bool subtract = (operation == ARITH_SUB || operation == ARITH_SBC);
+    uint8_t new_value;
+    if (subtract) {
+        new_value = self->cpu_registers.a - value - carry;
     } else {
-        return 0;
+        new_value = self->cpu_registers.a + value + carry;
     }
     
-    // Determine rest of flags
-    bool is_new_value_zero = (new_value == 0);
-    bool did_overflow = (new_value < self->cpu_registers.a);
-    bool did_half_carry = ((self->cpu_registers.a & 0xF) + (value & 0xF)) > 0xF;
-
-
-    // Set all the registers to their new values
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", is_new_value_zero);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", subtract);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", did_overflow);
+    // Write down what happened, the flags get looked up from it (in alu-tables.c) when and if somebody needs them.
     // Half Carry is set if adding the lower nibbles of the value and register A
     // together result in a value bigger than 0xF. If the result is larger than 0xF,
     // then the addition caused a carry from the lower nibble to the upper nibble.
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", did_half_carry);
+    record_flags(self, subtract ? FLAGS_SUB : FLAGS_ADD, self->cpu_registers.a, value, carry, new_value);
 
     return new_value;
 }
@@ -69,69 +69,45 @@ uint16_t add_hl (cpu *self, uint16_t value) {
 
 	 // Determine flags
     bool did_overflow = (new_value < hl);
-    bool did_half_carry = ((hl & 0xF000) + (value & 0xF000)) > 0xF000; // Overflow is determined from bit 11 to 12
+    bool did_half_carry = ((hl & 0x0FFF) + (value & 0x0FFF)) > 0x0FFF; // Overflow is determined from bit 11 to 12
 
 
     // Set all the registers to their new values
     //  - Zero left untouched - 
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", did_overflow);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", did_half_carry);
+    update_flags(self, FLAG_SUBTRACT | FLAG_HALF_CARRY | FLAG_CARRY,
+        flag_if(did_half_carry, FLAG_HALF_CARRY) | flag_if(did_overflow, FLAG_CARRY));
 
 	return new_value;
 }
 
-// ADDSP helper: Same as add_hl but with the sp property in the cpu
-uint16_t add_sp(cpu *self, uint8_t value) {
+// ADDSP helper: adds a signed 8-bit value to SP. Also used by LD HL, SP+e, which does the same math but stores it in HL
+uint16_t add_sp(cpu *self, int8_t value) {
 
     // Add 
 	uint16_t sp = self->sp;
 	uint16_t new_value = sp + value; 
 
 	 // Determine flags
-    bool did_overflow = (new_value < sp);
-    bool did_half_carry = ((sp & 0xF000) + (value & 0xF000)) > 0xF000; // Overflow is determined from bit 11 to 12
+    // Even though it's a 16-bit add, the flags come from the lower byte, treating the value as unsigned
+    bool did_overflow = ((sp & 0xFF) + ((uint8_t) value)) > 0xFF;
+    bool did_half_carry = ((sp & 0xF) + (((uint8_t) value) & 0xF)) > 0xF;
 
 
     // Set all the registers to their new values
-    //  - Zero left untouched - 
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", did_overflow);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", did_half_carry);
+    // Zero and subtract are cleared
+    set_f(self, flag_if(did_half_carry, FLAG_HALF_CARRY) | flag_if(did_overflow, FLAG_CARRY));
 
 	return new_value;
 
 }
 
 
-// Bit Setting: function that combines RES and SET
-// TODO: if the data type of n changes, also reflect that in bit_number
-uint8_t bit_setting (uint8_t value, uint8_t bit_number, char *instruction) {
-
-    uint8_t new_value;
-
-    // Reset and Set
-    if (strcmp (instruction, "RES") == 0) {
-
-        // Reset the value in space bit_number to 0
-        uint8_t bitmask = ~(1 << bit_number);
-        new_value = value & bitmask;
-
-    } else if (strcmp (instruction, "SET") == 0) {
-
-        // Set the value in space bit_number to 1
-        uint8_t bit = 1 << bit_number;
-        new_value = value + bit;
-
-    } else {
-        return 1;
-    }
-
-    // - No flags affected - 
-
-    return new_value;
-
+// RES and SET: clear or set bit bit_number of value. No flags affected
+uint8_t res_bit (uint8_t value, uint8_t bit_number) {
+    return value & (uint8_t) ~(1 << bit_number);
+}
+uint8_t set_bit (uint8_t value, uint8_t bit_number) {
+    return value | (uint8_t) (1 << bit_number);
 }
 
 // Bit test: just for BIT since it needs to copy stuff to the Z flag of the F register
@@ -144,226 +120,92 @@ void bit_test (cpu *self, uint8_t value_to_test, uint8_t bit_number) {
     uint8_t test_bit = ((value_to_test & bit_mask) >> bit_number);
     bool is_bit_zero = !test_bit;
     // Set zeri flag to new value. Congratulations! You have found if the bit is zero
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", is_bit_zero);
-
-    // Change values of remaining flags
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", true);
+    // Subtract gets cleared and half carry set
     // - Carry flag left untouched -
+    update_flags(self, FLAG_ZERO | FLAG_SUBTRACT | FLAG_HALF_CARRY, flag_if(is_bit_zero, FLAG_ZERO) | FLAG_HALF_CARRY);
 
 
 }
 
 
 // Increment/Decrease: a combined function for INC and DEC, one for an 8-bit register and another for a 16-bit one
-uint8_t incdec_8 (cpu *self, uint8_t value, char *instruction) {
-
-    // Declare the return value
-    uint8_t new_value;
-
-    // Determine whether to increment or decrease
-    if (strcmp(instruction, "INC") == 0) {
-
-        new_value = value + 1;
-
-    } else if (strcmp(instruction, "DEC") == 0) {
-
-        new_value = value - 1;
+uint8_t incdec_8 (cpu *self, uint8_t value, IncDecOperation operation) {
 
-    } else {
-
-        return 1;
-
-    }
-
-    // Set all the flags to their new values
-    bool is_new_value_zero = (new_value == 0);
-    bool did_half_carry = ((self->cpu_registers.a & 0xF) + (value & 0xF)) > 0xF;
-
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", is_new_value_zero);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", did_half_carry);
-    // - Carry flag left untouched -
+    // The table has everything but the carry flag, which INC and DEC leave untouched
+    uint16_t entry = alu_incdec[(operation << 8) | value];
+    set_f(self, (entry >> 8) | flag_if(carry_flag(self), FLAG_CARRY));
 
-    return new_value;
+    return (uint8_t) entry;
 
 }
-uint16_t incdec_16 (cpu *self, uint16_t value, char *instruction) {
-
-    // Declare the return value
-    uint16_t new_value;
-
-    // Determine whether to increment or decrease
-    if (strcmp(instruction, "INC") == 0) {
-
-        new_value = value + 1;
-
-    } else if (strcmp(instruction, "DEC") == 0) {
-
-        new_value = value - 1;
-
-    } else {
-
-        return 1;
-
-    }
+uint16_t incdec_16 (cpu *self, uint16_t value, IncDecOperation operation) {
 
-    // Set all flags to their new values
     // - All flags left untouched -
-
-    return new_value;
-
-}
-
-// Combined function for RRA, RLA, RRCA and RLCA
-uint8_t rotate_a(cpu *self, char *instruction) {
-
-    // Declare register A and the residual bit used in the C versions
-    uint8_t a_value = self->cpu_registers.a;
-    uint8_t a_bit = 0;
-
-    // Declare the return value
-    uint8_t new_value;
-
-    // Declare the carry flag for functions that need it
-    uint8_t carry_flag = (uint8_t) get_flag(self->cpu_registers.f, "carry");
-
-
-    // Rotate
-    if (strcmp(instruction, "RRA") == 0) {
-
-        new_value = (a_value >> 1) | (carry_flag << 7);
-
-    } else if (strcmp(instruction, "RLA") == 0) {
-        
-        new_value = (a_value << 1) | carry_flag;
-
-    } else if (strcmp(instruction, "RRCA") == 0) {
-
-        a_bit = a_value & 0x1; // Retrieve just bit 0
-        new_value = (a_value >> 1) | (a_bit << 7);
-    
-    } else if (strcmp(instruction, "RLCA") == 0) {
-
-        a_bit = (a_value & 0x80) >> 7; // Retrieve just bit 7
-        new_value = (a_value << 1) | a_bit;
-        
-    } else {
-        return 1;
-    }
-
-    // Set all flags to their new values
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", false);
-
-    if (strcmp(instruction, "RRA") == 0 || strcmp(instruction, "RLA") == 0) {
-
-        bool did_overflow = (new_value < a_value);
-        self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", did_overflow);
-
-    }
-    else if (strcmp(instruction, "RRCA") == 0 || strcmp(instruction, "RLCA") == 0) {
-
-        self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", (bool) a_bit);
-
+    if (operation == INCDEC_INC) {
+        return value + 1;
     }
-
-    return new_value;
+    return value - 1;
 
 }
 
-// Combined function for SRL, SRA, SLA, RR, RL, RRC, and RLC
-uint8_t shift_rot(cpu *self, uint8_t value, char *instruction) {
-
-    // Declare the residual bit used in the C versions
-    uint8_t bit = 0;
-
-    // Declare the return value
-    uint8_t new_value;
-
-    // Declare the carry flag for functions that need it
-    uint8_t carry_flag = (uint8_t) get_flag(self->cpu_registers.f, "carry");
-
-
-    // Execute bit shift or rotation
-    if (strcmp(instruction, "SRL") == 0) {
-
-        new_value = value >> 1;
+// Combined function for RRA, RLA, RRCA and RLCA, which are RR, RL, RRC and RLC on A except that zero is always cleared
+uint8_t rotate_a(cpu *self, ShiftOperation operation) {
 
-    } else if (strcmp(instruction, "SRA") == 0) {
-        
-        bit = (value & 0x80) >> 7; // Retrieve bit 7
-        new_value = (value >> 1) | (bit << 7);
+    uint16_t entry = alu_shift[(operation << 9) | (carry_flag(self) << 8) | self->cpu_registers.a];
+    set_f(self, (entry >> 8) & FLAG_CARRY);
 
-    } else if (strcmp(instruction, "SLA") == 0) {
+    return (uint8_t) entry;
 
-        new_value = value << 1;
-        
-    } else if (strcmp(instruction, "RR") == 0) {
-
-        new_value = (value >> 1) | (carry_flag << 7);
+}
 
-    } else if (strcmp(instruction, "RL") == 0) {
+// Combined function for SRL, SRA, SLA, RR, RL, RRC, RLC (and SWAP)
+uint8_t shift_rot(cpu *self, uint8_t value, ShiftOperation operation) {
 
-        new_value = (value << 1) | carry_flag;
+    // Zero comes from the result, subtract and half carry are cleared and the carry gets the bit that fell off
+    uint16_t entry = alu_shift[(operation << 9) | (carry_flag(self) << 8) | value];
+    set_f(self, entry >> 8);
 
-    } else if (strcmp(instruction, "RRC") == 0) {
+    return (uint8_t) entry;
 
-        bit = value & 0x1; // Retrieve just bit 0
-        new_value = (value >> 1) | (bit << 7);
-        
-    } else if (strcmp(instruction, "RLC") == 0) {
-       
-        bit = (value & 0x80) >> 7; // Retrieve just bit 7
-        new_value = (value << 1) | bit;
+}
 
-    } else {
-        return 1;
-    }
+// Self-explanatory, swap upper and lower nibbles
+void swap_nibbles (cpu *self, uint8_t *value) {
 
+    *value = shift_rot(self, *value, SHIFT_SWAP);
 
-    // Set all flags to their new values
-    bool is_new_value_zero = (new_value == 0);
+}
 
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", is_new_value_zero);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", false);
+// DAA (decimal adjust A): after an addition or subtraction of two BCD numbers, fix A so it's BCD again
+// The subtract and half carry flags are there just so this instruction knows what happened before it
+void decimal_adjust (cpu *self) {
 
-    if (strcmp(instruction, "RR") == 0 || strcmp(instruction, "RL") == 0) {
+    // Indexed by subtract, half carry and carry (see alu-tables.c for the actual rules)
+    uint16_t entry = alu_daa[(((get_f(self) >> 4) & 0x7) << 8) | self->cpu_registers.a];
 
-        bool did_overflow = (new_value < value);
-        self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", did_overflow);
+    self->cpu_registers.a = (uint8_t) entry;
+    set_f(self, entry >> 8);
 
-    } else if (strcmp(instruction, "SRL") == 0 || strcmp(instruction, "SRA") == 0 || strcmp(instruction, "SLA") == 0 ||
-        strcmp(instruction, "RRC") == 0 || strcmp(instruction, "RLC") == 0) {
+}
 
-        self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", (bool) bit);
+// -- Stack --
 
-    }
+// Push a 16-bit value to the stack. The stack grows downwards, and the high byte goes in first
+void push_word (cpu *self, uint16_t value) {
 
+    self->sp -= 1;
+    write_byte(&self->bus, self->sp, (uint8_t) (value >> 8));
+    self->sp -= 1;
+    write_byte(&self->bus, self->sp, (uint8_t) (value & 0xFF));
 
-    return new_value;
 }
 
-// Self-explanatory, swap upper and lower nibbles
-void swap_nibbles (cpu *self, uint8_t *value) {
-
-    // Bitmask so that only the upper nibble passes, and place it in the lower nibble
-    uint8_t upper_nibble = (*value & 0xF0) >> 4;
+// Pop a 16-bit value from the stack, low byte first
+uint16_t pop_word (cpu *self) {
 
-    // Bitshifting by four leaves the lower 4 nibbles into the higher 4
-    *value <<= 4;
+    uint16_t value = read_word(&self->bus, self->sp);
+    self->sp += 2;
 
-    // Concatenate it with the upper nibble and set it as the new value
-    *value |= upper_nibble;
+    return value;
 
-    // Set all flags to new values 
-    bool is_new_value_zero = (*value == 0);
-
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", is_new_value_zero);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", false);
-    self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", false);
-
-}
\ No newline at end of file
+}
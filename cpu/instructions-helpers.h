@@ -1,23 +1,64 @@
 #ifndef INSTRUCTIONS_HELPERS_H
 #define INSTRUCTIONS_HELPERS_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "alu-tables.h"
 #include "cpu-struct.h"
+#include "flags-register.h"
+
+// -- Flags (see the lazy flags in flags-register.h) --
+
+// The real F register, resolved if it has to be
+uint8_t get_f (cpu *self);
+void set_f (cpu *self, uint8_t value);
+
+// Change just the flags in mask to the ones in value, for the instructions that leave some flags alone
+static inline void update_flags (cpu *self, uint8_t mask, uint8_t value) {
+    set_f(self, merge_flags(get_f(self), mask, value));
+}
+
+// Write down an operation so its flags can be worked out later
+static inline void record_flags (cpu *self, uint8_t operation, uint8_t left, uint8_t right, uint8_t carry, uint8_t result) {
+    self->flags.operation = operation;
+    self->flags.left = left;
+    self->flags.right = right;
+    self->flags.carry = carry;
+    self->flags.result = result;
+}
+
+// Just the zero or carry flag, without resolving the whole thing
+static inline bool zero_flag (cpu *self) {
+    return lazy_zero(&self->flags, self->cpu_registers.f);
+}
+static inline bool carry_flag (cpu *self) {
+    return lazy_carry(&self->flags, self->cpu_registers.f);
+}
+
+// -- Helpers --
 
 uint16_t add_hl (cpu *self, uint16_t value);
-uint16_t add_sp(cpu *self, uint8_t value);
+// Also does the math for LD HL, SP+e
+uint16_t add_sp(cpu *self, int8_t value);
 // Currently supports ADD, ADC, SUB (+ CP), and SBC
-uint8_t arthins_a (cpu *self, uint8_t value, char *instruction);
-// Combines RES and SET
-uint8_t bit_setting (uint8_t value, uint8_t bit_number, char *instruction);
+uint8_t arthins_a (cpu *self, uint8_t value, ArithOperation operation);
+// RES and SET
+uint8_t res_bit (uint8_t value, uint8_t bit_number);
+uint8_t set_bit (uint8_t value, uint8_t bit_number);
 // Just BIT
 void bit_test (cpu *self, uint8_t value_to_test, uint8_t bit_number);
 // Combines INC and DEC
-uint8_t incdec_8 (cpu *self, uint8_t value, char *instruction);
-uint16_t incdec_16 (cpu *self, uint16_t value, char *instruction);
+uint8_t incdec_8 (cpu *self, uint8_t value, IncDecOperation operation);
+uint16_t incdec_16 (cpu *self, uint16_t value, IncDecOperation operation);
 // Combines RRA, RLA, RRCA and RLCA
-uint8_t rotate_a(cpu *self, char *instruction);
-// Combines SRL, SRA, SLA, RR, RL, RRC, and RLC
-uint8_t shift_rot(cpu *self, uint8_t value, char *instruction);
+uint8_t rotate_a(cpu *self, ShiftOperation operation);
+// Combines SRL, SRA, SLA, RR, RL, RRC, RLC and SWAP
+uint8_t shift_rot(cpu *self, uint8_t value, ShiftOperation operation);
 void swap_nibbles (cpu *self, uint8_t *value);
+// DAA
+void decimal_adjust (cpu *self);
+// Stack helpers for PUSH, POP, CALL, RET and RST
+void push_word (cpu *self, uint16_t value);
+uint16_t pop_word (cpu *self);
 
 #endif
\ No newline at end of file
@@ -1,1170 +1,764 @@
 // Standard libraries
-#include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 // Local libraries
 #include "cpu-struct.h"
+#include "decoder.h"
 #include "flags-register.h"
 #include "instructions.h"
 #include "instructions-helpers.h"
+#include "interrupts.h"
+#include "memorybus.h"
 #include "registers.h"
 
 
+// --  Operand access  --
 
-// !!TODO!!: Assure it compiles ;-;
-
-// TODO: Execute the instructions given to the CPU based on the given instruction and target
-int execute_mono (cpu *self, Instruction instruction, ArithmeticTarget target) {
-
-	// Define the value set because apparently scope is weird in c switch statements
-	uint8_t value_8;
-	uint8_t new_value_8;
-
-	uint16_t value_16;
-	uint16_t new_value_16;
-
-    switch (instruction) {
-        // ADD (add) - simple instruction that adds specific register's contents to the A register's contents.
-        case ADD: 
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    break;
-				// Add (indirect HL): Add the contents of memory specified by register pair HL to the contents of register A, 
-				// and store the results in register A.
-				// TODO: Turns out we need functionality for memory addresses like this.
-				// TODO: Once we get to that phase, implement all of these parts
-				case iHL:
-					// TODO: Add code for this???
-					value_8 = 0; // No it's not.
-					break;
-            }
-
-            new_value_8 = arthins_a(self, value_8, "ADD");
-			self->cpu_registers.a = new_value_8;
-
-            break;
-        // ADDHL (add to HL) - just like ADD except that the target is added to the HL register
-        case ADDHL:
-			switch (target) {
-				case BC:
-					value_16 = get_bc(self->cpu_registers);
-					break;
-				case DE:
-					value_16 = get_de(self->cpu_registers);
-					break;
-				case HL:
-					value_16 = get_hl(self->cpu_registers);
-					break;
-				case SP:
-					value_16 = self->sp;
-					break;
-			}
-
-            new_value_16 = add_hl(self, value_16);
-            set_hl(&self->cpu_registers, new_value_16); // Reminder: &ptr->value means &(ptr->value)
-
-            break;
-
-        // ADC (add with carry) - just like ADD except that the value of the carry flag is also added to the number
-        case ADC:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    break;
-				// Adc (indirect HL):Add the contents of memory specified by register pair HL and carry to the contents of register A, 
-				// and store the results in register A.
-				// TODO: Turns out we need functionality for memory addresses like this.
-				// TODO: Once we get to that phase, implement all of these parts
-				case iHL:
-					// TODO: Add code for this???
-					value_8 = 0; // No it's not.
-					break;
-            }
-
-            new_value_8 = arthins_a(self, value_8, "ADC");
-			self->cpu_registers.a = new_value_8;
-
-            break;
-		// SUB (subtract) - subtract the value stored in a specific register with the value in the A register
-        case SUB:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    break;
-                // TODO: SUB (HL): at HL's memory address, SUB
-                // TODO: Turns out we need functionality for memory addresses like this.
-                // TODO: Once we get to that phase, implement all of these parts
-                case iHL:
-                    // TODO: Add code for this???
-                    value_8 = 0; // no it's not
-                    break;
-                // SUB n : SUB inmediate value n
-            }
-
-            new_value_8 = arthins_a(self, value_8, "SUB");
-            self->cpu_registers.a = new_value_8;
-
-            break;
-		// SBC (subtract with carry)-just like ADD except that the value of the carry flag is alsosubtracted from the number
-        case SBC:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    break;
-                    
-                // TODO: SBC (HL): at HL's memory address, SBC
-                // TODO: Turns out we need functionality for memory addresses like this.
-                // TODO: Once we get to that phase, implement all of these parts
-                case iHL:
-                    // TODO: Add code for this???
-                    value_8 = 0; // No it's not.
-                    break;
-            }
-
-            new_value_8 = arthins_a(self, value_8, "SBC");
-            self->cpu_registers.a = new_value_8;
-
-            break;
-		// AND (logical and) - do a bitwise and on the value in a specific register and the value in the A register
-        case AND:
-            switch (target) {
-                case A:
-                    self->cpu_registers.a &= self->cpu_registers.a;
-                    break;
-                case B:
-                    self->cpu_registers.a &= self->cpu_registers.b;
-                    break;
-                case C:
-                    self->cpu_registers.a &= self->cpu_registers.c;
-                    break;
-                case D:
-                    self->cpu_registers.a &= self->cpu_registers.d;
-                    break;
-                case E:
-                    self->cpu_registers.a &= self->cpu_registers.e;
-                    break;
-                case H:
-                    self->cpu_registers.a &= self->cpu_registers.h;
-                    break;
-                case L:
-                    self->cpu_registers.a &= self->cpu_registers.l;
-                    break;
-                case iHL:
-                // TODO: figure out HOW TO HANDLE HL POINTERS???????
-                    self->cpu_registers.a &= self->cpu_registers.a;
-                    break;
-            }
-
-            // Evaluate flags
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", (self->cpu_registers.a == 0));
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", true);
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", false);
-
-            break;
-		// OR (logical or) - do a bitwise or on the value in a specific register and the value in the A register
-        case OR:
-            switch (target) {
-                case A:
-                    self->cpu_registers.a |= self->cpu_registers.a;
-                    break;
-                case B:
-                    self->cpu_registers.a |= self->cpu_registers.b;
-                    break;
-                case C:
-                    self->cpu_registers.a |= self->cpu_registers.c;
-                    break;
-                case D:
-                    self->cpu_registers.a |= self->cpu_registers.d;
-                    break;
-                case E:
-                    self->cpu_registers.a |= self->cpu_registers.e;
-                    break;
-                case H:
-                    self->cpu_registers.a |= self->cpu_registers.h;
-                    break;
-                case L:
-                    self->cpu_registers.a |= self->cpu_registers.l;
-                    break;
-                case iHL:
-                // TODO: figure out HOW TO HANDLE HL POINTERS???????
-                    self->cpu_registers.a |= self->cpu_registers.a;
-                    break;
-            }
-
-            // Evaluate flags
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", (self->cpu_registers.a == 0));
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", false);
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", false);
-
-            break;
-		// XOR (logical xor) - do a bitwise xor on the value in a specific register and the value in the A register
-        case XOR:
-            switch (target) {
-                case A:
-                    self->cpu_registers.a ^= self->cpu_registers.a;
-                    break;
-                case B:
-                    self->cpu_registers.a ^= self->cpu_registers.b;
-                    break;
-                case C:
-                    self->cpu_registers.a ^= self->cpu_registers.c;
-                    break;
-                case D:
-                    self->cpu_registers.a ^= self->cpu_registers.d;
-                    break;
-                case E:
-                    self->cpu_registers.a ^= self->cpu_registers.e;
-                    break;
-                case H:
-                    self->cpu_registers.a ^= self->cpu_registers.h;
-                    break;
-                case L:
-                    self->cpu_registers.a ^= self->cpu_registers.l;
-                    break;
-                case iHL:
-                // TODO: figure out HOW TO HANDLE HL POINTERS???????
-                    self->cpu_registers.a ^= self->cpu_registers.a;
-                    break;
-            }
-
-            // Evaluate flags
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", (self->cpu_registers.a == 0));
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", false);
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", false);
-
-            break; 
-		// CP (compare) - just like SUB except the result of the subtraction is not stored back into A
-        case CP:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    break;
-                // TODO: Figure out how memory addresses work for this????
-                case iHL:
-                    value_8 = self->cpu_registers.a;
-                    break;
-            }
-            arthins_a(self, value_8, "SUB");
-            break;
-		// INC (increment) - increment the value in a specific register by 1
-        case INC:
-            switch(target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-
-                    self->cpu_registers.a = incdec_8(self, value_8, "INC");
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-
-                    self->cpu_registers.b = incdec_8(self, value_8, "INC");
-                    break;
-                case C: 
-                    value_8 = self->cpu_registers.c;
-
-                    self->cpu_registers.c = incdec_8(self, value_8, "INC");
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-
-                    self->cpu_registers.d = incdec_8(self, value_8, "INC");
-                    break;
-                case E: 
-                    value_8 = self->cpu_registers.e;
-
-                    self->cpu_registers.e = incdec_8(self, value_8, "INC");
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-
-                    self->cpu_registers.h = incdec_8(self, value_8, "INC");
-                    break;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-
-                    self->cpu_registers.l = incdec_8(self, value_8, "INC");
-                    break;
-                case iHL: // TODO: figure out HL pointer??
-                    value_8 = self->cpu_registers.a;
-                    break;
-                case BC:
-                    value_16 = get_bc(self->cpu_registers);
-
-                    set_bc(&self->cpu_registers, incdec_16(self, value_16, "INC"));
-                    break;
-                case DE:
-                    value_16 = get_de(self->cpu_registers);
-
-                    set_de(&self->cpu_registers, incdec_16(self, value_16, "INC"));
-                    break;
-                case HL:
-                    value_16 = get_hl(self->cpu_registers);
-
-                    set_hl(&self->cpu_registers, incdec_16(self, value_16, "INC"));
-                    break;
-                case SP:
-                    value_16 = self->sp;
-
-                    self->sp = incdec_16(self, value_16, "INC");
-                    break;
-            }
-            break;
-		// DEC (decrement) - decrement the value in a specific register by 1
-        case DEC:
-            switch(target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-
-                    self->cpu_registers.a = incdec_8(self, value_8, "DEC");
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-
-                    self->cpu_registers.b = incdec_8(self, value_8, "DEC");
-                    break;
-                case C: 
-                    value_8 = self->cpu_registers.c;
-
-                    self->cpu_registers.c = incdec_8(self, value_8, "DEC");
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-
-                    self->cpu_registers.d = incdec_8(self, value_8, "DEC");
-                    break;
-                case E: 
-                    value_8 = self->cpu_registers.e;
-
-                    self->cpu_registers.e = incdec_8(self, value_8, "DEC");
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-
-                    self->cpu_registers.h = incdec_8(self, value_8, "DEC");
-                    break;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-
-                    self->cpu_registers.l = incdec_8(self, value_8, "DEC");
-                    break;
-                case iHL: // TODO: figure out HL pointer??
-                    value_8 = self->cpu_registers.a;
-                    break;
-                case BC:
-                    value_16 = get_bc(self->cpu_registers);
-
-                    set_bc(&self->cpu_registers, incdec_16(self, value_16, "DEC"));
-                    break;
-                case DE:
-                    value_16 = get_de(self->cpu_registers);
-
-                    set_de(&self->cpu_registers, incdec_16(self, value_16, "DEC"));
-                    break;
-                case HL:
-                    value_16 = get_hl(self->cpu_registers);
-
-                    set_hl(&self->cpu_registers, incdec_16(self, value_16, "DEC"));
-                    break;
-                case SP:
-                    value_16 = self->sp;
-
-                    self->sp = incdec_16(self, value_16, "DEC");
-                    break;
-            }
-            break;
-
-
-		// CCF (complement carry flag) - toggle the value of the carry flag
-        // NOTE: CCF and SCF also set subtract and half-carry's flags to false
-        case CCF:
-            value_8 = self->cpu_registers.f;
-            
-            new_value_8 = set_flag(value_8, "carry", ~get_flag(value_8, "carry"));
-
-            self->cpu_registers.f = new_value_8;
-
-            self->cpu_registers.f = set_flag(value_8, "subtract", false);
-            self->cpu_registers.f = set_flag(value_8, "half-carry", false);
-            break;
-		// SCF (set carry flag) - set the carry flag to true
-        case SCF:
-            value_8 = self->cpu_registers.f;
-
-            new_value_8 = set_flag(value_8, "carry", true);
-
-            self->cpu_registers.f = new_value_8;
-
-            self->cpu_registers.f = set_flag(value_8, "subtract", false);
-            self->cpu_registers.f = set_flag(value_8, "half-carry", false);
-            break;
-
-
-		// RRA (rotate right A register) - bit rotate A register right through the carry flag
-        // NOTE: "Through the carry flag" means that the contents in the carry flag are copied to the bit left behind
-        case RRA:
-            rotate_a(self, "RRA");
-            break;
-		// RLA (rotate left A register) - bit rotate A register left through the carry flag
-        case RLA:
-            rotate_a(self, "RLA");
-            break;
-		// RRCA (rotate right A register) - bit rotate A register right (not through the carry flag)
-        case RRCA:
-            rotate_a(self, "RRCA");
-            break;
-		// RLCA (rotate left A register) - bit rotate A register left (not through the carry flag)
-        case RLCA:
-            rotate_a(self, "RLCA");
-            break;
-
-
-		// CPL (complement) - toggle every bit of the A register
-        case CPL:
-            self->cpu_registers.a = ~self->cpu_registers.a;
-
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", true);
-            self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", true);
-            break;
-
-		// SRL (shift right logical) - bit shift a specific register right by 1
-        case SRL: 
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "SRL");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    new_value_8 = shift_rot(self, value_8, "SRL");
-                    self->cpu_registers.b = new_value_8;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    new_value_8 = shift_rot(self, value_8, "SRL");
-                    self->cpu_registers.c = new_value_8;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    new_value_8 = shift_rot(self, value_8, "SRL");
-                    self->cpu_registers.d = new_value_8;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    new_value_8 = shift_rot(self, value_8, "SRL");
-                    self->cpu_registers.e = new_value_8;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    new_value_8 = shift_rot(self, value_8, "SRL");
-                    self->cpu_registers.h = new_value_8;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    new_value_8 = shift_rot(self, value_8, "SRL");
-                    self->cpu_registers.l = new_value_8;
-                    break;
-                case iHL: // TODO: Wwwwhyyyyyyyy I need to find out how to work these 16-bit pointers soonnnnn
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "SRL");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-            }
-            break;
-		// RR (rotate right) - bit rotate a specific register right by 1 through the carry flag
-        case RR:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "RR");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    new_value_8 = shift_rot(self, value_8, "RR");
-                    self->cpu_registers.b = new_value_8;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    new_value_8 = shift_rot(self, value_8, "RR");
-                    self->cpu_registers.c = new_value_8;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    new_value_8 = shift_rot(self, value_8, "RR");
-                    self->cpu_registers.d = new_value_8;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    new_value_8 = shift_rot(self, value_8, "RR");
-                    self->cpu_registers.e = new_value_8;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    new_value_8 = shift_rot(self, value_8, "RR");
-                    self->cpu_registers.h = new_value_8;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    new_value_8 = shift_rot(self, value_8, "RR");
-                    self->cpu_registers.l = new_value_8;
-                    break;
-                case iHL: // TODO: Wwwwhyyyyyyyy I need to find out how to work these 16-bit pointers soonnnnn
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "RR");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-            }
-            break;
-		// RL (rotate left) - bit rotate a specific register left by 1 through the carry flag
-        case RL:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "RL");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    new_value_8 = shift_rot(self, value_8, "RL");
-                    self->cpu_registers.b = new_value_8;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    new_value_8 = shift_rot(self, value_8, "RL");
-                    self->cpu_registers.c = new_value_8;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    new_value_8 = shift_rot(self, value_8, "RL");
-                    self->cpu_registers.d = new_value_8;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    new_value_8 = shift_rot(self, value_8, "RL");
-                    self->cpu_registers.e = new_value_8;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    new_value_8 = shift_rot(self, value_8, "RL");
-                    self->cpu_registers.h = new_value_8;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    new_value_8 = shift_rot(self, value_8, "RL");
-                    self->cpu_registers.l = new_value_8;
-                    break;
-                case iHL: // TODO: Wwwwhyyyyyyyy I need to find out how to work these 16-bit pointers soonnnnn
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "RL");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-            }
-            break;
-		// RRC (rotate right) - bit rotate a specific register right by 1 (not through the carry flag)
-        case RRC:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "RRC");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    new_value_8 = shift_rot(self, value_8, "RRC");
-                    self->cpu_registers.b = new_value_8;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    new_value_8 = shift_rot(self, value_8, "RRC");
-                    self->cpu_registers.c = new_value_8;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    new_value_8 = shift_rot(self, value_8, "RRC");
-                    self->cpu_registers.d = new_value_8;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    new_value_8 = shift_rot(self, value_8, "RRC");
-                    self->cpu_registers.e = new_value_8;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    new_value_8 = shift_rot(self, value_8, "RRC");
-                    self->cpu_registers.h = new_value_8;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    new_value_8 = shift_rot(self, value_8, "RRC");
-                    self->cpu_registers.l = new_value_8;
-                    break;
-                case iHL: // TODO: Wwwwhyyyyyyyy I need to find out how to work these 16-bit pointers soonnnnn
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "RRC");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-            }
-            break;
-		// RLC (rotate left) - bit rotate a specific register left by 1 (not through the carry flag)
-        case RLC:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "RLC");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    new_value_8 = shift_rot(self, value_8, "RLC");
-                    self->cpu_registers.b = new_value_8;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    new_value_8 = shift_rot(self, value_8, "RLC");
-                    self->cpu_registers.c = new_value_8;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    new_value_8 = shift_rot(self, value_8, "RLC");
-                    self->cpu_registers.d = new_value_8;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    new_value_8 = shift_rot(self, value_8, "RLC");
-                    self->cpu_registers.e = new_value_8;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    new_value_8 = shift_rot(self, value_8, "RLC");
-                    self->cpu_registers.h = new_value_8;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    new_value_8 = shift_rot(self, value_8, "RLC");
-                    self->cpu_registers.l = new_value_8;
-                    break;
-                case iHL: // TODO: Wwwwhyyyyyyyy I need to find out how to work these 16-bit pointers soonnnnn
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "RLC");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-            }
-            break;
-		// SRA (shift right arithmetic) - arithmetic shift a specific register right by 1
-        case SRA:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "SRA");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    new_value_8 = shift_rot(self, value_8, "SRA");
-                    self->cpu_registers.b = new_value_8;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    new_value_8 = shift_rot(self, value_8, "SRA");
-                    self->cpu_registers.c = new_value_8;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    new_value_8 = shift_rot(self, value_8, "SRA");
-                    self->cpu_registers.d = new_value_8;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    new_value_8 = shift_rot(self, value_8, "SRA");
-                    self->cpu_registers.e = new_value_8;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    new_value_8 = shift_rot(self, value_8, "SRA");
-                    self->cpu_registers.h = new_value_8;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    new_value_8 = shift_rot(self, value_8, "SRA");
-                    self->cpu_registers.l = new_value_8;
-                    break;
-                case iHL: // TODO: Wwwwhyyyyyyyy I need to find out how to work these 16-bit pointers soonnnnn
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "SRA");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-            }
-            break;
-		// SLA (shift left arithmetic) - arithmetic shift a specific register left by 1
-        case SLA:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "SLA");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    new_value_8 = shift_rot(self, value_8, "SLA");
-                    self->cpu_registers.b = new_value_8;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    new_value_8 = shift_rot(self, value_8, "SLA");
-                    self->cpu_registers.c = new_value_8;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    new_value_8 = shift_rot(self, value_8, "SLA");
-                    self->cpu_registers.d = new_value_8;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    new_value_8 = shift_rot(self, value_8, "SLA");
-                    self->cpu_registers.e = new_value_8;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    new_value_8 = shift_rot(self, value_8, "SLA");
-                    self->cpu_registers.h = new_value_8;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    new_value_8 = shift_rot(self, value_8, "SLA");
-                    self->cpu_registers.l = new_value_8;
-                    break;
-                case iHL: // TODO: Wwwwhyyyyyyyy I need to find out how to work these 16-bit pointers soonnnnn
-                    value_8 = self->cpu_registers.a;
-                    new_value_8 = shift_rot(self, value_8, "SLA");
-                    self->cpu_registers.a = new_value_8;
-                    break;
-            }
-            break;
-		// SWAP (swap nibbles) - switch upper and lower nibble of a specific register
-        case SWAP:
-            switch (target) {
-                case A:
-                    swap_nibbles(self, &self->cpu_registers.a);
-                    break;
-                case B:
-                    swap_nibbles(self, &self->cpu_registers.b);
-                    break;
-                case C:
-                    swap_nibbles(self, &self->cpu_registers.c);
-                    break;
-                case D:
-                    swap_nibbles(self, &self->cpu_registers.d);
-                    break;
-                case E:
-                    swap_nibbles(self, &self->cpu_registers.e);
-                    break;
-                case H:
-                    swap_nibbles(self, &self->cpu_registers.h);
-                    break;
-                case L:
-                    swap_nibbles(self, &self->cpu_registers.l);
-                    break;
-                case iHL: // TODO: WHYYYY
-                    swap_nibbles(self, &self->cpu_registers.a);
-                    break;
-            }
-            break;
+// The register an opcode was bound to. Targets are byte offsets into the registers struct (see registers.h)
+static inline uint8_t *register_8 (cpu *self, uint8_t target) {
+    return ((uint8_t *) &self->cpu_registers) + target;
+}
+
+// Same thing for BC, DE and HL, where the target is the offset of the high register
+static inline uint16_t get_pair (cpu *self, uint8_t target) {
+    uint8_t *high = register_8(self, target);
+    return (((uint16_t) high[0]) << 8) | (uint16_t) high[1];
+}
+static inline void set_pair (cpu *self, uint8_t target, uint16_t value) {
+    uint8_t *high = register_8(self, target);
+    high[0] = (uint8_t) (value >> 8);
+    high[1] = (uint8_t) (value & 0xFF);
+}
+
+// Check a JR/JP/CALL/RET condition against the flags (no need to resolve all of F just for this)
+static inline bool condition_met (cpu *self, uint8_t condition) {
+    switch (condition) {
+        case COND_NZ:
+            return !zero_flag(self);
+        case COND_Z:
+            return zero_flag(self);
+        case COND_NC:
+            return !carry_flag(self);
+        default:
+            return carry_flag(self);
+    }
+}
+
+
+// --  Misc / control  --
+
+// NOP (no operation) - does nothing, which is harder to get wrong than the rest of these
+uint8_t nop (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    return 0;
+}
+
+// STOP - on the DMG this stops the CPU and LCD until a button is pressed. For now it's treated like HALT (which a
+// button press wakes up too, through the joypad interrupt)
+uint8_t stop (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->halted = true;
+    return 0;
+}
+
+// HALT - stop running instructions until an interrupt happens
+uint8_t halt (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->halted = true;
+    // If one's already pending, it wakes right back up
+    check_interrupts(self);
+    return 0;
+}
+
+// DI (disable interrupts) - takes effect straight away, and also cancels an EI that hasn't kicked in yet
+uint8_t di (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->ime = false;
+    self->ime_scheduled = false;
+    return 0;
+}
+
+// EI (enable interrupts) - only takes effect after the next instruction (step() takes care of that)
+uint8_t ei (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->ime_scheduled = true;
+    return 0;
+}
+
+// CB prefix - the byte after 0xCB picks an instruction from the second table. The primary table says this costs
+// nothing, so the whole cost comes from the CB table entry.
+uint8_t prefix_cb (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+
+    uint8_t cb_byte = read_byte(&self->bus, self->pc);
+    self->pc += 1;
+
+    const opcode *op = &cb_table[cb_byte];
+
+    return op->cycles + op->handler(self, op->target, op->source, 0);
+
+}
+
+// Opcodes that don't exist on the Game Boy (0xD3, 0xDB, ...). Real hardware locks up: the CPU stops for good and
+// interrupts can't get it going again, only turning it off and on. Locked implies halted, so everything that skips
+// ahead while the CPU is halted does the same here
+uint8_t illegal (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->locked = true;
+    self->halted = true;
+    return 0;
+}
+
+
+// --  8-bit loads  --
+
+// LD r, r' - copy one register into another
+uint8_t ld_r_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    *register_8(self, target) = *register_8(self, source);
+    return 0;
+}
+
+// LD r, n - load the inmediate value n into a register
+uint8_t ld_r_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    *register_8(self, target) = (uint8_t) immediate;
+    return 0;
+}
+
+// LD r, (HL) - load the byte at the address in HL into a register
+uint8_t ld_r_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    *register_8(self, target) = read_byte(&self->bus, get_hl(self->cpu_registers));
+    return 0;
+}
+
+// LD (HL), r - store a register at the address in HL
+uint8_t ld_ihl_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    write_byte(&self->bus, get_hl(self->cpu_registers), *register_8(self, source));
+    return 0;
+}
+
+// LD (HL), n - store the inmediate value n at the address in HL
+uint8_t ld_ihl_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    write_byte(&self->bus, get_hl(self->cpu_registers), (uint8_t) immediate);
+    return 0;
+}
+
+// LD A, (BC) / LD A, (DE)
+uint8_t ld_a_irr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->cpu_registers.a = read_byte(&self->bus, get_pair(self, target));
+    return 0;
+}
+
+// LD (BC), A / LD (DE), A
+uint8_t ld_irr_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    write_byte(&self->bus, get_pair(self, target), self->cpu_registers.a);
+    return 0;
+}
+
+// LD A, (nn)
+uint8_t ld_a_inn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->cpu_registers.a = read_byte(&self->bus, immediate);
+    return 0;
+}
+
+// LD (nn), A
+uint8_t ld_inn_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    write_byte(&self->bus, immediate, self->cpu_registers.a);
+    return 0;
+}
+
+// LD A, (HL+) / LD A, (HL-) - load from (HL), then increment or decrement HL
+uint8_t ld_a_ihli (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    self->cpu_registers.a = read_byte(&self->bus, hl);
+    set_hl(&self->cpu_registers, hl + 1);
+    return 0;
+}
+uint8_t ld_a_ihld (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    self->cpu_registers.a = read_byte(&self->bus, hl);
+    set_hl(&self->cpu_registers, hl - 1);
+    return 0;
+}
+
+// LD (HL+), A / LD (HL-), A - store to (HL), then increment or decrement HL
+uint8_t ld_ihli_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, self->cpu_registers.a);
+    set_hl(&self->cpu_registers, hl + 1);
+    return 0;
+}
+uint8_t ld_ihld_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, self->cpu_registers.a);
+    set_hl(&self->cpu_registers, hl - 1);
+    return 0;
+}
+
+// LDH A, (n) / LDH (n), A - the "high" loads, for addresses 0xFF00 + n (I/O registers and HRAM)
+uint8_t ldh_a_in (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->cpu_registers.a = read_byte(&self->bus, 0xFF00 | (immediate & 0xFF));
+    return 0;
+}
+uint8_t ldh_in_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    write_byte(&self->bus, 0xFF00 | (immediate & 0xFF), self->cpu_registers.a);
+    return 0;
+}
+
+// LDH A, (C) / LDH (C), A - same as above but the offset comes from register C
+uint8_t ldh_a_ic (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->cpu_registers.a = read_byte(&self->bus, 0xFF00 | self->cpu_registers.c);
+    return 0;
+}
+uint8_t ldh_ic_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    write_byte(&self->bus, 0xFF00 | self->cpu_registers.c, self->cpu_registers.a);
+    return 0;
+}
+
+
+// --  16-bit loads  --
+
+// LD rr, nn - load a 16-bit inmediate value into BC, DE or HL
+uint8_t ld_rr_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    set_pair(self, target, immediate);
+    return 0;
+}
+uint8_t ld_sp_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->sp = immediate;
+    return 0;
+}
+
+// LD (nn), SP - store SP at nn, low byte first
+uint8_t ld_inn_sp (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    write_word(&self->bus, immediate, self->sp);
+    return 0;
+}
+
+// LD SP, HL
+uint8_t ld_sp_hl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->sp = get_hl(self->cpu_registers);
+    return 0;
+}
+
+// LD HL, SP+e - same math (and flags) as ADD SP, e, but the result goes to HL
+uint8_t ld_hl_sp_e (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    set_hl(&self->cpu_registers, add_sp(self, (int8_t) immediate));
+    return 0;
+}
+
+// PUSH rr / POP rr
+uint8_t push_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    push_word(self, get_pair(self, target));
+    return 0;
+}
+uint8_t pop_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    set_pair(self, target, pop_word(self));
+    return 0;
+}
+
+// PUSH AF / POP AF - A and F aren't next to each other, and the lower nibble of F always reads as zero.
+// This is one of the places the lazy flags have to be worked out for real
+uint8_t push_af (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    push_word(self, (((uint16_t) self->cpu_registers.a) << 8) | get_f(self));
+    return 0;
+}
+uint8_t pop_af (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t af = pop_word(self);
+    self->cpu_registers.a = (uint8_t) (af >> 8);
+    set_f(self, (uint8_t) (af & 0xFF));
+    return 0;
+}
+
+
+// --  8-bit arithmetic/logic  --
+// Each instruction comes in three flavours: a register, the byte at (HL), and an inmediate value n.
+
+// ADD (add) - simple instruction that adds specific register's contents to the A register's contents.
+static inline void alu_add (cpu *self, uint8_t value) {
+    self->cpu_registers.a = arthins_a(self, value, ARITH_ADD);
+}
+uint8_t add_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_add(self, *register_8(self, target));
+    return 0;
+}
+uint8_t add_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_add(self, read_byte(&self->bus, get_hl(self->cpu_registers)));
+    return 0;
+}
+uint8_t add_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_add(self, (uint8_t) immediate);
+    return 0;
+}
+
+// ADC (add with carry) - just like ADD except that the value of the carry flag is also added to the number
+static inline void alu_adc (cpu *self, uint8_t value) {
+    self->cpu_registers.a = arthins_a(self, value, ARITH_ADC);
+}
+uint8_t adc_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_adc(self, *register_8(self, target));
+    return 0;
+}
+uint8_t adc_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_adc(self, read_byte(&self->bus, get_hl(self->cpu_registers)));
+    return 0;
+}
+uint8_t adc_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_adc(self, (uint8_t) immediate);
+    return 0;
+}
+
+// SUB (subtract) - subtract the value stored in a specific register with the value in the A register
+static inline void alu_sub (cpu *self, uint8_t value) {
+    self->cpu_registers.a = arthins_a(self, value, ARITH_SUB);
+}
+uint8_t sub_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_sub(self, *register_8(self, target));
+    return 0;
+}
+uint8_t sub_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_sub(self, read_byte(&self->bus, get_hl(self->cpu_registers)));
+    return 0;
+}
+uint8_t sub_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_sub(self, (uint8_t) immediate);
+    return 0;
+}
+
+// SBC (subtract with carry) - just like SUB except that the value of the carry flag is also subtracted from the number
+static inline void alu_sbc (cpu *self, uint8_t value) {
+    self->cpu_registers.a = arthins_a(self, value, ARITH_SBC);
+}
+uint8_t sbc_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_sbc(self, *register_8(self, target));
+    return 0;
+}
+uint8_t sbc_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_sbc(self, read_byte(&self->bus, get_hl(self->cpu_registers)));
+    return 0;
+}
+uint8_t sbc_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_sbc(self, (uint8_t) immediate);
+    return 0;
+}
+
+// AND (logical and) - do a bitwise and on the value in a specific register and the value in the A register
+static inline void alu_and (cpu *self, uint8_t value) {
+
+    record_flags(self, FLAGS_AND, self->cpu_registers.a, value, 0, self->cpu_registers.a & value);
+    self->cpu_registers.a &= value;
+
+}
+uint8_t and_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_and(self, *register_8(self, target));
+    return 0;
+}
+uint8_t and_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_and(self, read_byte(&self->bus, get_hl(self->cpu_registers)));
+    return 0;
+}
+uint8_t and_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_and(self, (uint8_t) immediate);
+    return 0;
+}
+
+// XOR (logical xor) - do a bitwise xor on the value in a specific register and the value in the A register
+static inline void alu_xor (cpu *self, uint8_t value) {
+
+    // Same flags as OR
+    record_flags(self, FLAGS_OR, self->cpu_registers.a, value, 0, self->cpu_registers.a ^ value);
+    self->cpu_registers.a ^= value;
+
+}
+uint8_t xor_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_xor(self, *register_8(self, target));
+    return 0;
+}
+uint8_t xor_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_xor(self, read_byte(&self->bus, get_hl(self->cpu_registers)));
+    return 0;
+}
+uint8_t xor_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_xor(self, (uint8_t) immediate);
+    return 0;
+}
+
+// OR (logical or) - do a bitwise or on the value in a specific register and the value in the A register
+static inline void alu_or (cpu *self, uint8_t value) {
+
+    record_flags(self, FLAGS_OR, self->cpu_registers.a, value, 0, self->cpu_registers.a | value);
+    self->cpu_registers.a |= value;
+
+}
+uint8_t or_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_or(self, *register_8(self, target));
+    return 0;
+}
+uint8_t or_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_or(self, read_byte(&self->bus, get_hl(self->cpu_registers)));
+    return 0;
+}
+uint8_t or_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    alu_or(self, (uint8_t) immediate);
+    return 0;
+}
+
+// CP (compare) - just like SUB except the result of the subtraction is not stored back into A
+uint8_t cp_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    arthins_a(self, *register_8(self, target), ARITH_SUB);
+    return 0;
+}
+uint8_t cp_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    arthins_a(self, read_byte(&self->bus, get_hl(self->cpu_registers)), ARITH_SUB);
+    return 0;
+}
+uint8_t cp_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    arthins_a(self, (uint8_t) immediate, ARITH_SUB);
+    return 0;
+}
+
+// INC (increment) - increment the value in a specific register by 1
+uint8_t inc_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = incdec_8(self, *r, INCDEC_INC);
+    return 0;
+}
+uint8_t inc_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, incdec_8(self, read_byte(&self->bus, hl), INCDEC_INC));
+    return 0;
+}
+
+// DEC (decrement) - decrement the value in a specific register by 1
+uint8_t dec_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = incdec_8(self, *r, INCDEC_DEC);
+    return 0;
+}
+uint8_t dec_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, incdec_8(self, read_byte(&self->bus, hl), INCDEC_DEC));
+    return 0;
+}
+
+// DAA (decimal adjust) - see decimal_adjust in the helpers
+uint8_t daa (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    decimal_adjust(self);
+    return 0;
+}
+
+// CPL (complement) - toggle every bit of the A register
+uint8_t cpl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+
+    self->cpu_registers.a = ~self->cpu_registers.a;
+
+    update_flags(self, FLAG_SUBTRACT | FLAG_HALF_CARRY, FLAG_SUBTRACT | FLAG_HALF_CARRY);
+
+    return 0;
+}
+
+// SCF (set carry flag) - set the carry flag to true
+// NOTE: CCF and SCF also set subtract and half-carry's flags to false
+uint8_t scf (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+
+    update_flags(self, FLAG_SUBTRACT | FLAG_HALF_CARRY | FLAG_CARRY, FLAG_CARRY);
+
+    return 0;
+}
+
+// CCF (complement carry flag) - toggle the value of the carry flag
+uint8_t ccf (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+
+    bool carry = carry_flag(self);
+
+    update_flags(self, FLAG_SUBTRACT | FLAG_HALF_CARRY | FLAG_CARRY, flag_if(!carry, FLAG_CARRY));
+
+    return 0;
+}
+
+
+// --  16-bit arithmetic  --
+
+// ADDHL (add to HL) - just like ADD except that the target is added to the HL register
+uint8_t add_hl_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    set_hl(&self->cpu_registers, add_hl(self, get_pair(self, target)));
+    return 0;
+}
+uint8_t add_hl_sp (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    set_hl(&self->cpu_registers, add_hl(self, self->sp));
+    return 0;
+}
+
+// ADDSP (add to SP) - add a signed inmediate value to SP
+uint8_t add_sp_e (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->sp = add_sp(self, (int8_t) immediate);
+    return 0;
+}
+
+// INC rr / DEC rr - 16-bit increment and decrement. No flags here
+uint8_t inc_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    set_pair(self, target, incdec_16(self, get_pair(self, target), INCDEC_INC));
+    return 0;
+}
+uint8_t inc_sp (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->sp = incdec_16(self, self->sp, INCDEC_INC);
+    return 0;
+}
+uint8_t dec_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    set_pair(self, target, incdec_16(self, get_pair(self, target), INCDEC_DEC));
+    return 0;
+}
+uint8_t dec_sp (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->sp = incdec_16(self, self->sp, INCDEC_DEC);
+    return 0;
+}
+
+
+// --  Rotates on A  --
+
+// RLCA (rotate left A register) - bit rotate A register left (not through the carry flag)
+uint8_t rlca (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->cpu_registers.a = rotate_a(self, SHIFT_RLC);
+    return 0;
+}
+
+// RRCA (rotate right A register) - bit rotate A register right (not through the carry flag)
+uint8_t rrca (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->cpu_registers.a = rotate_a(self, SHIFT_RRC);
+    return 0;
+}
+
+// RLA (rotate left A register) - bit rotate A register left through the carry flag
+uint8_t rla (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->cpu_registers.a = rotate_a(self, SHIFT_RL);
+    return 0;
+}
+
+// RRA (rotate right A register) - bit rotate A register right through the carry flag
+// NOTE: "Through the carry flag" means that the contents in the carry flag are copied to the bit left behind
+uint8_t rra (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->cpu_registers.a = rotate_a(self, SHIFT_RR);
+    return 0;
+}
+
+
+// --  Jumps, calls and returns  --
+// The PC has already moved past the whole instruction by the time these run, so "the next instruction" is just self->pc
+
+// JP nn - jump to nn
+uint8_t jp_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->pc = immediate;
+    return 0;
+}
+
+// JP cc, nn - jump to nn if the condition is met
+uint8_t jp_cc_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+
+    if (!condition_met(self, target)) {
+        return 0;
     }
 
+    self->pc = immediate;
+    return 4;
+}
+
+// JP HL - jump to the address in HL (not the byte at HL, despite how it's often written)
+uint8_t jp_hl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->pc = get_hl(self->cpu_registers);
     return 0;
+}
 
+// JR e - relative jump by a signed offset
+uint8_t jr_e (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->pc += (int8_t) immediate;
+    return 0;
 }
 
-// TODO: Move all functions that needed N values to execute_n
-int execute_n (cpu *self, Instruction instruction, ArithmeticTarget target, uint8_t inmediate_value) {
-
-    // Define the value set because apparently scope is weird in c switch statements
-	uint8_t value_8;
-	uint8_t new_value_8;
-
-	uint16_t value_16;
-	uint16_t new_value_16;
-
-
-    switch(target) {
-
-        // ADD n (add inmediate): Adds to the 8-bit A register, the immediate data n, 
-		// and stores the result back into the A register.
-        case ADD:
-            if (target == N) {
-			    value_8 = inmediate_value;
-
-                new_value_8 = arthins_a(self, value_8, "ADD");
-                self->cpu_registers.a = new_value_8;
-            } else {
-                return 2;
-            }
-
-            break;
-
-        // ADDSP (add to HL) - just like ADD except that the target is added to the SP register and the value is signed
-        // via twos' complement
-        // TODO: check if this actually works to turn this into a twos' complement or not
-		case ADDSP:
-			if (target == N) {
-				value_8 = ~inmediate_value + 1; // Twos complement: complement the number and add 1 to it.
-
-				new_value_16 = add_sp(self, value_8); // Change with a new function for the contents of sp
-				self->sp = new_value_16;
-				break;
-			} else {
-                return 2;
-            }
-			break;
-        
-        // ADC n (adc inmediate): Adds to the 8-bit A register, the immediate data n and the carry flag, 
-		// and stores the result back into the A register.
-        case ADC:
-            if (target == N) {
-                value_8 = inmediate_value;
-
-                new_value_8 = arthins_a(self, value_8, "ADC");
-                self->cpu_registers.a = new_value_8;
-            } else {
-                return 2;
-            }
-        // SUB n : SUB inmediate value n
-        case SUB:
-            if (target == N) {
-                value_8 = inmediate_value;
-
-                new_value_8 = arthins_a(self, value_8, "SUB");
-                self->cpu_registers.a = new_value_8;
-            } else {
-                return 2;
-            }
-
-            break;
-        // SBC n : SBC inmediate value n
-        case SBC:
-            if (target == N) {
-                value_8 = inmediate_value;
-
-                new_value_8 = arthins_a(self, value_8, "SBC");
-                self->cpu_registers.a = new_value_8;
-            } else {
-                return 2;
-            }
-
-            break;
-        // AND n: AND inmediate value n
-        case AND:
-            if (target == N) {
-                self->cpu_registers.a &= inmediate_value;
-
-                // Evaluate flags
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", (self->cpu_registers.a == 0));
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", true);
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", false);
-            } else {
-                return 2;
-            }
-
-            break;
-        // OR n: OR inmediate value n
-        case OR:
-            if (target == N) {
-                self->cpu_registers.a |= inmediate_value;
-
-                // Evaluate flags
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", (self->cpu_registers.a == 0));
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", false);
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", false);
-            } else {
-                return 2;
-            }
-            break;
-        // XOR n: XOR inmediate value n
-        case XOR:
-            if (target == N) {
-                self->cpu_registers.a ^= inmediate_value;
-                    
-                // Evaluate flags
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "zero", (self->cpu_registers.a == 0));
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "subtract", false);
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "half_carry", false);
-                self->cpu_registers.f = set_flag(self->cpu_registers.f, "carry", false);
-            } else {
-                return 2;
-            }
-            break; 
-        // CP n: CP inmediate value n, which in itself copies SUB
-        case CP:
-            if (target == N) {
-                value_8 = inmediate_value;
-                arthins_a(self, value_8, "SUB");
-            }
-            
-            break;
-
-
-
-
-
-
-
-
-        // BIT (bit test) - test to see if a specific bit of a specific register is set
-        case BIT:
-            switch (target) {
-                case A:
-                    value_8 = self->cpu_registers.a;
-                    break;
-                case B:
-                    value_8 = self->cpu_registers.b;
-                    break;
-                case C:
-                    value_8 = self->cpu_registers.c;
-                    break;
-                case D:
-                    value_8 = self->cpu_registers.d;
-                    break;
-                case E:
-                    value_8 = self->cpu_registers.e;
-                    break;
-                case H:
-                    value_8 = self->cpu_registers.h;
-                    break;
-                case L:
-                    value_8 = self->cpu_registers.l;
-                    break;
-                // TODO: YOu know, this repo is currently public and I'm just screaming into these to-dos.
-                // I hope this shows in the future how I get better at programming these things.
-                case iHL:
-                    value_8 = 0;
-                    break;
-            }
-            
-            if (inmediate_value >= 0 && inmediate_value <= 7) {
-                bit_test(self, value_8, inmediate_value);
-            } else {
-                return 2;
-            }
-
-            break;
-
-
-		// RES (bit reset) - set a specific bit of a specific register to 0
-        case RES:
-            if (inmediate_value >= 0 && inmediate_value <= 7) { 
-                switch (target) {
-                    case A:
-                        value_8 = self->cpu_registers.a;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "RES");
-                        
-                        self->cpu_registers.a = new_value_8;
-                        break;
-                    case B:
-                        value_8 = self->cpu_registers.b;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "RES");
-
-                        self->cpu_registers.b = new_value_8;
-                        break;
-                    case C:
-                        value_8 = self->cpu_registers.c;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "RES");
-
-                        self->cpu_registers.c = new_value_8;
-                        break;
-                    case D:
-                        value_8 = self->cpu_registers.d;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "RES");
-
-                        self->cpu_registers.d = new_value_8;
-                        break;
-                    case E:
-                        value_8 = self->cpu_registers.e;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "RES");
-
-                        self->cpu_registers.e = new_value_8;
-                        break;
-                    case H:
-                        value_8 = self->cpu_registers.h;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "RES");
-
-                        self->cpu_registers.h = new_value_8;
-                        break;
-                    case L:
-                        value_8 = self->cpu_registers.l;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "RES");
-
-                        self->cpu_registers.l = new_value_8;
-                        break;
-                    // TODO: YOu know, this repo is currently public and I'm just screaming into these to-dos.
-                    // I hope this shows in the future how I get better at programming these things.
-                    case iHL:
-                        value_8 = 0;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "RES");
-                        break;
-                }
-            } else {
-                return 2;
-            }
-            break;
-		// SET (bit set) - set a specific bit of a specific register to 1
-        case SET:
-            if (inmediate_value >= 0 && inmediate_value <= 7) {
-                switch (target) {
-                    case A:
-                        value_8 = self->cpu_registers.a;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "SET");
-                        
-                        self->cpu_registers.a = new_value_8;
-                        break;
-                    case B:
-                        value_8 = self->cpu_registers.b;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "SET");
-
-                        self->cpu_registers.b = new_value_8;
-                        break;
-                    case C:
-                        value_8 = self->cpu_registers.c;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "SET");
-
-                        self->cpu_registers.c = new_value_8;
-                        break;
-                    case D:
-                        value_8 = self->cpu_registers.d;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "SET");
-
-                        self->cpu_registers.d = new_value_8;
-                        break;
-                    case E:
-                        value_8 = self->cpu_registers.e;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "SET");
-
-                        self->cpu_registers.e = new_value_8;
-                        break;
-                    case H:
-                        value_8 = self->cpu_registers.h;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "SET");
-
-                        self->cpu_registers.h = new_value_8;
-                        break;
-                    case L:
-                        value_8 = self->cpu_registers.l;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "SET");
-
-                        self->cpu_registers.l = new_value_8;
-                        break;
-                    // TODO: YOu know, this repo is currently public and I'm just screaming into these to-dos.
-                    // I hope this shows in the future how I get better at programming these things.
-                    case iHL:
-                        value_8 = 0;
-                        new_value_8 = bit_setting(value_8, inmediate_value, "SET");
-                        break;
-                }
-            } else {
-                return 2;
-            }
-            break;
+// JR cc, e - relative jump if the condition is met
+uint8_t jr_cc_e (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
 
+    if (!condition_met(self, target)) {
+        return 0;
     }
+
+    self->pc += (int8_t) immediate;
+    return 4;
+}
+
+// CALL nn - push the address of the next instruction and jump to nn
+uint8_t call_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    push_word(self, self->pc);
+    self->pc = immediate;
+    return 0;
+}
+
+// CALL cc, nn - same, but only if the condition is met
+uint8_t call_cc_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+
+    if (!condition_met(self, target)) {
+        return 0;
+    }
+
+    push_word(self, self->pc);
+    self->pc = immediate;
+    return 12;
+}
+
+// RET - pop the return address back into PC
+uint8_t ret (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->pc = pop_word(self);
+    return 0;
+}
+
+// RET cc - return if the condition is met
+uint8_t ret_cc (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+
+    if (!condition_met(self, target)) {
+        return 0;
+    }
+
+    self->pc = pop_word(self);
+    return 12;
+}
+
+// RETI - return and enable interrupts straight away (no delay like EI)
+uint8_t reti (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    self->pc = pop_word(self);
+    self->ime = true;
+    check_interrupts(self);
+    return 0;
+}
+
+// RST n - call one of the eight fixed addresses at the start of memory. The target is the address itself
+uint8_t rst (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    push_word(self, self->pc);
+    self->pc = target;
     return 0;
+}
 
-}
\ No newline at end of file
+
+// --  CB prefix  --
+// Same deal as the ALU: one handler for registers and one for (HL), which has to read, change and write back.
+
+// RLC (rotate left) - bit rotate a specific register left by 1 (not through the carry flag)
+uint8_t rlc_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = shift_rot(self, *r, SHIFT_RLC);
+    return 0;
+}
+uint8_t rlc_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, shift_rot(self, read_byte(&self->bus, hl), SHIFT_RLC));
+    return 0;
+}
+
+// RRC (rotate right) - bit rotate a specific register right by 1 (not through the carry flag)
+uint8_t rrc_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = shift_rot(self, *r, SHIFT_RRC);
+    return 0;
+}
+uint8_t rrc_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, shift_rot(self, read_byte(&self->bus, hl), SHIFT_RRC));
+    return 0;
+}
+
+// RL (rotate left) - bit rotate a specific register left by 1 through the carry flag
+uint8_t rl_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = shift_rot(self, *r, SHIFT_RL);
+    return 0;
+}
+uint8_t rl_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, shift_rot(self, read_byte(&self->bus, hl), SHIFT_RL));
+    return 0;
+}
+
+// RR (rotate right) - bit rotate a specific register right by 1 through the carry flag
+uint8_t rr_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = shift_rot(self, *r, SHIFT_RR);
+    return 0;
+}
+uint8_t rr_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, shift_rot(self, read_byte(&self->bus, hl), SHIFT_RR));
+    return 0;
+}
+
+// SLA (shift left arithmetic) - arithmetic shift a specific register left by 1
+uint8_t sla_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = shift_rot(self, *r, SHIFT_SLA);
+    return 0;
+}
+uint8_t sla_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, shift_rot(self, read_byte(&self->bus, hl), SHIFT_SLA));
+    return 0;
+}
+
+// SRA (shift right arithmetic) - arithmetic shift a specific register right by 1
+uint8_t sra_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = shift_rot(self, *r, SHIFT_SRA);
+    return 0;
+}
+uint8_t sra_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, shift_rot(self, read_byte(&self->bus, hl), SHIFT_SRA));
+    return 0;
+}
+
+// SWAP (swap nibbles) - switch upper and lower nibble of a specific register
+uint8_t swap_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    swap_nibbles(self, register_8(self, target));
+    return 0;
+}
+uint8_t swap_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    uint8_t value = read_byte(&self->bus, hl);
+    swap_nibbles(self, &value);
+    write_byte(&self->bus, hl, value);
+    return 0;
+}
+
+// SRL (shift right logical) - bit shift a specific register right by 1
+uint8_t srl_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = shift_rot(self, *r, SHIFT_SRL);
+    return 0;
+}
+uint8_t srl_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, shift_rot(self, read_byte(&self->bus, hl), SHIFT_SRL));
+    return 0;
+}
+
+// BIT (bit test) - test to see if a specific bit of a specific register is set. The bit number comes in as the source
+uint8_t bit_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    bit_test(self, *register_8(self, target), source);
+    return 0;
+}
+uint8_t bit_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    bit_test(self, read_byte(&self->bus, get_hl(self->cpu_registers)), source);
+    return 0;
+}
+
+// RES (bit reset) - set a specific bit of a specific register to 0
+uint8_t res_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = res_bit(*r, source);
+    return 0;
+}
+uint8_t res_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, res_bit(read_byte(&self->bus, hl), source));
+    return 0;
+}
+
+// SET (bit set) - set a specific bit of a specific register to 1
+uint8_t set_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint8_t *r = register_8(self, target);
+    *r = set_bit(*r, source);
+    return 0;
+}
+uint8_t set_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate) {
+    uint16_t hl = get_hl(self->cpu_registers);
+    write_byte(&self->bus, hl, set_bit(read_byte(&self->bus, hl), source));
+    return 0;
+}
@@ -5,93 +5,150 @@
 #include <stdbool.h>
 #include "cpu-struct.h"
 
-/* Various instructions to the CPU 
+/* Various instructions to the CPU
 
-    TODO: (add remaining instructions)
-*/
-typedef enum {
-    ADD, 
-    ADDHL,
-	ADDSP,
-    ADC,
-    SUB,
-    SBC,
-    AND, 
-    OR,
-    XOR, 
-    CP,
-    INC,
-    DEC,
-    CCF,
-    SCF,
-    RRA,
-    RLA,
-    RRCA,
-    RLCA,
-    CPL,
-    BIT,
-    RES,
-    SET,
-    SRL, 
-    RR,
-    RL,
-    RRC,
-    RLC,
-    SRA,
-    SLA,
-    SWAP,
-} Instruction;
-
-/* The Register target for the Instruction*/
-typedef enum { 
-    A,
-    B,
-    C,
-    D,
-    E,
-    H,
-    L,
-	AF,
-	BC,
-	DE,
-	HL,
-    iHL,
-	SP,
-	N
-} ArithmeticTarget;
-
-//TODO: Split execute function in two, having the execute function as an intermediary
-int execute_mono (cpu *self, Instruction instruction, ArithmeticTarget target);
-int execute_n (cpu *self, Instruction instruction, ArithmeticTarget target, uint8_t inmediate_value);
-
-
-
-void execute (cpu *self, Instruction instruction, ArithmeticTarget target, bool uses_n, ...);
-
-void execute (cpu *self, Instruction instruction, ArithmeticTarget target, bool uses_n, ...) {
+    Every instruction is its own handler, and the decoder (decoder.c) binds each opcode to one of them along with
+    the operands it works on, so nothing here has to figure out "which instruction?" or "which register?" at runtime:
 
-    if (uses_n == true) {
-
-        // Declare inmediate value
-        uint8_t n;
-
-        // Initialize our variadic number, a single 8-bit value that can or can not be passed in
-		va_list args;
-		va_start(args, uses_n);
-
-		// If value exists, place it in a variable. If not, just put it as null and move on.
-		// TODO: Apparently there are some instructions that may need this inmediate value to be signed, so I'll need to account for those later on
-		n = va_arg(args, int);
-
-		va_end(args);
-
-        execute_n(self, instruction, target, n);
-        
-    } else {
-        execute_mono (self, instruction, target);
-    }
-
-}
+     - target: the register (an offset from registers.h), register pair, condition or RST vector the opcode uses
+     - source: the second register for LD r, r' and the bit number for BIT, RES and SET
+     - immediate: the 8 or 16-bit value that came after the opcode, already read for us
 
+    Every handler returns the extra cycles it took on top of what the decoder table says (only taken jumps, calls
+    and returns take any).
+*/
 
-#endif
\ No newline at end of file
+// Conditions for JR, JP, CALL and RET
+typedef enum {
+    COND_NZ,
+    COND_Z,
+    COND_NC,
+    COND_C
+} Condition;
+
+// -- Misc / control --
+uint8_t nop (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t stop (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t halt (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t di (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ei (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t prefix_cb (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t illegal (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+// -- 8-bit loads --
+uint8_t ld_r_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_r_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_r_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_ihl_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_ihl_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_a_irr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_irr_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_a_inn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_inn_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_a_ihli (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_a_ihld (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_ihli_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_ihld_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ldh_a_in (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ldh_in_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ldh_a_ic (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ldh_ic_a (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+// -- 16-bit loads --
+uint8_t ld_rr_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_sp_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_inn_sp (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_sp_hl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ld_hl_sp_e (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t push_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t push_af (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t pop_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t pop_af (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+// -- 8-bit arithmetic/logic --
+uint8_t add_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t add_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t add_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t adc_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t adc_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t adc_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sub_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sub_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sub_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sbc_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sbc_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sbc_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t and_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t and_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t and_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t xor_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t xor_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t xor_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t or_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t or_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t or_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t cp_a_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t cp_a_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t cp_a_n (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t inc_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t inc_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t dec_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t dec_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t daa (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t cpl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t scf (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ccf (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+// -- 16-bit arithmetic --
+uint8_t add_hl_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t add_hl_sp (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t add_sp_e (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t inc_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t inc_sp (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t dec_rr (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t dec_sp (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+// -- Rotates on A --
+uint8_t rlca (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rrca (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rla (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rra (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+// -- Jumps, calls and returns --
+uint8_t jp_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t jp_cc_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t jp_hl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t jr_e (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t jr_cc_e (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t call_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t call_cc_nn (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ret (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t ret_cc (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t reti (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rst (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+// -- CB prefix: shifts, rotates and bit operations --
+uint8_t rlc_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rlc_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rrc_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rrc_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rl_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rl_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rr_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t rr_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sla_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sla_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sra_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t sra_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t swap_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t swap_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t srl_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t srl_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t bit_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t bit_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t res_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t res_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t set_r (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+uint8_t set_ihl (cpu *self, uint8_t target, uint8_t source, uint16_t immediate);
+
+#endif
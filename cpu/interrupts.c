@@ -0,0 +1,70 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+// Local libraries
+#include "cpu-struct.h"
+#include "instructions-helpers.h"
+#include "interrupts.h"
+#include "memorybus.h"
+#include "scheduler.h"
+
+
+// Writing IF or IE can make an interrupt pending straight away
+static void interrupt_register_write (void *context, uint16_t address, uint8_t value) {
+
+    cpu *self = context;
+
+    *bus_memory_write(&self->bus, address) = value;
+    check_interrupts(self);
+
+}
+
+// EVENT_INTERRUPT: jump to the handler of the highest priority interrupt that's pending, if there is one
+static void service_interrupts (void *context, uint64_t time) {
+
+    cpu *self = context;
+    uint8_t pending = *bus_memory(&self->bus, IF_ADDRESS) & *bus_memory(&self->bus, IE_ADDRESS) & 0x1F;
+
+    // Nothing gets a locked up CPU going again (see illegal in instructions.c)
+    if (pending == 0 || self->locked) {
+        return;
+    }
+
+    // HALT ends as soon as something's pending, even if IME is off (then it just carries on after the HALT)
+    self->halted = false;
+
+    if (!self->ime) {
+        return;
+    }
+
+    // The lowest bit goes first: VBlank is 0x40, STAT 0x48, timer 0x50, serial 0x58 and joypad 0x60
+    uint8_t bit = 0;
+    while (((pending >> bit) & 1) == 0) {
+        bit += 1;
+    }
+
+    self->ime = false;
+    *bus_memory_write(&self->bus, IF_ADDRESS) &= ~(1 << bit);
+
+    push_word(self, self->pc);
+    self->pc = 0x40 + bit * 8;
+
+    // Two wait states, the push and the jump
+    self->cycles += 20;
+
+}
+
+void init_interrupts (cpu *self) {
+
+    map_io_register(&self->bus, IF_ADDRESS, NULL, interrupt_register_write, self);
+    map_io_register(&self->bus, IE_ADDRESS, NULL, interrupt_register_write, self);
+    set_event_handler(&self->scheduler, EVENT_INTERRUPT, service_interrupts, self);
+
+}
+
+void request_interrupt (cpu *self, uint8_t interrupt) {
+
+    *bus_memory_write(&self->bus, IF_ADDRESS) |= interrupt;
+    check_interrupts(self);
+
+}
@@ -0,0 +1,40 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <stdint.h>
+#include "cpu-struct.h"
+#include "scheduler.h"
+
+/* -- Interrupts --
+    IF (0xFF0F) says which interrupts have been requested, and IE (0xFFFF) which ones the game cares about. When one
+    is in both and IME is on, the CPU stops what it's doing, pushes the PC and jumps to that interrupt's handler.
+
+    Since the CPU only stops to look at anything when an event is due (see scheduler.h), everything that could
+    make an interrupt go through (requesting one, writing IF or IE, EI, RETI, HALT) schedules an EVENT_INTERRUPT
+    right now, and the check happens as soon as the current instruction is done.
+*/
+
+#define IF_ADDRESS 0xFF0F
+#define IE_ADDRESS 0xFFFF
+
+// The bits in IF and IE. Lower bits win when more than one is pending
+typedef enum {
+    INTERRUPT_VBLANK = 0x01,
+    INTERRUPT_STAT = 0x02,
+    INTERRUPT_TIMER = 0x04,
+    INTERRUPT_SERIAL = 0x08,
+    INTERRUPT_JOYPAD = 0x10
+} Interrupt;
+
+// Hook IF and IE up to the bus and the interrupt check up to the scheduler
+void init_interrupts (cpu *self);
+
+// Something changed that might let an interrupt through, so check once this instruction is done
+static inline void check_interrupts (cpu *self) {
+    schedule_event(&self->scheduler, EVENT_INTERRUPT, self->cycles);
+}
+
+// Set an interrupt's bit in IF
+void request_interrupt (cpu *self, uint8_t interrupt);
+
+#endif
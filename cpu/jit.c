@@ -0,0 +1,802 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+// Local libraries
+#include "alu-tables.h"
+#include "block-cache.h"
+#include "cpu-struct.h"
+#include "decoder.h"
+#include "instructions.h"
+#include "flags-register.h"
+#include "jit.h"
+#include "registers.h"
+
+#if defined(JIT_RECOMPILER) && defined(__x86_64__)
+
+#include <sys/mman.h>
+
+
+// --  Host registers  --
+
+// x86 register numbers
+enum HostRegister {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+/* Register plan inside a translated block:
+    r15: the cpu pointer
+    ebx: how many instructions it ran (that's what we return)
+    r8d-r14d: A, B, C, D, E, H, L (zero-extended, only the low byte means anything)
+    eax, ecx, edx, esi, edi: scratch and call arguments
+   F, SP, PC and the clock stay in the cpu struct. Calls clobber r8-r11, so every call gets the guest registers written back
+   before it and read again after it, which is also what lets the handler see (and change) them.
+*/
+static const int8_t host_register[8] = {
+    [REG_A] = R8,
+    [REG_B] = R9,
+    [REG_C] = R10,
+    [REG_D] = R11,
+    [REG_E] = R12,
+    [REG_H] = R13,
+    [REG_L] = R14,
+    [offsetof(registers, f)] = -1
+};
+
+// Where the guest registers live in the cpu struct
+#define GUEST_OFFSET(reg) ((int32_t) (offsetof(cpu, cpu_registers) + (reg)))
+#define PC_OFFSET ((int32_t) offsetof(cpu, pc))
+#define CYCLES_OFFSET ((int32_t) offsetof(cpu, cycles))
+#define NEXT_EVENT_OFFSET ((int32_t) (offsetof(cpu, scheduler) + offsetof(scheduler, next)))
+// And the lazy flags (see flags-register.h)
+#define FLAGS_OFFSET(field) ((int32_t) (offsetof(cpu, flags) + offsetof(lazy_flags, field)))
+
+
+// --  Emitting code  --
+
+typedef struct Emitter {
+    uint8_t *code;
+    size_t size;
+    size_t capacity;
+
+    // The ways out for events partway through (see emit_check_event), which go after the rest of the block
+    struct {
+        size_t jump;
+        uint16_t pc;
+        uint8_t done;
+    } exits[BLOCK_MAX_OPS];
+    uint8_t exit_count;
+    // Where each instruction's code starts, to be jumped into from the prologue
+    size_t entries[BLOCK_MAX_OPS];
+} emitter;
+
+static void emit (emitter *e, uint8_t byte) {
+    if (e->size < e->capacity) {
+        e->code[e->size] = byte;
+    }
+    e->size += 1;
+}
+static void emit_32 (emitter *e, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        emit(e, (uint8_t) (value >> (8 * i)));
+    }
+}
+static void emit_64 (emitter *e, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        emit(e, (uint8_t) (value >> (8 * i)));
+    }
+}
+// Fill in a rel32 that was emitted as a placeholder at, to jump to wherever we've got to now
+static void patch_jump (emitter *e, size_t at) {
+    uint32_t offset = (uint32_t) (e->size - (at + 4));
+    for (int i = 0; i < 4; i++) {
+        if (at + i < e->capacity) {
+            e->code[at + i] = (uint8_t) (offset >> (8 * i));
+        }
+    }
+}
+
+// mov dst32, src32
+static void emit_mov_reg (emitter *e, int dst, int src) {
+    uint8_t rex = 0x40 | ((src >= 8) ? 0x04 : 0) | ((dst >= 8) ? 0x01 : 0);
+    if (rex != 0x40) {
+        emit(e, rex);
+    }
+    emit(e, 0x89);
+    emit(e, 0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+// mov dst32, imm32
+static void emit_mov_imm (emitter *e, int dst, uint32_t value) {
+    if (dst >= 8) {
+        emit(e, 0x41);
+    }
+    emit(e, 0xB8 + (dst & 7));
+    emit_32(e, value);
+}
+
+// movzx dst32, byte [r15 + offset]
+static void emit_load_byte (emitter *e, int dst, int32_t offset) {
+    emit(e, 0x41 | ((dst >= 8) ? 0x04 : 0));
+    emit(e, 0x0F);
+    emit(e, 0xB6);
+    emit(e, 0x80 | ((dst & 7) << 3) | 7);
+    emit_32(e, (uint32_t) offset);
+}
+
+// mov byte [r15 + offset], src8 (there's always a REX, so 4-7 are SPL-DIL, never AH-BH)
+static void emit_store_byte (emitter *e, int src, int32_t offset) {
+    emit(e, 0x41 | ((src >= 8) ? 0x04 : 0));
+    emit(e, 0x88);
+    emit(e, 0x80 | ((src & 7) << 3) | 7);
+    emit_32(e, (uint32_t) offset);
+}
+
+// mov byte [r15 + offset], imm8
+static void emit_store_byte_imm (emitter *e, int32_t offset, uint8_t value) {
+    emit(e, 0x41);
+    emit(e, 0xC6);
+    emit(e, 0x87);
+    emit_32(e, (uint32_t) offset);
+    emit(e, value);
+}
+
+// movzx dst32, src8 (src is one of the scratch registers, eax to edx)
+static void emit_movzx_byte (emitter *e, int dst, int src) {
+    if (dst >= 8) {
+        emit(e, 0x44);
+    }
+    emit(e, 0x0F);
+    emit(e, 0xB6);
+    emit(e, 0xC0 | ((dst & 7) << 3) | src);
+}
+
+// op dst32, src32, for the ALU instructions that take their opcode as the "r/m, r" form (add 0x01, or 0x09,
+// and 0x21, sub 0x29, xor 0x31, cmp 0x39). Both are scratch registers
+static void emit_alu_reg (emitter *e, uint8_t opcode, int dst, int src) {
+    emit(e, opcode);
+    emit(e, 0xC0 | (src << 3) | dst);
+}
+
+// jcc rel32 (or jmp, with condition 0xFF) with the offset left for patch_jump. Returns where the offset is
+static size_t emit_jump (emitter *e, uint8_t condition) {
+    if (condition == 0xFF) {
+        emit(e, 0xE9);
+    } else {
+        emit(e, 0x0F);
+        emit(e, condition);
+    }
+    size_t at = e->size;
+    emit_32(e, 0);
+    return at;
+}
+#define JUMP_ALWAYS 0xFF
+#define JUMP_EQUAL 0x84
+#define JUMP_NOT_EQUAL 0x85
+#define JUMP_ABOVE_EQUAL 0x83
+
+// mov word [r15 + PC_OFFSET], imm16
+static void emit_set_pc (emitter *e, uint16_t value) {
+    emit(e, 0x66);
+    emit(e, 0x41);
+    emit(e, 0xC7);
+    emit(e, 0x80 | 7);
+    emit_32(e, (uint32_t) PC_OFFSET);
+    emit(e, (uint8_t) (value & 0xFF));
+    emit(e, (uint8_t) (value >> 8));
+}
+
+// add qword [r15 + CYCLES_OFFSET], imm32
+static void emit_add_cycles (emitter *e, uint32_t cycles) {
+    emit(e, 0x49); emit(e, 0x81); emit(e, 0x87);
+    emit_32(e, (uint32_t) CYCLES_OFFSET);
+    emit_32(e, cycles);
+}
+
+// Write every guest register back to the cpu struct / read them all again
+static void emit_spill (emitter *e) {
+    for (int reg = 0; reg < 8; reg++) {
+        if (host_register[reg] >= 0) {
+            emit_store_byte(e, host_register[reg], GUEST_OFFSET(reg));
+        }
+    }
+}
+static void emit_reload (emitter *e) {
+    for (int reg = 0; reg < 8; reg++) {
+        if (host_register[reg] >= 0) {
+            emit_load_byte(e, host_register[reg], GUEST_OFFSET(reg));
+        }
+    }
+}
+
+static void emit_prologue (emitter *e) {
+    emit(e, 0x53);                              // push rbx
+    emit(e, 0x55);                              // push rbp
+    emit(e, 0x41); emit(e, 0x54);               // push r12
+    emit(e, 0x41); emit(e, 0x55);               // push r13
+    emit(e, 0x41); emit(e, 0x56);               // push r14
+    emit(e, 0x41); emit(e, 0x57);               // push r15
+    emit(e, 0x48); emit(e, 0x83); emit(e, 0xEC); emit(e, 0x08);    // sub rsp, 8 (keeps calls 16-byte aligned)
+    emit(e, 0x49); emit(e, 0x89); emit(e, 0xFF);                   // mov r15, rdi
+    emit_reload(e);
+}
+
+// Jump to the instruction the caller asked to start from (esi), through the table at the end (see emit_entries)
+static size_t emit_dispatch (emitter *e) {
+    emit(e, 0x89); emit(e, 0xF0);                                  // mov eax, esi
+    emit(e, 0x48); emit(e, 0x8D); emit(e, 0x0D);                   // lea rcx, [rip + table]
+    size_t table = e->size;
+    emit_32(e, 0);
+    emit(e, 0xFF); emit(e, 0x24); emit(e, 0xC1);                   // jmp [rcx + rax * 8]
+    return table;
+}
+
+// The table emit_dispatch jumps through: where every instruction's code starts
+static void emit_entries (emitter *e, size_t table, uint8_t count) {
+    patch_jump(e, table);
+    for (uint8_t i = 0; i < count; i++) {
+        emit_64(e, (uint64_t) (uintptr_t) (e->code + e->entries[i]));
+    }
+}
+
+// Where a block stops: the guest registers go back, and the instructions it ran (ebx) get returned
+static void emit_epilogue (emitter *e) {
+    emit_spill(e);
+    emit(e, 0x89); emit(e, 0xD8);               // mov eax, ebx
+    emit(e, 0x48); emit(e, 0x83); emit(e, 0xC4); emit(e, 0x08);    // add rsp, 8
+    emit(e, 0x41); emit(e, 0x5F);               // pop r15
+    emit(e, 0x41); emit(e, 0x5E);               // pop r14
+    emit(e, 0x41); emit(e, 0x5D);               // pop r13
+    emit(e, 0x41); emit(e, 0x5C);               // pop r12
+    emit(e, 0x5D);                              // pop rbp
+    emit(e, 0x5B);                              // pop rbx
+    emit(e, 0xC3);                              // ret
+}
+
+// 16-bit INC/DEC on a register pair: eax = (high << 8) | low, +/- 1, then split it back up
+static void emit_incdec_pair (emitter *e, uint8_t target, bool increment) {
+
+    int high = host_register[target];
+    int low = host_register[target + 1];
+
+    emit(e, 0x44); emit(e, 0x89); emit(e, 0xC0 | ((high & 7) << 3));            // mov eax, high
+    emit(e, 0xC1); emit(e, 0xE0); emit(e, 0x08);                                 // shl eax, 8
+    emit(e, 0x44); emit(e, 0x09); emit(e, 0xC0 | ((low & 7) << 3));             // or eax, low
+    emit(e, 0xFF); emit(e, increment ? 0xC0 : 0xC8);                             // inc/dec eax
+    emit(e, 0x44); emit(e, 0x0F); emit(e, 0xB6); emit(e, 0xC0 | ((low & 7) << 3));   // movzx low, al
+    emit(e, 0xC1); emit(e, 0xE8); emit(e, 0x08);                                 // shr eax, 8
+    emit(e, 0x44); emit(e, 0x0F); emit(e, 0xB6); emit(e, 0xC0 | ((high & 7) << 3));  // movzx high, al
+
+}
+
+// edx = the carry flag, worked out from the lazy flags the same way lazy_carry does
+static void emit_carry (emitter *e) {
+
+    emit_load_byte(e, RAX, FLAGS_OFFSET(operation));
+    emit(e, 0x83); emit(e, 0xF8); emit(e, FLAGS_ADD);              // cmp eax, FLAGS_ADD
+    size_t to_add = emit_jump(e, JUMP_EQUAL);
+    emit(e, 0x83); emit(e, 0xF8); emit(e, FLAGS_SUB);              // cmp eax, FLAGS_SUB
+    size_t to_sub = emit_jump(e, JUMP_EQUAL);
+    emit_alu_reg(e, 0x85, RAX, RAX);                               // test eax, eax
+    size_t to_cleared = emit_jump(e, JUMP_NOT_EQUAL);
+
+    // Resolved: straight out of F
+    emit_load_byte(e, RDX, GUEST_OFFSET(offsetof(registers, f)));
+    emit(e, 0xC1); emit(e, 0xEA); emit(e, 0x04);                   // shr edx, 4
+    emit(e, 0x83); emit(e, 0xE2); emit(e, 0x01);                   // and edx, 1
+    size_t done_resolved = emit_jump(e, JUMP_ALWAYS);
+
+    // ADD: left + right + carry > 0xFF
+    patch_jump(e, to_add);
+    emit_load_byte(e, RDX, FLAGS_OFFSET(left));
+    emit_load_byte(e, RAX, FLAGS_OFFSET(right));
+    emit_alu_reg(e, 0x01, RDX, RAX);
+    emit_load_byte(e, RAX, FLAGS_OFFSET(carry));
+    emit_alu_reg(e, 0x01, RDX, RAX);
+    emit(e, 0xC1); emit(e, 0xEA); emit(e, 0x08);                   // shr edx, 8
+    size_t done_add = emit_jump(e, JUMP_ALWAYS);
+
+    // SUB: left < right + carry
+    patch_jump(e, to_sub);
+    emit_load_byte(e, RAX, FLAGS_OFFSET(right));
+    emit_load_byte(e, RDX, FLAGS_OFFSET(carry));
+    emit_alu_reg(e, 0x01, RAX, RDX);
+    emit_load_byte(e, RDX, FLAGS_OFFSET(left));
+    emit_alu_reg(e, 0x39, RDX, RAX);                               // cmp edx, eax
+    emit(e, 0x0F); emit(e, 0x92); emit(e, 0xC2);                   // setb dl
+    emit_movzx_byte(e, RDX, RDX);
+    size_t done_sub = emit_jump(e, JUMP_ALWAYS);
+
+    // AND, OR and XOR always clear it
+    patch_jump(e, to_cleared);
+    emit_alu_reg(e, 0x31, RDX, RDX);                               // xor edx, edx
+
+    patch_jump(e, done_resolved);
+    patch_jump(e, done_add);
+    patch_jump(e, done_sub);
+
+}
+
+// The 8-bit ALU on A: work it out in eax and write down what happened in the lazy flags, exactly what arthins_a
+// and alu_and/alu_or/alu_xor do. value is a guest register, or an immediate if it's negative
+static void emit_alu (emitter *e, opcode_handler handler, int value, uint8_t immediate) {
+
+    bool add = (handler == add_a_r || handler == add_a_n || handler == adc_a_r || handler == adc_a_n);
+    bool with_carry = (handler == adc_a_r || handler == adc_a_n || handler == sbc_a_r || handler == sbc_a_n);
+    bool compare = (handler == cp_a_r || handler == cp_a_n);
+    bool subtract = !add && (compare || handler == sub_a_r || handler == sub_a_n || with_carry);
+
+    // eax = A, ecx = the value, edx = the carry going in
+    if (with_carry) {
+        emit_carry(e);
+    }
+    emit_mov_reg(e, RAX, host_register[REG_A]);
+    if (value >= 0) {
+        emit_mov_reg(e, RCX, host_register[value]);
+    } else {
+        emit_mov_imm(e, RCX, immediate);
+    }
+
+    uint8_t operation;
+    uint8_t opcode;
+    if (add || subtract) {
+        operation = add ? FLAGS_ADD : FLAGS_SUB;
+        opcode = add ? 0x01 : 0x29;
+    } else if (handler == and_a_r || handler == and_a_n) {
+        operation = FLAGS_AND;
+        opcode = 0x21;
+    } else {
+        operation = FLAGS_OR;
+        opcode = (handler == or_a_r || handler == or_a_n) ? 0x09 : 0x31;
+    }
+
+    emit_store_byte_imm(e, FLAGS_OFFSET(operation), operation);
+    emit_store_byte(e, RAX, FLAGS_OFFSET(left));
+    emit_store_byte(e, RCX, FLAGS_OFFSET(right));
+    if (with_carry) {
+        emit_store_byte(e, RDX, FLAGS_OFFSET(carry));
+    } else {
+        emit_store_byte_imm(e, FLAGS_OFFSET(carry), 0);
+    }
+
+    emit_alu_reg(e, opcode, RAX, RCX);
+    if (with_carry) {
+        emit_alu_reg(e, opcode, RAX, RDX);
+    }
+    emit_store_byte(e, RAX, FLAGS_OFFSET(result));
+
+    // CP only keeps the flags
+    if (!compare) {
+        emit_movzx_byte(e, host_register[REG_A], RAX);
+    }
+
+}
+
+// INC/DEC r: the result and F out of alu_incdec, with the carry flag kept, like incdec_8. That leaves F resolved
+static void emit_incdec (emitter *e, uint8_t target, IncDecOperation operation) {
+
+    int reg = host_register[target];
+
+    emit_carry(e);
+
+    emit(e, 0x48); emit(e, 0xB9);                                  // mov rcx, the table
+    emit_64(e, (uint64_t) (uintptr_t) &alu_incdec[operation << 8]);
+    emit_mov_reg(e, RAX, reg);
+    emit(e, 0x0F); emit(e, 0xB7); emit(e, 0x04); emit(e, 0x41);    // movzx eax, word [rcx + rax * 2]
+    emit_movzx_byte(e, reg, RAX);
+
+    emit(e, 0xC1); emit(e, 0xE8); emit(e, 0x08);                   // shr eax, 8
+    emit(e, 0xC1); emit(e, 0xE2); emit(e, 0x04);                   // shl edx, 4
+    emit_alu_reg(e, 0x09, RAX, RDX);                               // or eax, edx
+    emit_store_byte(e, RAX, GUEST_OFFSET(offsetof(registers, f)));
+    emit_store_byte_imm(e, FLAGS_OFFSET(operation), FLAGS_RESOLVED);
+
+}
+
+// Call the interpreter's handler for op, exactly like run_block would
+static void emit_call_handler (emitter *e, const decoded_op *op) {
+
+    emit_spill(e);
+    emit(e, 0x4C); emit(e, 0x89); emit(e, 0xFF);    // mov rdi, r15
+    emit_mov_imm(e, RSI, op->target);
+    emit_mov_imm(e, RDX, op->source);
+    emit_mov_imm(e, RCX, op->immediate);
+    emit(e, 0x48); emit(e, 0xB8); emit_64(e, (uint64_t) (uintptr_t) op->handler);   // mov rax, handler
+    emit(e, 0xFF); emit(e, 0xD0);                   // call rax
+    emit(e, 0x0F); emit(e, 0xB6); emit(e, 0xC0);    // movzx eax, al
+    emit(e, 0x49); emit(e, 0x01); emit(e, 0x87);    // add [r15 + CYCLES_OFFSET], rax
+    emit_32(e, (uint32_t) CYCLES_OFFSET);
+    emit_reload(e);
+
+}
+
+
+// --  What can be translated  --
+
+// The 8-bit ALU on A, with a register or an immediate
+static bool is_alu_register (opcode_handler handler) {
+    return handler == add_a_r || handler == adc_a_r || handler == sub_a_r || handler == sbc_a_r ||
+        handler == and_a_r || handler == xor_a_r || handler == or_a_r || handler == cp_a_r;
+}
+static bool is_alu_immediate (opcode_handler handler) {
+    return handler == add_a_n || handler == adc_a_n || handler == sub_a_n || handler == sbc_a_n ||
+        handler == and_a_n || handler == xor_a_n || handler == or_a_n || handler == cp_a_n;
+}
+
+// Turned straight into x86
+static bool is_native (opcode_handler handler) {
+    return handler == nop || handler == ld_r_r || handler == ld_r_n || handler == ld_rr_nn ||
+        handler == inc_rr || handler == dec_rr || handler == ld_sp_nn ||
+        is_alu_register(handler) || is_alu_immediate(handler) || handler == inc_r || handler == dec_r ||
+        handler == jp_nn || handler == jr_e;
+}
+
+// Only touch registers and flags (and maybe PC), so calling their handler from the middle of a block is safe
+static bool is_register_only (opcode_handler handler) {
+    return handler == daa || handler == cpl || handler == scf || handler == ccf ||
+        handler == add_hl_rr || handler == add_hl_sp || handler == add_sp_e || handler == ld_hl_sp_e ||
+        handler == ld_sp_hl || handler == inc_sp || handler == dec_sp ||
+        handler == rlca || handler == rrca || handler == rla || handler == rra ||
+        handler == rlc_r || handler == rrc_r || handler == rl_r || handler == rr_r ||
+        handler == sla_r || handler == sra_r || handler == swap_r || handler == srl_r ||
+        handler == bit_r || handler == res_r || handler == set_r ||
+        handler == jp_cc_nn || handler == jr_cc_e || handler == jp_hl || handler == di;
+}
+
+// These move the PC somewhere else, so nothing after them can be in the translation
+static bool is_branch (opcode_handler handler) {
+    return handler == jp_nn || handler == jr_e || handler == jp_cc_nn || handler == jr_cc_e || handler == jp_hl;
+}
+
+// After instruction number done, leave the block if the next event is due, the same as run_block would. next is
+// where the PC goes on from there. The way out goes at the end (see emit_exits), so the usual path is just a compare
+// and a jump that isn't taken
+static void emit_check_event (emitter *e, uint8_t done, uint16_t next) {
+
+    emit(e, 0x49); emit(e, 0x8B); emit(e, 0x87);    // mov rax, [r15 + CYCLES_OFFSET]
+    emit_32(e, (uint32_t) CYCLES_OFFSET);
+    emit(e, 0x49); emit(e, 0x3B); emit(e, 0x87);    // cmp rax, [r15 + NEXT_EVENT_OFFSET]
+    emit_32(e, (uint32_t) NEXT_EVENT_OFFSET);
+
+    e->exits[e->exit_count].jump = emit_jump(e, JUMP_ABOVE_EQUAL);
+    e->exits[e->exit_count].pc = next;
+    e->exits[e->exit_count].done = done;
+    e->exit_count += 1;
+
+}
+
+// Every way out from emit_check_event: set the PC and the count, and go to the epilogue at epilogue
+static void emit_exits (emitter *e, size_t epilogue) {
+
+    for (uint8_t i = 0; i < e->exit_count; i++) {
+        patch_jump(e, e->exits[i].jump);
+        emit_set_pc(e, e->exits[i].pc);
+        emit_mov_imm(e, RBX, e->exits[i].done);
+        emit(e, 0xE9);                              // jmp epilogue
+        emit_32(e, (uint32_t) (epilogue - (e->size + 4)));
+    }
+
+}
+
+// Translate one instruction (everything but the clock, see emit_op). address is where the instruction starts
+static void emit_op_body (emitter *e, const decoded_op *op, uint16_t address) {
+
+    uint16_t next = address + op->length;
+
+    if (op->handler == nop) {
+        return;
+    }
+    if (op->handler == ld_r_r) {
+        emit_mov_reg(e, host_register[op->target], host_register[op->source]);
+        return;
+    }
+    if (op->handler == ld_r_n) {
+        emit_mov_imm(e, host_register[op->target], op->immediate & 0xFF);
+        return;
+    }
+    if (op->handler == ld_rr_nn) {
+        emit_mov_imm(e, host_register[op->target], op->immediate >> 8);
+        emit_mov_imm(e, host_register[op->target + 1], op->immediate & 0xFF);
+        return;
+    }
+    if (op->handler == inc_rr || op->handler == dec_rr) {
+        emit_incdec_pair(e, op->target, op->handler == inc_rr);
+        return;
+    }
+    if (is_alu_register(op->handler)) {
+        // Like the handlers, the register's in target
+        emit_alu(e, op->handler, op->target, 0);
+        return;
+    }
+    if (is_alu_immediate(op->handler)) {
+        emit_alu(e, op->handler, -1, op->immediate & 0xFF);
+        return;
+    }
+    if (op->handler == inc_r || op->handler == dec_r) {
+        emit_incdec(e, op->target, (op->handler == inc_r) ? INCDEC_INC : INCDEC_DEC);
+        return;
+    }
+    if (op->handler == ld_sp_nn || op->handler == jp_nn || op->handler == jr_e) {
+        // Rare enough (or last in the block anyway) that calling the handler is fine
+        emit_set_pc(e, next);
+        emit_call_handler(e, op);
+        return;
+    }
+
+    // Everything else that made it this far is register-only. Handlers expect the PC to already be past them
+    if (is_branch(op->handler)) {
+        emit_set_pc(e, next);
+    }
+    emit_call_handler(e, op);
+
+}
+
+// The instruction, and then the clock, like the interpreter (handlers see the clock from before they ran, and
+// add whatever they return for taken branches on top)
+static void emit_op (emitter *e, const decoded_op *op, uint16_t address) {
+    emit_op_body(e, op, address);
+    emit_add_cycles(e, op->cycles);
+}
+
+
+// --  Arena  --
+
+// Throw away every translation (the blocks still point at the old code, so they need to forget it too)
+static void jit_flush (cpu *self) {
+
+    self->jit->used = 0;
+
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        self->blocks->blocks[i].native = NULL;
+        self->blocks->blocks[i].native_ops = 0;
+        self->blocks->blocks[i].hits = 0;
+    }
+
+}
+
+void enable_jit (cpu *self, bool verify) {
+
+    if (self->jit != NULL) {
+        self->jit->verify = verify;
+        return;
+    }
+
+    enable_block_cache(self);
+    if (self->blocks == NULL) {
+        return;
+    }
+
+    jit *new_jit = calloc(1, sizeof(jit));
+    if (new_jit == NULL) {
+        return;
+    }
+
+    // Writable while we're putting code in it, executable while we're running it, never both
+    new_jit->arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (new_jit->arena == MAP_FAILED) {
+        free(new_jit);
+        return;
+    }
+
+    new_jit->verify = verify;
+    self->jit = new_jit;
+
+}
+
+void disable_jit (cpu *self) {
+
+    if (self->jit == NULL) {
+        return;
+    }
+
+    if (self->blocks != NULL) {
+        jit_flush(self);
+    }
+    munmap(self->jit->arena, JIT_ARENA_SIZE);
+    free(self->jit);
+    self->jit = NULL;
+
+}
+
+
+// --  Translating  --
+
+// Translate the first count instructions of b
+static void emit_block (emitter *e, const block *b, uint8_t count) {
+
+    uint16_t address = b->start;
+
+    emit_prologue(e);
+    size_t table = emit_dispatch(e);
+    for (uint8_t i = 0; i < count; i++) {
+        e->entries[i] = e->size;
+        emit_op(e, &b->ops[i], address);
+        address += b->ops[i].length;
+        // The last one's checked by run_block, which has to look anyway
+        if (i + 1 < count) {
+            emit_check_event(e, i + 1, address);
+        }
+    }
+
+    // A branch at the end already left the PC where it wants it, otherwise carry on after the last instruction
+    if (!is_branch(b->ops[count - 1].handler)) {
+        emit_set_pc(e, address);
+    }
+    emit_mov_imm(e, RBX, count);
+    size_t epilogue = e->size;
+    emit_epilogue(e);
+    emit_exits(e, epilogue);
+    emit_entries(e, table, count);
+
+}
+
+static void jit_compile (cpu *self, block *b) {
+
+    // How much of the block can we do? Stop at the first instruction that needs the interpreter
+    uint8_t count = 0;
+    while (count < b->count) {
+        opcode_handler handler = b->ops[count].handler;
+        if (!is_native(handler) && !is_register_only(handler)) {
+            break;
+        }
+        count += 1;
+        if (is_branch(handler)) {
+            break;
+        }
+    }
+
+    // Not worth it
+    if (count == 0) {
+        return;
+    }
+
+    // Emit once without writing anything to find out how big it is
+    emitter e = { .code = NULL };
+    emit_block(&e, b, count);
+
+    size_t size = e.size;
+    if (size > JIT_ARENA_SIZE) {
+        return;
+    }
+    if (self->jit->used + size > JIT_ARENA_SIZE) {
+        jit_flush(self);
+    }
+
+    uint8_t *code = self->jit->arena + self->jit->used;
+
+    if (mprotect(self->jit->arena, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        return;
+    }
+
+    // And now for real
+    e = (emitter) { .code = code, .capacity = size };
+    emit_block(&e, b, count);
+
+    mprotect(self->jit->arena, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC);
+
+    self->jit->used += size;
+    b->native = (native_block) code;
+    b->native_ops = count;
+
+}
+
+void jit_block_hit (cpu *self, block *b) {
+
+    if (b->native != NULL || b->hits > JIT_HOT_THRESHOLD) {
+        return;
+    }
+
+    b->hits += 1;
+    if (b->hits == JIT_HOT_THRESHOLD) {
+        jit_compile(self, b);
+    }
+
+}
+
+
+// --  Running  --
+
+// Everything a translated block can change
+typedef struct JitState {
+    registers cpu_registers;
+    lazy_flags flags;
+    uint16_t pc;
+    uint16_t sp;
+    bool ime;
+    bool ime_scheduled;
+    bool halted;
+    uint64_t cycles;
+} jit_state;
+
+static void save_state (cpu *self, jit_state *state) {
+    state->cpu_registers = self->cpu_registers;
+    state->flags = self->flags;
+    state->pc = self->pc;
+    state->sp = self->sp;
+    state->ime = self->ime;
+    state->ime_scheduled = self->ime_scheduled;
+    state->halted = self->halted;
+    state->cycles = self->cycles;
+}
+static void load_state (cpu *self, const jit_state *state) {
+    self->cpu_registers = state->cpu_registers;
+    self->flags = state->flags;
+    self->pc = state->pc;
+    self->sp = state->sp;
+    self->ime = state->ime;
+    self->ime_scheduled = state->ime_scheduled;
+    self->halted = state->halted;
+    self->cycles = state->cycles;
+}
+
+uint8_t jit_run (cpu *self, block *b, uint8_t first) {
+
+    if (!self->jit->verify) {
+        return b->native(self, first);
+    }
+
+    // Verify: run the native code, rewind, run the interpreter over the same instructions, and compare.
+    // Translated code never writes memory, so rewinding the cpu struct is enough
+    jit_state before, native_after, interpreted_after;
+
+    save_state(self, &before);
+    uint8_t native_ran = b->native(self, first);
+    save_state(self, &native_after);
+
+    load_state(self, &before);
+    uint8_t interpreted_ran = first;
+    while (interpreted_ran < b->native_ops) {
+        const decoded_op *op = &b->ops[interpreted_ran++];
+        self->pc += op->length;
+        self->cycles += op->cycles + op->handler(self, op->target, op->source, op->immediate);
+        if (self->cycles >= self->scheduler.next) {
+            break;
+        }
+    }
+    save_state(self, &interpreted_after);
+
+    // Both sides might still have lazy flags, so compare what F actually comes out to
+    native_after.cpu_registers.f = resolve_flags(&native_after.flags, native_after.cpu_registers.f);
+    interpreted_after.cpu_registers.f = resolve_flags(&interpreted_after.flags, interpreted_after.cpu_registers.f);
+
+    if (native_ran != interpreted_ran || native_after.cycles != interpreted_after.cycles ||
+        memcmp(&native_after.cpu_registers, &interpreted_after.cpu_registers, sizeof(registers)) != 0 ||
+        native_after.pc != interpreted_after.pc || native_after.sp != interpreted_after.sp ||
+        native_after.ime != interpreted_after.ime || native_after.halted != interpreted_after.halted) {
+
+        printf("JIT mismatch in the block at 0x%04X (bank %u, %u instructions)\n", b->start, b->bank, b->native_ops);
+        printf("  jit:         A=%02X F=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X SP=%04X PC=%04X cycles=%llu ran=%u\n",
+            native_after.cpu_registers.a, native_after.cpu_registers.f, native_after.cpu_registers.b,
+            native_after.cpu_registers.c, native_after.cpu_registers.d, native_after.cpu_registers.e,
+            native_after.cpu_registers.h, native_after.cpu_registers.l, native_after.sp, native_after.pc,
+            (unsigned long long) native_after.cycles, native_ran);
+        printf("  interpreter: A=%02X F=%02X B=%02X C=%02X D=%02X E=%02X H=%02X L=%02X SP=%04X PC=%04X cycles=%llu ran=%u\n",
+            interpreted_after.cpu_registers.a, interpreted_after.cpu_registers.f, interpreted_after.cpu_registers.b,
+            interpreted_after.cpu_registers.c, interpreted_after.cpu_registers.d, interpreted_after.cpu_registers.e,
+            interpreted_after.cpu_registers.h, interpreted_after.cpu_registers.l, interpreted_after.sp,
+            interpreted_after.pc, (unsigned long long) interpreted_after.cycles, interpreted_ran);
+        abort();
+    }
+
+    return interpreted_ran;
+
+}
+
+#else
+
+// No JIT in this build (or not on x86-64): the block cache and interpreter do everything
+void enable_jit (cpu *self, bool verify) {
+}
+void disable_jit (cpu *self) {
+}
+void jit_block_hit (cpu *self, block *b) {
+}
+uint8_t jit_run (cpu *self, block *b, uint8_t first) {
+    return first;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "block-cache.h"
+#include "cpu-struct.h"
+
+/* -- JIT (dynamic recompiler) --
+    Turns hot blocks from the block cache into x86-64 machine code. Only built with JIT_RECOMPILER defined, and only
+    on x86-64 (everywhere else enable_jit just doesn't do anything).
+
+    Inside a translated block, A, B, C, D, E, H and L live in host registers (r8 to r14) instead of the cpu struct:
+
+     - Loads between registers, inmediate loads and 16-bit INC/DEC are turned straight into x86 instructions
+     - ADD/ADC/SUB/SBC/AND/XOR/OR/CP (on a register or an inmediate) and 8-bit INC/DEC are too. They write their
+       flags into the lazy record the same way the interpreter's helpers do, and INC/DEC go through alu_incdec
+     - Anything else that only touches registers (rotates, shifts, bit ops, conditional jumps) calls the exact same
+       handler the interpreter uses, so the flags come out bit-for-bit the same
+     - Anything that touches memory (which could be MMIO), the stack or interrupts stops the translation there, and
+       the interpreter picks up from that instruction
+
+    After every instruction the block checks whether an event is due and leaves if so. Next time around run_block
+    jumps straight back into the middle of the translation, so events don't send us back to the interpreter.
+
+    With verify turned on, every translated block is also run through the interpreter and the results compared.
+*/
+
+// How many times a block has to run before it gets translated
+#define JIT_HOT_THRESHOLD 16
+// Size of the executable arena. When it fills up, every translation is thrown away and we start over
+#define JIT_ARENA_SIZE (1 << 20)
+
+// What a translated block looks like from C. It starts from instruction first (0, unless the last run stopped
+// partway for an event), moves the cpu's clock along itself, and returns the instruction it got up to: the end of
+// the translation, or sooner if an event came due on the way (see run_block)
+typedef uint8_t (*native_block) (cpu *self, uint8_t first);
+
+typedef struct Jit {
+
+    uint8_t *arena;
+    size_t used;
+    // Run every translated block through the interpreter too, and abort if they ever disagree
+    bool verify;
+
+} jit;
+
+// Turn the JIT on (it needs the block cache, so this turns that on too), or off again
+void enable_jit (cpu *self, bool verify);
+void disable_jit (cpu *self);
+
+// Count a run of b, and translate it once it's hot. Does nothing if it can't be translated
+void jit_block_hit (cpu *self, block *b);
+
+// Run the translated part of b from instruction first on. Returns the instruction it got up to
+uint8_t jit_run (cpu *self, block *b, uint8_t first);
+
+#endif
@@ -1,13 +1,406 @@
 // Standard
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-// User 
+#include <stdlib.h>
+#include <string.h>
+// User
 #include "memorybus.h"
 
-// Read byte from 16-bit memory address
+
+// --  Default handlers  --
+
+// Writing to ROM doesn't change it. Cartridges with a mapper put their own handler here to catch bank switches
+static void ignore_write (void *context, uint16_t address, uint8_t value) {
+}
+
+// The I/O page: every register can have its own handler, and the ones that don't are plain memory
+static uint8_t io_page_read (void *context, uint16_t address) {
+
+    memorybus *self = context;
+    uint8_t index = io_index(address);
+
+    if (self->io_read[index] != NULL) {
+        return self->io_read[index](self->io_contexts[index], address);
+    }
+    return *bus_memory(self, address);
+
+}
+static void io_page_write (void *context, uint16_t address, uint8_t value) {
+
+    memorybus *self = context;
+    uint8_t index = io_index(address);
+
+    if (self->io_write[index] != NULL) {
+        self->io_write[index](self->io_contexts[index], address, value);
+        return;
+    }
+    *bus_memory_write(self, address) = value;
+
+}
+
+
+// --  Chunks  --
+
+static memory_chunk *new_chunk (void) {
+
+    memory_chunk *chunk = calloc(1, sizeof(memory_chunk));
+    // 4KB not being there is the end of the road anyway
+    if (chunk == NULL) {
+        abort();
+    }
+    chunk->refs = 1;
+    return chunk;
+
+}
+
+static void release_chunk (memory_chunk *chunk) {
+    if (__atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(chunk);
+    }
+}
+
+static inline bool chunk_shared (const memory_chunk *chunk) {
+    return __atomic_load_n(&chunk->refs, __ATOMIC_ACQUIRE) > 1;
+}
+
+static inline bool in_chunk (const uint8_t *pointer, const memory_chunk *chunk) {
+    return pointer >= chunk->data && pointer < chunk->data + MEMORY_CHUNK_SIZE;
+}
+
+// The chunk a page writes into, plus one (0 if it doesn't write into memory)
+static inline uint8_t page_chunk (const memorybus *self, uint8_t page) {
+    uint16_t memory_page = self->page_memory[page];
+    return (memory_page != 0) ? (memory_page - 1) / MEMORY_CHUNK_PAGES + 1 : 0;
+}
+
+// Give a page its write pointer, unless its writes have to go through the slow path for now: because the block
+// cache is watching it, because its chunk is shared, or because it isn't dirty yet and somebody wants to know
+// when it is
+static void set_write_page (memorybus *self, uint8_t page, uint8_t *write) {
+
+    uint16_t memory_page = self->page_memory[page];
+    uint8_t chunk = page_chunk(self, page);
+    self->shared_pages[page] = NULL;
+    self->clean_pages[page] = NULL;
+
+    // A page with cached code keeps going through the slow path, just with its new memory
+    if (self->watched_pages[page] != NULL) {
+        self->watched_pages[page] = write;
+    } else if (write != NULL && chunk != 0 && chunk_shared(self->chunks[chunk - 1])) {
+        self->shared_pages[page] = write;
+        self->write_pages[page] = NULL;
+    } else if (write != NULL && memory_page != 0 && self->track_dirty && !page_dirty(self, memory_page - 1)) {
+        self->clean_pages[page] = write;
+        self->write_pages[page] = NULL;
+    } else {
+        self->write_pages[page] = write;
+    }
+
+}
+
+
+// --  Mapping  --
+
+void init_memorybus (memorybus *self) {
+
+    memset(self->read_pages, 0, sizeof(self->read_pages));
+    memset(self->write_pages, 0, sizeof(self->write_pages));
+    memset(self->read_handlers, 0, sizeof(self->read_handlers));
+    memset(self->write_handlers, 0, sizeof(self->write_handlers));
+    memset(self->handler_contexts, 0, sizeof(self->handler_contexts));
+    memset(self->io_read, 0, sizeof(self->io_read));
+    memset(self->io_write, 0, sizeof(self->io_write));
+    memset(self->io_contexts, 0, sizeof(self->io_contexts));
+    memset(self->watched_pages, 0, sizeof(self->watched_pages));
+    memset(self->page_memory, 0, sizeof(self->page_memory));
+    memset(self->shared_pages, 0, sizeof(self->shared_pages));
+    memset(self->dirty, 0, sizeof(self->dirty));
+    self->track_dirty = false;
+    memset(self->clean_pages, 0, sizeof(self->clean_pages));
+
+    // The whole address space's worth of memory
+    memset(self->chunks, 0, sizeof(self->chunks));
+    for (self->chunk_count = 0; self->chunk_count < 0x10000 / MEMORY_CHUNK_SIZE; self->chunk_count++) {
+        self->chunks[self->chunk_count] = new_chunk();
+    }
+
+    // 0x0000-0x7FFF: ROM. Reads come straight out of memory, writes go nowhere
+    map_memory(self, 0x00, 0x80, 0x00, false);
+    map_handlers(self, 0x00, 0x80, NULL, ignore_write, self);
+
+    // 0x8000-0xDFFF: VRAM, cartridge RAM and WRAM
+    map_memory(self, 0x80, 0x60, 0x80, true);
+
+    // 0xE000-0xFDFF: echo RAM, which is just WRAM again
+    map_memory(self, 0xE0, 0x1E, 0xC0, true);
+
+    // 0xFE00-0xFEFF: OAM (and the unusable bit after it)
+    map_memory(self, 0xFE, 1, 0xFE, true);
+
+    // 0xFF00-0xFFFF: I/O registers, HRAM and IE
+    map_handlers(self, 0xFF, 1, io_page_read, io_page_write, self);
+
+    self->rom_bank_low = 0;
+    self->rom_bank = 1;
+    self->ram_bank = BUS_NO_RAM_BANK;
+
+}
+
+void free_memorybus (memorybus *self) {
+
+    for (uint8_t i = 0; i < self->chunk_count; i++) {
+        release_chunk(self->chunks[i]);
+        self->chunks[i] = NULL;
+    }
+    self->chunk_count = 0;
+
+}
+
+void map_pages (memorybus *self, uint8_t first_page, uint16_t count, const uint8_t *read, uint8_t *write) {
+
+    for (uint16_t i = 0; i < count; i++) {
+
+        uint8_t page = first_page + i;
+
+        self->read_pages[page] = (read != NULL) ? read + i * BUS_PAGE_SIZE : NULL;
+        self->page_memory[page] = 0;
+        set_write_page(self, page, (write != NULL) ? write + i * BUS_PAGE_SIZE : NULL);
+    }
+
+}
+
+void map_memory (memorybus *self, uint8_t first_page, uint16_t count, uint16_t memory_page, bool writable) {
+
+    for (uint16_t i = 0; i < count; i++) {
+
+        uint8_t page = first_page + i;
+        uint8_t chunk = (memory_page + i) / MEMORY_CHUNK_PAGES;
+        uint8_t *data = self->chunks[chunk]->data + ((memory_page + i) % MEMORY_CHUNK_PAGES) * BUS_PAGE_SIZE;
+
+        self->read_pages[page] = data;
+        self->page_memory[page] = writable ? memory_page + i + 1 : 0;
+        set_write_page(self, page, writable ? data : NULL);
+    }
+
+}
+
+uint16_t add_memory (memorybus *self, uint16_t count) {
+
+    uint8_t chunks = (count + MEMORY_CHUNK_PAGES - 1) / MEMORY_CHUNK_PAGES;
+    if (self->chunk_count + chunks > MEMORY_CHUNK_COUNT) {
+        return 0;
+    }
+
+    uint16_t first = self->chunk_count * MEMORY_CHUNK_PAGES;
+    for (uint8_t i = 0; i < chunks; i++) {
+        self->chunks[self->chunk_count++] = new_chunk();
+    }
+    return first;
+
+}
+
+void map_handlers (memorybus *self, uint8_t first_page, uint16_t count,
+    bus_read_handler read, bus_write_handler write, void *context) {
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint8_t page = first_page + i;
+        self->read_handlers[page] = read;
+        self->write_handlers[page] = write;
+        self->handler_contexts[page] = context;
+    }
+
+}
+
+void map_io_register (memorybus *self, uint16_t address, bus_read_handler read, bus_write_handler write, void *context) {
+
+    uint8_t index = io_index(address);
+    self->io_read[index] = read;
+    self->io_write[index] = write;
+    self->io_contexts[index] = context;
+
+}
+
+void watch_page (memorybus *self, uint16_t address) {
+
+    uint8_t page = address >> 8;
+
+    // Pages without a write pointer already take the slow path (but a shared or clean one will get its pointer
+    // back)
+    if (self->write_pages[page] != NULL) {
+        self->watched_pages[page] = self->write_pages[page];
+        self->write_pages[page] = NULL;
+    } else if (self->shared_pages[page] != NULL) {
+        self->watched_pages[page] = self->shared_pages[page];
+        self->shared_pages[page] = NULL;
+    } else if (self->clean_pages[page] != NULL) {
+        self->watched_pages[page] = self->clean_pages[page];
+        self->clean_pages[page] = NULL;
+    }
+
+}
+
+void unwatch_pages (memorybus *self) {
+
+    for (int page = 0; page < BUS_PAGE_COUNT; page++) {
+        uint8_t *write = self->watched_pages[page];
+        if (write != NULL) {
+            self->watched_pages[page] = NULL;
+            set_write_page(self, page, write);
+        }
+    }
+
+}
+
+
+// --  Sharing  --
+
+void share_memory (memorybus *self, memorybus *copy) {
+
+    for (uint8_t i = 0; i < self->chunk_count; i++) {
+        __atomic_add_fetch(&self->chunks[i]->refs, 1, __ATOMIC_ACQ_REL);
+    }
+
+    // Every page that writes straight into memory has to stop doing that, on both sides
+    for (int page = 0; page < BUS_PAGE_COUNT; page++) {
+        if (self->page_memory[page] != 0 && self->write_pages[page] != NULL) {
+            self->shared_pages[page] = self->write_pages[page];
+            self->write_pages[page] = NULL;
+        }
+        if (copy->page_memory[page] != 0 && copy->write_pages[page] != NULL) {
+            copy->shared_pages[page] = copy->write_pages[page];
+            copy->write_pages[page] = NULL;
+        }
+    }
+
+}
+
+void unshare_chunk (memorybus *self, uint8_t chunk) {
+
+    memory_chunk *old = self->chunks[chunk];
+    memory_chunk *copy = new_chunk();
+    memcpy(copy->data, old->data, MEMORY_CHUNK_SIZE);
+    self->chunks[chunk] = copy;
+
+    // Everything that pointed into the old one points into the copy now, and the pages that were waiting for it
+    // get to write straight into it again
+    for (int page = 0; page < BUS_PAGE_COUNT; page++) {
+
+        if (self->read_pages[page] != NULL && in_chunk(self->read_pages[page], old)) {
+            self->read_pages[page] = copy->data + (self->read_pages[page] - old->data);
+        }
+        if (self->watched_pages[page] != NULL && in_chunk(self->watched_pages[page], old)) {
+            self->watched_pages[page] = copy->data + (self->watched_pages[page] - old->data);
+        }
+        if (self->clean_pages[page] != NULL && in_chunk(self->clean_pages[page], old)) {
+            self->clean_pages[page] = copy->data + (self->clean_pages[page] - old->data);
+        }
+        if (self->shared_pages[page] != NULL && in_chunk(self->shared_pages[page], old)) {
+            set_write_page(self, page, copy->data + (self->shared_pages[page] - old->data));
+        }
+    }
+
+    release_chunk(old);
+
+}
+
+
+// --  Dirty pages  --
+
+// Point every page that writes into memory at it again, for when which ones are held back for being clean changed
+static void reset_write_pages (memorybus *self) {
+
+    for (int page = 0; page < BUS_PAGE_COUNT; page++) {
+        uint8_t *write = (self->clean_pages[page] != NULL) ? self->clean_pages[page] : self->write_pages[page];
+        if (self->page_memory[page] != 0 && write != NULL) {
+            set_write_page(self, page, write);
+        }
+    }
+
+}
+
+void track_dirty_pages (memorybus *self, bool track) {
+
+    self->track_dirty = track;
+    dirty_all_pages(self);
+    reset_write_pages(self);
+
+}
+
+void dirty_all_pages (memorybus *self) {
+    memset(self->dirty, 0xFF, sizeof(self->dirty));
+}
+
+void clear_dirty_pages (memorybus *self) {
+
+    memset(self->dirty, 0, sizeof(self->dirty));
+    if (self->track_dirty) {
+        reset_write_pages(self);
+    }
+
+}
+
+
+// --  Slow paths  --
+
 // NOTE: FINALLYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYYY Once I finish this implementation I hope to fix all the previous things in the instruction implementations
-uint8_t read_byte(memorybus self, uint16_t address) {
+uint8_t read_byte_slow (memorybus *self, uint16_t address) {
+
+    uint8_t page = address >> 8;
+
+    // HRAM and IE share their page with the I/O registers, but they're still plain memory (at least for reading)
+    if (address >= 0xFF80) {
+        return *bus_memory(self, address);
+    }
+
+    if (self->read_handlers[page] != NULL) {
+        return self->read_handlers[page](self->handler_contexts[page], address);
+    }
+
+    // Nothing mapped at all, so treat it as plain memory
+    return *bus_memory(self, address);
+
+}
+
+void write_byte_slow (memorybus *self, uint16_t address, uint8_t value) {
+
+    uint8_t page = address >> 8;
+    uint16_t memory_page = self->page_memory[page];
+    uint8_t chunk = page_chunk(self, page);
+
+    // The first write to a shared chunk gets the bus its own copy, and then it's like it never was shared. Or
+    // whoever it was shared with let go of it first, and it's ours already
+    if (chunk != 0 && chunk_shared(self->chunks[chunk - 1])) {
+        unshare_chunk(self, chunk - 1);
+    }
+    // And the first write to a clean page makes it dirty, so it doesn't need holding back for that anymore either
+    if (memory_page != 0) {
+        self->dirty[(memory_page - 1) / 8] |= 1 << ((memory_page - 1) % 8);
+    }
+    if (self->shared_pages[page] != NULL) {
+        set_write_page(self, page, self->shared_pages[page]);
+    }
+    if (self->clean_pages[page] != NULL) {
+        set_write_page(self, page, self->clean_pages[page]);
+    }
+    if (self->write_pages[page] != NULL) {
+        self->write_pages[page][address & 0xFF] = value;
+        return;
+    }
+
+    if (self->watched_pages[page] != NULL) {
+        self->watched_pages[page][address & 0xFF] = value;
+    } else if (address >= 0xFF80 && address != 0xFFFF) {
+        *bus_memory_write(self, address) = value;
+    } else if (self->write_handlers[page] != NULL) {
+        self->write_handlers[page](self->handler_contexts[page], address, value);
+    } else {
+        *bus_memory_write(self, address) = value;
+    }
 
-    uint8_t return_byte = self.memory[address];
-    return return_byte;
+    // Somebody's rewriting code we already decoded, so the block cache needs to forget about it
+    if (self->code_map != NULL && ((self->code_map[address >> 3] >> (address & 7)) & 1)) {
+        self->code_written(self->code_context, address);
+    }
 
-}
\ No newline at end of file
+}
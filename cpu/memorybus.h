@@ -1,16 +1,214 @@
 #ifndef MEMORYBUS_H
 #define MEMORYBUS_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-// Initialize the memory structure, which has 65,536 8-bit chunks of memory.
-// When referring to this array, I will call it as if it were the gameboy computer's memory (i.e. indexes will be called addresses).
+/* -- Memory bus --
+    The Gameboy sees 65,536 addresses, but they aren't all plain memory: some are the cartridge (which can switch
+    which ROM bank shows up where), some are I/O registers that do things when they get read or written, and some
+    are just mirrors of others.
+
+    So the address space is split into 256 pages of 256 bytes each, and every page has:
+
+     - A read pointer and a write pointer: if they're set, the page is plain memory and reading or writing is just
+       a load or a store (ROM, VRAM, WRAM, OAM...). Switching a bank is just pointing them somewhere else
+     - A read handler and a write handler for when the pointer is NULL: the I/O registers, ROM writes (which is how
+       cartridges get told to switch banks), and anything else that needs to run code when it's touched
+
+    By default (see init_memorybus) everything points into memory, the way the Gameboy would look with a 32KB
+    cartridge and no mapper.
+
+    The bus's own memory (the whole address space's worth, plus cartridge RAM) comes in 4KB chunks that get
+    counted, so a clone of an emulator can share every one of them instead of copying it (see share_memory). A page
+    whose chunk is shared has its write pointer held back, the same way watched pages do, and the first write to it
+    takes the slow path and gets the bus its own copy of the chunk. Reads never have to care.
+
+    Every 256-byte page of memory also has a dirty bit, set whenever it's written. Writes through handlers set it on
+    their way into memory (see bus_memory_write), and with track_dirty_pages on, pages that aren't dirty yet have
+    their write pointers held back too, so the first write to each takes the slow path and sets it. Clearing the
+    bits holds them back again, so between clears it costs one slow write per page written, whatever else happens.
+*/
+
+#define BUS_PAGE_COUNT 256
+#define BUS_PAGE_SIZE 256
+// What ram_bank says when 0xA000-0xBFFF isn't mapped to any RAM
+#define BUS_NO_RAM_BANK 0xFFFF
+
+#define MEMORY_CHUNK_SIZE 0x1000
+#define MEMORY_CHUNK_PAGES (MEMORY_CHUNK_SIZE / BUS_PAGE_SIZE)
+// 16 for the address space, and up to 128KB of cartridge RAM
+#define MEMORY_CHUNK_COUNT 48
+#define MEMORY_PAGE_COUNT (MEMORY_CHUNK_COUNT * MEMORY_CHUNK_PAGES)
+
+typedef struct MemoryChunk {
+
+    // How many buses have it. Clones can be running on other threads, so this only ever changes atomically
+    uint32_t refs;
+    uint8_t data[MEMORY_CHUNK_SIZE];
+
+} memory_chunk;
+
+// Handlers for the pages (and I/O registers) that aren't plain memory
+typedef uint8_t (*bus_read_handler) (void *context, uint16_t address);
+typedef void (*bus_write_handler) (void *context, uint16_t address, uint8_t value);
+
+// The I/O registers (0xFF00-0xFF7F) each get their own handler, since different parts of the Gameboy own them. IE
+// (0xFFFF) is out on its own past HRAM, but it's a register all the same, so it gets the slot after them
+#define IO_REGISTER_COUNT 0x81
+static inline uint8_t io_index (uint16_t address) {
+    return (address == 0xFFFF) ? 0x80 : (address & 0x7F);
+}
+
 typedef struct MemoryBus {
 
-    uint8_t memory[0xFFFF];
+    // Where each page lives, or NULL if it has to go through its handler
+    const uint8_t *read_pages[BUS_PAGE_COUNT];
+    uint8_t *write_pages[BUS_PAGE_COUNT];
+
+    bus_read_handler read_handlers[BUS_PAGE_COUNT];
+    bus_write_handler write_handlers[BUS_PAGE_COUNT];
+    void *handler_contexts[BUS_PAGE_COUNT];
+
+    // Handlers for single I/O registers. A NULL one is plain memory
+    bus_read_handler io_read[IO_REGISTER_COUNT];
+    bus_write_handler io_write[IO_REGISTER_COUNT];
+    void *io_contexts[IO_REGISTER_COUNT];
+
+    // Pages that hold cached code get their write pointer moved here, so writes to them take the slow path and the
+    // block cache gets to hear about them
+    uint8_t *watched_pages[BUS_PAGE_COUNT];
+
+    // The memory, which has 65,536 8-bit cells to begin with, in chunks. Anything that isn't mapped somewhere else
+    // lives here (see bus_memory), and I call places in it addresses, as if it were the gameboy computer's memory.
+    // Anything after the first 16 chunks got added later (see add_memory)
+    memory_chunk *chunks[MEMORY_CHUNK_COUNT];
+    uint8_t chunk_count;
+
+    // Which page of memory each page writes into (plus one, so 0 means it isn't writing into memory at all)
+    uint16_t page_memory[BUS_PAGE_COUNT];
+    // Pages whose chunk is shared with a clone get their write pointer moved here until it's been copied
+    uint8_t *shared_pages[BUS_PAGE_COUNT];
+
+    // One bit for every page of memory that's been written since the bits were last cleared, and whether writes
+    // through the page tables get caught too (pages that aren't dirty yet have their write pointer moved to
+    // clean_pages until they are)
+    uint8_t dirty[MEMORY_PAGE_COUNT / 8];
+    bool track_dirty;
+    uint8_t *clean_pages[BUS_PAGE_COUNT];
+
+    // Which ROM banks are showing at 0x0000-0x3FFF and 0x4000-0x7FFF. The cartridge (cartridge/cartridge.h) keeps
+    // these up to date, so the block cache can tell banks apart
+    uint16_t rom_bank_low;
+    uint16_t rom_bank;
+    // Same for the cartridge RAM bank at 0xA000-0xBFFF (BUS_NO_RAM_BANK when the handlers are there instead)
+    uint16_t ram_bank;
+
+    // Set by the block cache (block-cache.c): one bit for every address that holds cached code, and who to tell
+    // when one of those gets written. code_map is NULL when nothing is cached.
+    const uint8_t *code_map;
+    void (*code_written) (void *context, uint16_t address);
+    void *code_context;
 
 } memorybus;
 
-uint8_t read_byte(memorybus self, uint16_t address);
+// Map everything the default way (see above)
+void init_memorybus (memorybus *self);
+// Let go of the memory
+void free_memorybus (memorybus *self);
+
+// Point pages [first_page, first_page + count) at host memory. Either pointer can be NULL to send that side to
+// the pages' handlers instead
+void map_pages (memorybus *self, uint8_t first_page, uint16_t count, const uint8_t *read, uint8_t *write);
+// Point pages [first_page, first_page + count) at the bus's own memory, starting from page memory_page of it (the
+// first 256 are the address space's, the rest come from add_memory). Without writable, writes go to the pages'
+// handlers instead
+void map_memory (memorybus *self, uint8_t first_page, uint16_t count, uint16_t memory_page, bool writable);
+// Add count pages of memory (in whole chunks, zeroed). Returns its first page for map_memory, or 0 if there isn't
+// room
+uint16_t add_memory (memorybus *self, uint16_t count);
+// Give pages [first_page, first_page + count) handlers for when their pointers are NULL
+void map_handlers (memorybus *self, uint8_t first_page, uint16_t count,
+    bus_read_handler read, bus_write_handler write, void *context);
+// Give a single I/O register (0xFF00-0xFF7F, or 0xFFFF) handlers
+void map_io_register (memorybus *self, uint16_t address, bus_read_handler read, bus_write_handler write, void *context);
+
+// Send writes to the page holding address through the slow path, so the block cache gets told about them. Or
+// stop doing that for every page
+void watch_page (memorybus *self, uint16_t address);
+void unwatch_pages (memorybus *self);
+
+// copy is a struct copy of self, and from now on the two of them share every chunk of memory. Whichever writes to
+// one first gets its own copy of it then
+void share_memory (memorybus *self, memorybus *copy);
+// Give the bus its own copy of a chunk it's sharing
+void unshare_chunk (memorybus *self, uint8_t chunk);
+
+// Where an address lives in memory (not where the page tables say it is: memory behind a handler, like the I/O
+// registers, HRAM, or tile data). Everything in one 4KB chunk is in one piece, so the pointer's good for the rest
+// of that chunk
+static inline const uint8_t *bus_memory (const memorybus *self, uint16_t address) {
+    return self->chunks[address >> 12]->data + (address & (MEMORY_CHUNK_SIZE - 1));
+}
+// The same, to write to (which makes its page dirty)
+static inline uint8_t *bus_memory_write (memorybus *self, uint16_t address) {
+
+    uint8_t chunk = address >> 12;
+    if (__atomic_load_n(&self->chunks[chunk]->refs, __ATOMIC_ACQUIRE) > 1) {
+        unshare_chunk(self, chunk);
+    }
+    self->dirty[address >> 11] |= 1 << ((address >> 8) & 7);
+    return self->chunks[chunk]->data + (address & (MEMORY_CHUNK_SIZE - 1));
+
+}
+
+// Catch writes through the page tables in the dirty bits as well (or stop). Turning it on makes every page dirty,
+// since there's no telling what got written before
+void track_dirty_pages (memorybus *self, bool track);
+// Whether a page of memory (numbered the way map_memory numbers them) has been written since the last clear
+static inline bool page_dirty (const memorybus *self, uint16_t memory_page) {
+    return (self->dirty[memory_page / 8] >> (memory_page % 8)) & 1;
+}
+// Make every page dirty, for when memory got changed without going through the bus
+void dirty_all_pages (memorybus *self);
+// Clear every dirty bit
+void clear_dirty_pages (memorybus *self);
+
+// The slow paths, for when a page doesn't have a pointer
+uint8_t read_byte_slow (memorybus *self, uint16_t address);
+void write_byte_slow (memorybus *self, uint16_t address, uint8_t value);
+
+// Read byte from 16-bit memory address
+static inline uint8_t read_byte (memorybus *self, uint16_t address) {
+
+    const uint8_t *page = self->read_pages[address >> 8];
+    if (page != NULL) {
+        return page[address & 0xFF];
+    }
+    return read_byte_slow(self, address);
+
+}
+
+// Write byte to 16-bit memory address
+static inline void write_byte (memorybus *self, uint16_t address, uint8_t value) {
+
+    uint8_t *page = self->write_pages[address >> 8];
+    if (page != NULL) {
+        page[address & 0xFF] = value;
+        return;
+    }
+    write_byte_slow(self, address, value);
+
+}
+
+// 16-bit values are little-endian: the low byte goes first
+static inline uint16_t read_word (memorybus *self, uint16_t address) {
+    return read_byte(self, address) | (read_byte(self, address + 1) << 8);
+}
+static inline void write_word (memorybus *self, uint16_t address, uint16_t value) {
+    write_byte(self, address, (uint8_t) (value & 0xFF));
+    write_byte(self, address + 1, (uint8_t) (value >> 8));
+}
 
-#endif
\ No newline at end of file
+#endif
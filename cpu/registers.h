@@ -1,6 +1,9 @@
 #ifndef REGISTERS_H
 #define REGISTERS_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 // CPU 8-bit registers
 typedef struct Registers {
     uint8_t a;
@@ -13,6 +16,23 @@ typedef struct Registers {
     uint8_t l;
 } registers;
 
+// Where every register lives inside the struct. The decoder binds opcodes to these so the handlers never have to
+// switch on which register they're working with. B/C, D/E and H/L sit next to each other (high byte first), so the
+// offset of the high register also works for the pair.
+enum RegisterOffset {
+    REG_A = offsetof(registers, a),
+    REG_B = offsetof(registers, b),
+    REG_C = offsetof(registers, c),
+    REG_D = offsetof(registers, d),
+    REG_E = offsetof(registers, e),
+    REG_H = offsetof(registers, h),
+    REG_L = offsetof(registers, l),
+
+    REG_BC = offsetof(registers, b),
+    REG_DE = offsetof(registers, d),
+    REG_HL = offsetof(registers, h)
+};
+
 // -- Function declarations: Combines two registers together for dual-use --
 uint16_t get_af(registers self);
 uint16_t set_af(registers *self, uint16_t value);
@@ -23,4 +43,4 @@ uint16_t set_de(registers *self, uint16_t value);
 uint16_t get_hl(registers self);
 uint16_t set_hl(registers *self, uint16_t value);
 
-#endif
\ No newline at end of file
+#endif
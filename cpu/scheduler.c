@@ -0,0 +1,128 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+// Local libraries
+#include "scheduler.h"
+
+
+// --  Heap  --
+
+static inline uint64_t time_at (const scheduler *self, uint8_t index) {
+    return self->times[self->heap[index]];
+}
+
+static inline void place (scheduler *self, uint8_t index, uint8_t type) {
+    self->heap[index] = type;
+    self->position[type] = index + 1;
+}
+
+static void swap (scheduler *self, uint8_t a, uint8_t b) {
+    uint8_t type = self->heap[a];
+    place(self, a, self->heap[b]);
+    place(self, b, type);
+}
+
+// Move an event up or down until it's in the right place
+static void sift_up (scheduler *self, uint8_t index) {
+    while (index > 0) {
+        uint8_t parent = (index - 1) / 2;
+        if (time_at(self, parent) <= time_at(self, index)) {
+            break;
+        }
+        swap(self, index, parent);
+        index = parent;
+    }
+}
+static void sift_down (scheduler *self, uint8_t index) {
+    while (true) {
+        uint8_t smallest = index;
+        uint8_t left = index * 2 + 1;
+        uint8_t right = index * 2 + 2;
+
+        if (left < self->count && time_at(self, left) < time_at(self, smallest)) {
+            smallest = left;
+        }
+        if (right < self->count && time_at(self, right) < time_at(self, smallest)) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        swap(self, index, smallest);
+        index = smallest;
+    }
+}
+
+static inline void update_next (scheduler *self) {
+    self->next = (self->count > 0) ? time_at(self, 0) : UINT64_MAX;
+}
+
+
+// --  Events  --
+
+void init_scheduler (scheduler *self) {
+
+    memset(self, 0, sizeof(scheduler));
+    self->next = UINT64_MAX;
+
+}
+
+void set_event_handler (scheduler *self, EventType type, event_handler handler, void *context) {
+
+    self->handlers[type] = handler;
+    self->contexts[type] = context;
+
+}
+
+void schedule_event (scheduler *self, EventType type, uint64_t time) {
+
+    if (self->position[type] == 0) {
+        place(self, self->count, type);
+        self->count += 1;
+    }
+
+    self->times[type] = time;
+    sift_up(self, self->position[type] - 1);
+    sift_down(self, self->position[type] - 1);
+
+    update_next(self);
+
+}
+
+void cancel_event (scheduler *self, EventType type) {
+
+    if (self->position[type] == 0) {
+        return;
+    }
+
+    // Put the last event where this one was, and let it find its place from there
+    uint8_t index = self->position[type] - 1;
+    self->position[type] = 0;
+    self->count -= 1;
+
+    if (index != self->count) {
+        uint8_t moved = self->heap[self->count];
+        place(self, index, moved);
+        sift_up(self, index);
+        sift_down(self, self->position[moved] - 1);
+    }
+
+    update_next(self);
+
+}
+
+void run_events (scheduler *self, uint64_t now) {
+
+    while (self->count > 0 && time_at(self, 0) <= now) {
+
+        uint8_t type = self->heap[0];
+        uint64_t time = self->times[type];
+        cancel_event(self, type);
+
+        if (self->handlers[type] != NULL) {
+            self->handlers[type](self->contexts[type], time);
+        }
+    }
+
+}
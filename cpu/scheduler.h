@@ -0,0 +1,68 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* -- Scheduler --
+    Everything besides the CPU (the timer, the PPU, the APU, the serial port) only does something interesting every
+    so often: the timer overflows, the PPU switches modes, a serial bit finishes shifting out... Instead of ticking
+    all of them after every instruction, each one tells the scheduler when its next interesting thing happens, and
+    the CPU just runs until the earliest of those (see run() in cpu.c). Anything in between can be worked out from
+    the cycle counter when somebody actually asks (reading DIV, for example).
+
+    Every kind of event can be pending at most once, so the events are a tiny min-heap keyed by time, and
+    scheduling one that's already pending just moves it.
+
+    All times are in clock cycles (T-cycles) on the cpu's cycle counter.
+*/
+
+typedef enum {
+    EVENT_RUN_END,                  // run() was asked to stop here
+    EVENT_INTERRUPT,                // Something might have made an interrupt pending, so go check
+    EVENT_TIMER,                    // TIMA overflows
+    EVENT_SERIAL,                   // A serial transfer finishes
+    EVENT_PPU,                      // The PPU changes mode
+    EVENT_APU_FRAME_SEQUENCER,      // The APU's length/envelope/sweep clock ticks
+    EVENT_COUNT
+} EventType;
+
+// What gets called when an event is due. time is when it was due, which can be a bit earlier than the cycle
+// counter if an instruction ran over it
+typedef void (*event_handler) (void *context, uint64_t time);
+
+typedef struct Scheduler {
+
+    // When the earliest event is due (what the CPU checks after every instruction)
+    uint64_t next;
+
+    // The pending events, as a binary min-heap by time
+    uint8_t heap[EVENT_COUNT];
+    uint8_t count;
+    // Where each event is in the heap, plus one (0 means it isn't pending, so a zeroed scheduler is an empty one)
+    uint8_t position[EVENT_COUNT];
+    uint64_t times[EVENT_COUNT];
+
+    event_handler handlers[EVENT_COUNT];
+    void *contexts[EVENT_COUNT];
+
+} scheduler;
+
+void init_scheduler (scheduler *self);
+
+// Who to call when an event of this type is due
+void set_event_handler (scheduler *self, EventType type, event_handler handler, void *context);
+
+// Schedule an event (or move it, if it was already pending)
+void schedule_event (scheduler *self, EventType type, uint64_t time);
+void cancel_event (scheduler *self, EventType type);
+
+static inline bool event_pending (const scheduler *self, EventType type) {
+    return self->position[type] != 0;
+}
+
+// Handle every event that's due by now, earliest first. Handlers can schedule more events, including ones that are
+// already due, and those get handled too
+void run_events (scheduler *self, uint64_t now);
+
+#endif
@@ -0,0 +1,133 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+// Local libraries
+#include "block-cache.h"
+#include "cpu.h"
+#include "decoder.h"
+#include "instructions.h"
+#include "memorybus.h"
+#include "registers.h"
+
+/* -- Threaded interpreter --
+
+    A second version of execute() (see cpu.c), picked at build time by defining THREADED_INTERPRETER (-DTHREADED_INTERPRETER).
+
+    Instead of going back to step() and making an indirect call through the decoder table after every instruction,
+    every opcode gets its own label here, and the end of every label jumps straight to the label of the next opcode.
+    That needs the GCC/Clang "labels as values" extension (&&label and goto *pointer), so it won't build on anything else.
+
+    The labels are made from the same opcodes.def list as the decoder tables and call the exact same handlers, so the
+    two cores can't end up disagreeing about what an instruction does. The only difference is how we get from one
+    instruction to the next, which makes it easy to compare them on the same ROMs.
+
+    If the block cache is turned on, it wins: execute() runs blocks exactly like the plain version does.
+*/
+
+#ifdef THREADED_INTERPRETER
+
+#if !defined(__GNUC__)
+#error "The threaded interpreter needs GCC or Clang (labels as values)"
+#endif
+
+// Read the inmediate value for an instruction. length is always a constant here, so the compiler throws away the
+// branches that don't apply to each label
+static inline uint16_t fetch_immediate (cpu *self, uint8_t length) {
+
+    if (length == 2) {
+        return read_byte(&self->bus, self->pc + 1);
+    }
+    if (length == 3) {
+        return read_word(&self->bus, self->pc + 1);
+    }
+    return 0;
+
+}
+
+void execute (cpu *self) {
+
+    static void *const labels[256] = {
+#define OPCODE(code, handler, target, source, length, cycles, mnemonic) [code] = &&op_##code,
+#include "opcodes.def"
+#undef OPCODE
+    };
+
+    static void *const cb_labels[256] = {
+#define CB_OPCODE(code, handler, target, source, length, cycles, mnemonic) [code] = &&cb_##code,
+#include "cb-opcodes.def"
+#undef CB_OPCODE
+    };
+
+    // With the block cache (and maybe the JIT) turned on, blocks already skip the per-instruction dispatch, so
+    // that does the running here too, same as in cpu.c
+    if (self->blocks != NULL) {
+        while (self->cycles < self->scheduler.next) {
+            if (self->halted) {
+                self->cycles += (self->scheduler.next - self->cycles + 3) & ~3ULL;
+                return;
+            }
+            if (self->ime_scheduled) {
+                self->cycles += step(self);
+            } else {
+                run_block(self);
+            }
+        }
+        return;
+    }
+
+    uint16_t immediate;
+
+    // Copied at the end of every single opcode, which is the whole point: each opcode gets its own indirect jump, so
+    // the branch predictor learns "what usually comes after this opcode" instead of guessing from one shared jump.
+    // HALT and a pending EI are rare and fiddly, so those go through step() instead.
+#define DISPATCH() \
+    if (self->cycles >= self->scheduler.next) { \
+        return; \
+    } \
+    if (self->halted || self->ime_scheduled) { \
+        goto slow_path; \
+    } \
+    goto *labels[read_byte(&self->bus, self->pc)];
+
+    DISPATCH();
+
+slow_path:
+    if (self->halted) {
+        // Nothing to do until the next event (in whole machine cycles)
+        self->cycles += (self->scheduler.next - self->cycles + 3) & ~3ULL;
+        return;
+    }
+    self->cycles += step(self);
+    DISPATCH();
+
+    // One label per opcode. The CB prefix skips prefix_cb and jumps straight to the right CB label (code is a
+    // constant, so that check disappears from every other label)
+#define OPCODE(code, handler, target, source, length, op_cycles, mnemonic) \
+op_##code: \
+    if (code == 0xCB) { \
+        goto cb_prefix; \
+    } \
+    immediate = fetch_immediate(self, length); \
+    self->pc += length; \
+    self->cycles += op_cycles + handler(self, target, source, immediate); \
+    DISPATCH();
+#include "opcodes.def"
+#undef OPCODE
+
+cb_prefix:
+    goto *cb_labels[read_byte(&self->bus, self->pc + 1)];
+
+    // And one per CB opcode. The PC is still on the prefix, which is why the lengths in cb-opcodes.def count it
+#define CB_OPCODE(code, handler, target, source, length, op_cycles, mnemonic) \
+cb_##code: \
+    self->pc += length; \
+    self->cycles += op_cycles + handler(self, target, source, 0); \
+    DISPATCH();
+#include "cb-opcodes.def"
+#undef CB_OPCODE
+
+#undef DISPATCH
+
+}
+
+#endif
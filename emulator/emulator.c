@@ -0,0 +1,135 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+// Local libraries
+#include "emulator.h"
+#include "../cpu/block-cache.h"
+#include "../cpu/cpu.h"
+#include "../cpu/instructions-helpers.h"
+#include "../cpu/registers.h"
+
+
+// --  Setup  --
+
+// What the boot ROM leaves in the registers (on a DMG) when it hands over to the cartridge
+static void boot_state (cpu *self) {
+
+    self->cpu_registers.a = 0x01;
+    set_f(self, 0xB0);
+    set_bc(&self->cpu_registers, 0x0013);
+    set_de(&self->cpu_registers, 0x00D8);
+    set_hl(&self->cpu_registers, 0x014D);
+    self->sp = 0xFFFE;
+    self->pc = 0x0100;
+
+}
+
+bool init_emu (emu *self, const char *rom_path) {
+
+    memset(self, 0, sizeof(emu));
+    init_cpu(&self->cpu);
+
+    if (!load_cartridge(&self->cartridge, rom_path)) {
+        free_memorybus(&self->cpu.bus);
+        return false;
+    }
+    insert_cartridge(&self->cartridge, &self->cpu.bus);
+
+    init_timer(&self->timer, &self->cpu);
+    init_serial(&self->serial, &self->cpu);
+    init_joypad(&self->joypad, &self->cpu);
+    init_ppu(&self->ppu, &self->cpu);
+    set_ppu_accuracy(&self->ppu, accuracy_for_title(self->cartridge.title));
+    init_apu(&self->apu, &self->cpu);
+
+    boot_state(&self->cpu);
+    self->frame_end = self->cpu.cycles + FRAME_CYCLES;
+    return true;
+
+}
+
+void free_emu (emu *self) {
+
+    disable_block_cache(&self->cpu);
+    unload_cartridge(&self->cartridge);
+    free_memorybus(&self->cpu.bus);
+
+}
+
+
+// --  Cloning  --
+
+// Anything that pointed somewhere inside source, pointing at the same place in self instead
+static void *rebase (void *pointer, const emu *source, emu *self) {
+
+    const char *start = (const char *) source;
+    if ((const char *) pointer < start || (const char *) pointer >= start + sizeof(emu)) {
+        return pointer;
+    }
+    return (char *) self + ((const char *) pointer - start);
+
+}
+
+void clone_emu (emu *self, emu *source) {
+
+    // Everything but the APU goes as it is, and the APU leaves its sample buffers out if they're not in use
+    memcpy(self, source, offsetof(emu, apu));
+    copy_apu(&self->apu, &source->apu);
+    self->frames = source->frames;
+    self->frame_end = source->frame_end;
+
+    // Point the parts at each other, and the bus's handlers and the scheduler's events at the clone's parts
+    memorybus *bus = &self->cpu.bus;
+    for (uint16_t i = 0; i < BUS_PAGE_COUNT; i++) {
+        bus->handler_contexts[i] = rebase(bus->handler_contexts[i], source, self);
+    }
+    for (uint16_t i = 0; i < IO_REGISTER_COUNT; i++) {
+        bus->io_contexts[i] = rebase(bus->io_contexts[i], source, self);
+    }
+    for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+        self->cpu.scheduler.contexts[i] = rebase(self->cpu.scheduler.contexts[i], source, self);
+    }
+    self->cartridge.bus = bus;
+    self->timer.cpu = &self->cpu;
+    self->serial.cpu = &self->cpu;
+    self->joypad.cpu = &self->cpu;
+    self->ppu.cpu = &self->cpu;
+    self->apu.cpu = &self->cpu;
+
+    // The block cache and the JIT belong to source
+    self->cpu.blocks = NULL;
+    self->cpu.jit = NULL;
+    bus->code_map = NULL;
+    bus->code_written = NULL;
+    bus->code_context = NULL;
+
+    // Share the memory and the ROM. The clone doesn't have a block cache to hear about writes, so its pages only
+    // stay held back where the memory's shared
+    share_memory(&source->cpu.bus, bus);
+    unwatch_pages(bus);
+    share_cartridge(&source->cartridge);
+
+}
+
+
+// --  Running  --
+
+void run_frame (emu *self) {
+
+    if (self->frame_end > self->cpu.cycles) {
+        run(&self->cpu, self->frame_end - self->cpu.cycles);
+    }
+    self->frame_end += FRAME_CYCLES;
+    self->frames++;
+
+}
+
+void run_frames (emu *self, uint64_t count) {
+
+    for (uint64_t i = 0; i < count; i++) {
+        run_frame(self);
+    }
+
+}
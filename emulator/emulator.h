@@ -0,0 +1,63 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../apu/apu.h"
+#include "../cartridge/cartridge.h"
+#include "../cpu/cpu-struct.h"
+#include "../io/joypad.h"
+#include "../io/serial.h"
+#include "../io/timer.h"
+#include "../ppu/ppu.h"
+
+/* -- Emulator --
+    One whole Gameboy: the cpu and everything plugged into it. Nothing in here is written by anything else (the
+    ROM is mapped read-only and never written, and memory shared with a clone gets copied before it's written), so
+    any number of them can run side by side on different threads.
+
+    The parts point at each other (the bus's handlers at the PPU, the PPU at the cpu...), so an emulator can't be
+    moved or copied with memcpy once it's been set up. Allocate it where it's going to stay.
+
+    clone_emu makes a copy the right way: it gets pointed at its own parts, and instead of copying the memory, the
+    two of them share it in 4KB chunks until one of them writes to one (see share_memory in memorybus.h), so it
+    takes microseconds, not a copy of everything. Anything new in here that points at another part has to be
+    pointed at the clone's in there too.
+*/
+
+// One frame, from the start of one VBlank to the next
+#define FRAME_CYCLES (LINE_CYCLES * LINES_PER_FRAME)
+
+typedef struct Emulator {
+
+    cpu cpu;
+    cartridge cartridge;
+    timer timer;
+    serial serial;
+    joypad joypad;
+    ppu ppu;
+    apu apu;
+
+    // Frames run so far, and the clock cycle the current one ends on. Instructions can run a few cycles past the
+    // end of a frame, so the next one ends a whole frame after this, not a whole frame after wherever the cpu got to
+    uint64_t frames;
+    uint64_t frame_end;
+
+} emu;
+
+// Load the ROM at rom_path and set everything up the way the boot ROM leaves it, ready to run the cartridge from
+// 0x100. Returns false if the ROM can't be loaded
+bool init_emu (emu *self, const char *rom_path);
+// Let go of the ROM and the memory (what this one still shares with clones stays until they're freed too)
+void free_emu (emu *self);
+
+// Make self a copy of source, which goes on running the same from then on. It has to be between runs (not inside
+// a callback from one), and not running on another thread while it's being cloned. The clone starts out without
+// the block cache or the JIT, and calls the same callbacks (frame_done, sent) with the same contexts
+void clone_emu (emu *self, emu *source);
+
+// Run one frame, or count of them
+void run_frame (emu *self);
+void run_frames (emu *self, uint64_t count);
+
+#endif
@@ -0,0 +1,67 @@
+// Standard libraries
+#include <stdint.h>
+// Local libraries
+#include "joypad.h"
+#include "../cpu/cpu-struct.h"
+#include "../cpu/interrupts.h"
+#include "../cpu/memorybus.h"
+
+
+// The low 4 bits of P1: the buttons in whichever rows are picked, 0 for pressed
+static uint8_t lines (const joypad *self) {
+
+    uint8_t held = 0;
+    if (!(self->select & 0x10)) {
+        held |= self->pressed & 0x0F;
+    }
+    if (!(self->select & 0x20)) {
+        held |= self->pressed >> 4;
+    }
+    return ~held & 0x0F;
+
+}
+
+// Any line that was 1 and isn't anymore asks for the interrupt
+static void update_lines (joypad *self, uint8_t before) {
+
+    if (before & ~lines(self)) {
+        request_interrupt(self->cpu, INTERRUPT_JOYPAD);
+    }
+
+}
+
+static uint8_t joypad_read (void *context, uint16_t address) {
+
+    joypad *self = context;
+    // The top 2 bits don't exist
+    return 0xC0 | self->select | lines(self);
+
+}
+
+static void joypad_write (void *context, uint16_t address, uint8_t value) {
+
+    joypad *self = context;
+    uint8_t before = lines(self);
+    self->select = value & 0x30;
+    update_lines(self, before);
+
+}
+
+void init_joypad (joypad *self, cpu *cpu) {
+
+    self->cpu = cpu;
+    // The boot ROM leaves both rows picked (P1 reads 0xCF)
+    self->select = 0;
+    self->pressed = 0;
+
+    map_io_register(&cpu->bus, P1_ADDRESS, joypad_read, joypad_write, self);
+
+}
+
+void set_joypad (joypad *self, uint8_t pressed) {
+
+    uint8_t before = lines(self);
+    self->pressed = pressed;
+    update_lines(self, before);
+
+}
@@ -0,0 +1,46 @@
+#ifndef JOYPAD_H
+#define JOYPAD_H
+
+#include <stdint.h>
+#include "../cpu/cpu-struct.h"
+
+/* -- Joypad --
+    P1 (0xFF00) is a 2x4 grid of buttons. The game picks a row by writing a 0 to bit 4 (the D-pad) or bit 5 (A, B,
+    Select, Start), and reads the buttons held in it back from the low 4 bits, 0 for pressed. Picking both rows gets
+    both at once, ANDed together.
+
+    Whatever's holding the buttons (a frontend, or a movie playing back, see movie.h) says which are down as one
+    byte, a bit per button, and a line going from 1 to 0 asks for the joypad interrupt, the same as the real one.
+*/
+
+#define P1_ADDRESS 0xFF00
+
+// One bit per button, the D-pad in the low nibble and the rest in the high one, in the order P1 has them
+typedef enum {
+    JOYPAD_RIGHT = 0x01,
+    JOYPAD_LEFT = 0x02,
+    JOYPAD_UP = 0x04,
+    JOYPAD_DOWN = 0x08,
+    JOYPAD_A = 0x10,
+    JOYPAD_B = 0x20,
+    JOYPAD_SELECT = 0x40,
+    JOYPAD_START = 0x80
+} JoypadButton;
+
+typedef struct Joypad {
+
+    cpu *cpu;
+    // Bits 4 and 5 of P1, as the game last wrote them
+    uint8_t select;
+    // The buttons held down right now
+    uint8_t pressed;
+
+} joypad;
+
+// Hook P1 up to the bus, with nothing pressed
+void init_joypad (joypad *self, cpu *cpu);
+
+// Hold down exactly the buttons in pressed (and let go of the rest)
+void set_joypad (joypad *self, uint8_t pressed);
+
+#endif
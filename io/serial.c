@@ -0,0 +1,73 @@
+// Standard libraries
+#include <stddef.h>
+#include <stdint.h>
+// Local libraries
+#include "serial.h"
+#include "../cpu/cpu-struct.h"
+#include "../cpu/interrupts.h"
+#include "../cpu/memorybus.h"
+#include "../cpu/scheduler.h"
+
+
+// EVENT_SERIAL: the last bit went out
+static void transfer_done (void *context, uint64_t time) {
+
+    serial *self = context;
+
+    if (self->sent != NULL) {
+        self->sent(self->sent_context, self->sb);
+    }
+
+    // Nobody on the other end, so it was all 1s coming in
+    self->sb = 0xFF;
+    self->sc &= 0x7F;
+    request_interrupt(self->cpu, INTERRUPT_SERIAL);
+
+}
+
+static uint8_t serial_read (void *context, uint16_t address) {
+
+    serial *self = context;
+
+    if (address == SB_ADDRESS) {
+        return self->sb;
+    }
+    // Only bits 7 and 0 of SC exist
+    return self->sc | 0x7E;
+
+}
+
+static void serial_write (void *context, uint16_t address, uint8_t value) {
+
+    serial *self = context;
+
+    if (address == SB_ADDRESS) {
+        self->sb = value;
+        return;
+    }
+
+    self->sc = value & 0x81;
+
+    // Only the internal clock actually sends anything. With the external one it waits for the other Gameboy,
+    // which never comes
+    if (self->sc == 0x81) {
+        schedule_event(&self->cpu->scheduler, EVENT_SERIAL, self->cpu->cycles + 8 * SERIAL_BIT_CYCLES);
+    } else {
+        cancel_event(&self->cpu->scheduler, EVENT_SERIAL);
+    }
+
+}
+
+void init_serial (serial *self, cpu *cpu) {
+
+    self->cpu = cpu;
+    self->sb = 0;
+    self->sc = 0;
+    self->sent = NULL;
+    self->sent_context = NULL;
+
+    map_io_register(&cpu->bus, SB_ADDRESS, serial_read, serial_write, self);
+    map_io_register(&cpu->bus, SC_ADDRESS, serial_read, serial_write, self);
+    set_event_handler(&cpu->scheduler, EVENT_SERIAL, transfer_done, self);
+
+}
@@ -0,0 +1,35 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include "../cpu/cpu-struct.h"
+
+/* -- Serial port --
+    Writing SC (0xFF02) with bits 7 and 0 set sends SB (0xFF01) out one bit at a time at 8192Hz, shifting in
+    whatever comes back. Nothing's ever plugged in, so what comes back is always 0xFF.
+
+    The transfer is one event on the scheduler for when the whole byte is done (8 bits, 4096 clock cycles). Test
+    ROMs like to print through here, so every byte sent also goes to sent (if it's set).
+*/
+
+#define SB_ADDRESS 0xFF01
+#define SC_ADDRESS 0xFF02
+
+// Clock cycles for one bit at 8192Hz
+#define SERIAL_BIT_CYCLES 512
+
+typedef struct Serial {
+
+    cpu *cpu;
+    uint8_t sb;
+    uint8_t sc;
+
+    void (*sent) (void *context, uint8_t value);
+    void *sent_context;
+
+} serial;
+
+// Hook the serial registers up to the bus and the end of a transfer to the scheduler
+void init_serial (serial *self, cpu *cpu);
+
+#endif
@@ -0,0 +1,133 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+// Local libraries
+#include "timer.h"
+#include "../cpu/cpu-struct.h"
+#include "../cpu/interrupts.h"
+#include "../cpu/memorybus.h"
+#include "../cpu/scheduler.h"
+
+
+// --  Helpers  --
+
+// How many clock cycles between TIMA going up, for each of TAC's clock selects
+static const uint16_t tima_periods[4] = {1024, 16, 64, 256};
+
+static inline bool timer_enabled (const timer *self) {
+    return (self->tac & 0x04) != 0;
+}
+static inline uint16_t period (const timer *self) {
+    return tima_periods[self->tac & 0x03];
+}
+static inline uint64_t counter_at (const timer *self, uint64_t time) {
+    return time - self->counter_start;
+}
+
+// Catch TIMA up to now, overflowing it (maybe more than once) on the way if it has to
+static void sync (timer *self) {
+
+    uint64_t now = self->cpu->cycles;
+
+    if (timer_enabled(self) && now > self->synced) {
+
+        // How many times the selected bit fell between then and now
+        uint64_t ticks = counter_at(self, now) / period(self) - counter_at(self, self->synced) / period(self);
+        uint64_t total = self->tima + ticks;
+
+        while (total > 0xFF) {
+            total = self->tma + (total - 0x100);
+            request_interrupt(self->cpu, INTERRUPT_TIMER);
+        }
+        self->tima = total;
+    }
+
+    self->synced = now;
+
+}
+
+// Tell the scheduler when TIMA is going to overflow next
+static void schedule_overflow (timer *self) {
+
+    if (!timer_enabled(self)) {
+        cancel_event(&self->cpu->scheduler, EVENT_TIMER);
+        return;
+    }
+
+    uint64_t ticks_left = 0x100 - self->tima;
+    uint64_t next_tick = counter_at(self, self->synced) / period(self) + ticks_left;
+    schedule_event(&self->cpu->scheduler, EVENT_TIMER, self->counter_start + next_tick * period(self));
+
+}
+
+// EVENT_TIMER: TIMA overflowed (sync does the actual overflowing)
+static void overflow (void *context, uint64_t time) {
+
+    timer *self = context;
+    sync(self);
+    schedule_overflow(self);
+
+}
+
+
+// --  Registers  --
+
+static uint8_t timer_read (void *context, uint16_t address) {
+
+    timer *self = context;
+
+    switch (address) {
+        case DIV_ADDRESS:
+            return (counter_at(self, self->cpu->cycles) >> 8) & 0xFF;
+        case TIMA_ADDRESS:
+            sync(self);
+            return self->tima;
+        case TMA_ADDRESS:
+            return self->tma;
+        default:
+            // The top 5 bits of TAC don't exist, so they read as 1
+            return self->tac | 0xF8;
+    }
+
+}
+
+static void timer_write (void *context, uint16_t address, uint8_t value) {
+
+    timer *self = context;
+    sync(self);
+
+    switch (address) {
+        case DIV_ADDRESS:
+            // Any write resets the whole counter
+            self->counter_start = self->cpu->cycles;
+            break;
+        case TIMA_ADDRESS:
+            self->tima = value;
+            break;
+        case TMA_ADDRESS:
+            self->tma = value;
+            break;
+        default:
+            self->tac = value & 0x07;
+            break;
+    }
+
+    schedule_overflow(self);
+
+}
+
+void init_timer (timer *self, cpu *cpu) {
+
+    self->cpu = cpu;
+    self->counter_start = cpu->cycles;
+    self->synced = cpu->cycles;
+    self->tima = 0;
+    self->tma = 0;
+    self->tac = 0;
+
+    for (uint16_t address = DIV_ADDRESS; address <= TAC_ADDRESS; address++) {
+        map_io_register(&cpu->bus, address, timer_read, timer_write, self);
+    }
+    set_event_handler(&cpu->scheduler, EVENT_TIMER, overflow, self);
+
+}
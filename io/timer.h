@@ -0,0 +1,39 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include "../cpu/cpu-struct.h"
+
+/* -- Timer --
+    DIV (0xFF04) is the top byte of a 16-bit counter that goes up every clock cycle, and TIMA (0xFF05) goes up every
+    time a bit of that counter picked by TAC (0xFF07) falls. When TIMA overflows it gets reloaded from TMA (0xFF06)
+    and asks for the timer interrupt.
+
+    Nothing here ticks: DIV and TIMA are worked out from the cpu's cycle counter whenever they're read, and the only
+    thing on the scheduler is the moment TIMA is going to overflow.
+*/
+
+#define DIV_ADDRESS 0xFF04
+#define TIMA_ADDRESS 0xFF05
+#define TMA_ADDRESS 0xFF06
+#define TAC_ADDRESS 0xFF07
+
+typedef struct Timer {
+
+    cpu *cpu;
+
+    // When the internal counter was last 0 (writing DIV resets it)
+    uint64_t counter_start;
+    // When TIMA was last brought up to date
+    uint64_t synced;
+
+    uint8_t tima;
+    uint8_t tma;
+    uint8_t tac;
+
+} timer;
+
+// Hook the timer's registers up to the bus and its overflow to the scheduler
+void init_timer (timer *self, cpu *cpu);
+
+#endif
@@ -0,0 +1,246 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+// Local libraries
+#include "fifo.h"
+#include "ppu.h"
+#include "tile-decode.h"
+#include "../cpu/cpu-struct.h"
+
+
+// --  Helpers  --
+
+// The fetcher takes 2 clock cycles each to read the tile number, the low byte and the high byte, and then pushes the
+// row into the FIFO as soon as it's empty
+#define FETCH_READY 6
+#define SPRITE_FETCH_CYCLES 6
+
+// Sprite pixels keep the palette and priority bits of their attributes next to the color index
+#define SPRITE_PALETTE 0x10
+#define SPRITE_PRIORITY 0x80
+
+static inline uint8_t vram (ppu *self, uint16_t offset) {
+    return *bus_memory(&self->cpu->bus, 0x8000 + offset);
+}
+
+static inline const uint8_t *oam_entry (ppu *self, uint8_t sprite) {
+    return bus_memory(&self->cpu->bus, OAM_ADDRESS + sprite * 4);
+}
+
+// The row of the background or window the fetcher is on
+static inline uint8_t fetch_row (ppu *self, pixel_fifo *fifo) {
+    return fifo->in_window ? self->window_line : (uint8_t) (self->ly + self->scy);
+}
+
+
+// --  Fetching  --
+
+// One clock cycle of the background/window fetcher
+static void fetch (ppu *self, pixel_fifo *fifo) {
+
+    uint8_t row = fetch_row(self, fifo);
+
+    switch (fifo->fetch_step) {
+
+        case 1: {
+            uint16_t map;
+            uint8_t column;
+            if (fifo->in_window) {
+                map = (self->lcdc & LCDC_WINDOW_MAP) ? 0x1C00 : 0x1800;
+                column = fifo->fetch_column & 31;
+            } else {
+                map = (self->lcdc & LCDC_BG_MAP) ? 0x1C00 : 0x1800;
+                column = (self->scx / 8 + fifo->fetch_column) & 31;
+            }
+            fifo->fetch_tile = vram(self, map + (row / 8) * 32 + column);
+            break;
+        }
+
+        case 3:
+            fifo->fetch_low = vram(self, tile_index(self, fifo->fetch_tile, false) * 16 + (row % 8) * 2);
+            break;
+
+        case 5:
+            fifo->fetch_high = vram(self, tile_index(self, fifo->fetch_tile, false) * 16 + (row % 8) * 2 + 1);
+            fifo->fetch_step = FETCH_READY;
+            // Straight on to pushing
+            // fall through
+
+        case FETCH_READY:
+            if (fifo->background_count != 0) {
+                return;
+            }
+            // The first fetch of every line gets thrown away
+            if (fifo->first_fetch) {
+                fifo->first_fetch = false;
+            } else {
+                uint8_t planes[2] = { fifo->fetch_low, fifo->fetch_high };
+                decode_tiles(planes, 1, fifo->background);
+                fifo->background_next = 0;
+                fifo->background_count = 8;
+                fifo->fetch_column += 1;
+            }
+            fifo->fetch_step = 0;
+            return;
+
+    }
+
+    fifo->fetch_step += 1;
+
+}
+
+// A sprite's row, mixed into the sprite pixels. Whatever's already there came from a sprite that wins over this one,
+// so only the see-through spots get filled
+static void load_sprite (ppu *self, pixel_fifo *fifo, uint8_t sprite) {
+
+    const uint8_t *entry = oam_entry(self, sprite);
+    uint8_t height = sprite_height(self);
+    uint8_t tile = entry[2];
+    uint8_t attributes = entry[3];
+
+    uint8_t row = self->ly - (entry[0] - 16);
+    if (attributes & 0x40) {
+        row = height - 1 - row;
+    }
+    if (height == 16) {
+        tile &= 0xFE;
+    }
+
+    uint16_t address = tile_index(self, tile + row / 8, true) * 16 + (row % 8) * 2;
+    uint8_t planes[2] = { vram(self, address), vram(self, address + 1) };
+    uint8_t indices[8];
+    decode_tiles(planes, 1, indices);
+
+    int16_t x = entry[1] - 8;
+    for (uint8_t pixel = 0; pixel < 8; pixel++) {
+
+        int16_t slot = x + ((attributes & 0x20) ? 7 - pixel : pixel) - fifo->x;
+        if (slot < 0 || slot >= 8 || indices[pixel] == 0 || (fifo->sprite_pixels[slot] & 0x3) != 0) {
+            continue;
+        }
+        fifo->sprite_pixels[slot] = indices[pixel] | (attributes & (SPRITE_PALETTE | SPRITE_PRIORITY));
+    }
+
+}
+
+
+// --  Drawing  --
+
+// The pixel at x goes out to the screen
+static void output_pixel (ppu *self, pixel_fifo *fifo, uint8_t color) {
+
+    uint8_t background = (self->lcdc & LCDC_BG_ENABLE) ? color : 0;
+    uint8_t shade = (self->bgp >> (background * 2)) & 0x3;
+
+    uint8_t sprite = fifo->sprite_pixels[0];
+    uint8_t sprite_color = sprite & 0x3;
+    if (sprite_color != 0 && (self->lcdc & LCDC_SPRITE_ENABLE) && !((sprite & SPRITE_PRIORITY) && background != 0)) {
+        uint8_t palette = (sprite & SPRITE_PALETTE) ? self->obp1 : self->obp0;
+        shade = (palette >> (sprite_color * 2)) & 0x3;
+    }
+
+    self->framebuffer[self->ly][fifo->x] = shade;
+
+    memmove(fifo->sprite_pixels, fifo->sprite_pixels + 1, 7);
+    fifo->sprite_pixels[7] = 0;
+    fifo->x += 1;
+
+}
+
+// One clock cycle of mode 3
+static void dot (ppu *self, pixel_fifo *fifo) {
+
+    // The next pixel out is where a sprite starts, so go get it (unless sprites are off, in which case it's gone)
+    while (fifo->sprite_stall == 0 && fifo->discard == 0 && fifo->next_sprite < fifo->sprite_count) {
+        int16_t sprite_x = oam_entry(self, fifo->sprites[fifo->next_sprite])[1] - 8;
+        if (sprite_x > fifo->x) {
+            break;
+        }
+        if (self->lcdc & LCDC_SPRITE_ENABLE) {
+            fifo->sprite_stall = SPRITE_FETCH_CYCLES;
+        } else {
+            fifo->next_sprite += 1;
+        }
+    }
+
+    // Everything waits while a sprite gets fetched
+    if (fifo->sprite_stall > 0) {
+        fifo->sprite_stall -= 1;
+        if (fifo->sprite_stall == 0) {
+            load_sprite(self, fifo, fifo->sprites[fifo->next_sprite]);
+            fifo->next_sprite += 1;
+        }
+        return;
+    }
+
+    // The window starts here: the background pixels get dropped and the fetcher starts over on the window
+    if (!fifo->in_window && fifo->discard == 0 && self->window_triggered && (self->lcdc & LCDC_WINDOW_ENABLE) &&
+        fifo->x + 7 >= self->wx) {
+        fifo->in_window = true;
+        fifo->background_count = 0;
+        fifo->fetch_step = 0;
+        fifo->fetch_column = 0;
+    }
+
+    if (fifo->background_count > 0) {
+
+        uint8_t color = fifo->background[fifo->background_next];
+        fifo->background_next += 1;
+        fifo->background_count -= 1;
+
+        // The first SCX % 8 pixels of the line are off the left of the screen
+        if (fifo->discard > 0) {
+            fifo->discard -= 1;
+        } else {
+            output_pixel(self, fifo, color);
+        }
+    }
+
+    fetch(self, fifo);
+
+}
+
+static void fifo_start (ppu *self, uint64_t time) {
+
+    pixel_fifo *fifo = &self->fifo;
+
+    memset(fifo, 0, sizeof(pixel_fifo));
+    fifo->time = time;
+    fifo->discard = self->scx % 8;
+    fifo->first_fetch = true;
+
+    // The line's sprites, left to right
+    const uint8_t *sprites = sprites_on_line(self, self->ly, &fifo->sprite_count);
+    memcpy(fifo->sprites, sprites, fifo->sprite_count);
+
+}
+
+static uint64_t fifo_draw_until (ppu *self, uint64_t now) {
+
+    pixel_fifo *fifo = &self->fifo;
+
+    while (!fifo->done && fifo->time < now) {
+
+        dot(self, fifo);
+        fifo->time += 1;
+
+        if (fifo->x == SCREEN_WIDTH) {
+            fifo->done = true;
+            fifo->end = fifo->time;
+            if (fifo->in_window) {
+                self->window_line += 1;
+            }
+        }
+    }
+
+    if (fifo->done) {
+        return fifo->end;
+    }
+
+    // Every pixel still to go takes at least a clock cycle
+    return fifo->time + (SCREEN_WIDTH - fifo->x) + fifo->discard + fifo->sprite_stall;
+
+}
+
+const ppu_engine fifo_engine = { fifo_start, fifo_draw_until };
@@ -0,0 +1,23 @@
+#ifndef FIFO_H
+#define FIFO_H
+
+#include "ppu.h"
+
+/* -- Pixel FIFO --
+    The dot-accurate engine. Mode 3 on the real thing is a tile fetcher feeding a FIFO of background pixels, which
+    get shifted out to the screen one per clock cycle, mixed with sprite pixels that get fetched whenever the next
+    pixel out is where a sprite starts (which stalls everything else for a bit). This does the same, so:
+
+     - Every register gets read at the clock cycle the hardware would read it, so mid-line scroll, palette and
+       LCDC changes show up on the pixel they should
+     - Mode 3 ends when the 160th pixel goes out: 172 clock cycles plus SCX % 8, plus 6 for the window, plus 6 for
+       every sprite (the real sprite penalty is 6-11 depending on how it lines up with the fetcher, which this
+       doesn't try to get exactly)
+
+    Nothing runs until something asks: draw_until gets called before every write that could change the picture,
+    and when mode 3 might be over.
+*/
+
+extern const ppu_engine fifo_engine;
+
+#endif
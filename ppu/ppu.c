@@ -0,0 +1,596 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+// Local libraries
+#include "fifo.h"
+#include "ppu.h"
+#include "tile-decode.h"
+#include "../cpu/cpu-struct.h"
+#include "../cpu/interrupts.h"
+#include "../cpu/memorybus.h"
+#include "../cpu/scheduler.h"
+
+
+// --  Helpers  --
+
+// Where offset (from 0x8000) is in VRAM. Good for the rest of the tile, or the rest of the tile map row
+static inline const uint8_t *vram (ppu *self, uint16_t offset) {
+    return bus_memory(&self->cpu->bus, 0x8000 + offset);
+}
+
+static void request_stat (ppu *self, uint8_t condition) {
+    if (self->stat & condition) {
+        request_interrupt(self->cpu, INTERRUPT_STAT);
+    }
+}
+
+// LY just changed, so see if it matches LYC now
+static void compare_ly (ppu *self) {
+    if (self->ly == self->lyc) {
+        self->stat |= STAT_COINCIDENCE;
+        request_stat(self, STAT_COINCIDENCE_INTERRUPT);
+    } else {
+        self->stat &= ~STAT_COINCIDENCE;
+    }
+}
+
+// Something's about to change what the PPU sees, so whatever should've been drawn before it has to be drawn now
+static inline void sync_drawing (ppu *self) {
+    if (self->mode == MODE_DRAWING) {
+        self->engine->draw_until(self, self->cpu->cycles);
+    }
+}
+
+
+// --  Tile cache  --
+
+// Tile data writes: store the byte, and the tile it's in will need decoding again
+static void vram_write (void *context, uint16_t address, uint8_t value) {
+
+    ppu *self = context;
+    sync_drawing(self);
+    *bus_memory_write(&self->cpu->bus, address) = value;
+    self->tile_dirty[(address - 0x8000) / 16] = true;
+
+}
+
+void invalidate_tiles (ppu *self) {
+    memset(self->tile_dirty, true, sizeof(self->tile_dirty));
+}
+
+// A tile's color indices, decoding it first if it changed. A tile's 16 bytes are its 8 rows one after the other,
+// which is just what decode_tiles wants
+static inline const uint8_t (*cached_tile (ppu *self, uint16_t index))[8] {
+
+    if (self->tile_dirty[index]) {
+        decode_tiles(vram(self, index * 16), 8, &self->tiles[index][0][0]);
+        self->tile_dirty[index] = false;
+    }
+    return self->tiles[index];
+
+}
+
+
+// --  Sprite lists  --
+
+// Add sprite to (or take it off) the lines it covers, going by the Y in OAM right now
+static void place_sprite (ppu *self, uint8_t sprite, bool visible) {
+
+    int16_t top = *bus_memory(&self->cpu->bus, OAM_ADDRESS + sprite * 4) - 16;
+    int16_t bottom = top + sprite_height(self);
+    uint64_t bit = (uint64_t) 1 << sprite;
+
+    for (int16_t y = (top < 0) ? 0 : top; y < bottom && y < SCREEN_HEIGHT; y++) {
+        self->line_masks[y] = visible ? (self->line_masks[y] | bit) : (self->line_masks[y] & ~bit);
+        self->line_dirty[y] = true;
+    }
+
+}
+
+void rebuild_sprite_lines (ppu *self) {
+
+    memset(self->line_masks, 0, sizeof(self->line_masks));
+    memset(self->line_dirty, true, sizeof(self->line_dirty));
+
+    for (uint8_t sprite = 0; sprite < OAM_ENTRIES; sprite++) {
+        place_sprite(self, sprite, true);
+    }
+
+}
+
+// OAM writes: moving a sprite up or down moves it to other lines, and moving it sideways changes the order on its
+// lines. Tiles and attributes get looked up when drawing, so those are just stored
+static void oam_write (void *context, uint16_t address, uint8_t value) {
+
+    ppu *self = context;
+    uint8_t *oam = bus_memory_write(&self->cpu->bus, OAM_ADDRESS);
+    uint8_t offset = address - OAM_ADDRESS;
+    uint8_t sprite = offset / 4;
+
+    sync_drawing(self);
+
+    // The unusable bit after OAM
+    if (sprite >= OAM_ENTRIES) {
+        oam[offset] = value;
+        return;
+    }
+
+    switch (offset % 4) {
+        case 0:
+            place_sprite(self, sprite, false);
+            oam[offset] = value;
+            place_sprite(self, sprite, true);
+            break;
+        case 1:
+            oam[offset] = value;
+            place_sprite(self, sprite, true);
+            break;
+        default:
+            oam[offset] = value;
+            break;
+    }
+
+}
+
+// The sprites to draw on line y: the first 10 in OAM that are on it, sorted so the ones that win overlaps come
+// first. Where sprites overlap the one further left wins, and on a tie the one first in OAM
+const uint8_t *sprites_on_line (ppu *self, uint8_t y, uint8_t *count) {
+
+    if (self->line_dirty[y]) {
+
+        const uint8_t *oam = bus_memory(&self->cpu->bus, OAM_ADDRESS);
+        uint8_t *found = self->line_sprites[y];
+        uint8_t found_count = 0;
+
+        for (uint64_t mask = self->line_masks[y]; mask != 0 && found_count < SPRITES_PER_LINE; mask &= mask - 1) {
+
+            uint8_t sprite = __builtin_ctzll(mask);
+
+            // This one comes later in OAM than all the others so far, so it only goes before the ones further right
+            int8_t j = found_count - 1;
+            while (j >= 0 && oam[found[j] * 4 + 1] > oam[sprite * 4 + 1]) {
+                found[j + 1] = found[j];
+                j -= 1;
+            }
+            found[j + 1] = sprite;
+            found_count += 1;
+        }
+
+        self->line_sprite_count[y] = found_count;
+        self->line_dirty[y] = false;
+    }
+
+    *count = self->line_sprite_count[y];
+    return self->line_sprites[y];
+
+}
+
+
+// --  Rendering  --
+
+// Background or window tiles for one line: count tiles from a tile map row, starting at column first_column
+static void fetch_map_row (ppu *self, uint16_t map, uint8_t map_row, uint8_t first_column, uint8_t row,
+    uint8_t count, uint8_t *indices) {
+
+    const uint8_t *row_tiles = vram(self, map + map_row * 32);
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t tile = row_tiles[(first_column + i) & 31];
+        memcpy(indices + i * 8, cached_tile(self, tile_index(self, tile, false))[row], 8);
+    }
+
+}
+
+// Draw the sprites on this line over what's there. bg_indices says which pixels have background color 0, since
+// sprites with the priority bit set only show up over those. Where sprites overlap, the winner's pixel is the one
+// that counts even if it ends up behind the background, so every pixel a sprite takes stays taken
+static void render_sprites (ppu *self, const uint8_t *bg_indices, uint8_t *line) {
+
+    const uint8_t *oam = bus_memory(&self->cpu->bus, OAM_ADDRESS);
+    uint8_t height = sprite_height(self);
+
+    uint8_t count;
+    const uint8_t *sprites = sprites_on_line(self, self->ly, &count);
+    bool taken[SCREEN_WIDTH] = { false };
+
+    for (uint8_t i = 0; i < count; i++) {
+
+        const uint8_t *entry = oam + sprites[i] * 4;
+        int16_t x = entry[1] - 8;
+        uint8_t tile = entry[2];
+        uint8_t attributes = entry[3];
+
+        uint8_t row = self->ly - (entry[0] - 16);
+        if (attributes & 0x40) {
+            row = height - 1 - row;
+        }
+        if (height == 16) {
+            tile &= 0xFE;
+        }
+
+        // Tall sprites carry on into the next tile for their bottom half
+        const uint8_t *indices = cached_tile(self, tile_index(self, tile + row / 8, true))[row % 8];
+        uint8_t shades[8];
+        apply_palette(indices, 8, (attributes & 0x10) ? self->obp1 : self->obp0, shades);
+
+        for (uint8_t pixel = 0; pixel < 8; pixel++) {
+
+            int16_t screen_x = x + ((attributes & 0x20) ? 7 - pixel : pixel);
+            if (screen_x < 0 || screen_x >= SCREEN_WIDTH) {
+                continue;
+            }
+            // Color 0 is see-through
+            if (indices[pixel] == 0 || taken[screen_x]) {
+                continue;
+            }
+            taken[screen_x] = true;
+            if ((attributes & 0x80) && bg_indices[screen_x] != 0) {
+                continue;
+            }
+            line[screen_x] = shades[pixel];
+        }
+    }
+
+}
+
+void render_scanline (ppu *self) {
+
+    uint8_t *line = self->framebuffer[self->ly];
+    // One extra tile on each side, since scrolling can leave part of one hanging off the left
+    uint8_t bg_indices[SCREEN_WIDTH + 16];
+    uint8_t *visible = bg_indices;
+
+    if (self->lcdc & LCDC_BG_ENABLE) {
+
+        // Background
+        uint16_t map = (self->lcdc & LCDC_BG_MAP) ? 0x1C00 : 0x1800;
+        uint8_t y = self->ly + self->scy;
+        fetch_map_row(self, map, y / 8, self->scx / 8, y % 8, SCREEN_WIDTH / 8 + 1, bg_indices);
+        visible = bg_indices + (self->scx % 8);
+
+        // Window, over the background from WX - 7 on
+        int16_t window_x = self->wx - 7;
+        if ((self->lcdc & LCDC_WINDOW_ENABLE) && self->ly >= self->wy && window_x < SCREEN_WIDTH) {
+
+            uint8_t window_indices[SCREEN_WIDTH + 8];
+            uint16_t window_map = (self->lcdc & LCDC_WINDOW_MAP) ? 0x1C00 : 0x1800;
+            fetch_map_row(self, window_map, self->window_line / 8, 0, self->window_line % 8,
+                SCREEN_WIDTH / 8 + 1, window_indices);
+
+            // Window pixels replace the background ones from window_x on (window_x can be a bit negative)
+            int16_t start = (window_x < 0) ? 0 : window_x;
+            memmove(visible + start, window_indices + (start - window_x), SCREEN_WIDTH - start);
+
+            self->window_line += 1;
+        }
+
+        apply_palette(visible, SCREEN_WIDTH, self->bgp, line);
+
+    } else {
+        // With the background off it's all white (and every sprite shows up in front of it)
+        memset(bg_indices, 0, sizeof(bg_indices));
+        memset(line, 0, SCREEN_WIDTH);
+    }
+
+    if (self->lcdc & LCDC_SPRITE_ENABLE) {
+        render_sprites(self, visible, line);
+    }
+
+}
+
+
+// --  Engines  --
+
+static void scanline_start (ppu *self, uint64_t time) {
+    render_scanline(self);
+}
+
+static uint64_t scanline_draw_until (ppu *self, uint64_t now) {
+    return self->line_start + OAM_SCAN_CYCLES + DRAWING_CYCLES;
+}
+
+static const ppu_engine scanline_engine = { scanline_start, scanline_draw_until };
+
+// Headless lines: nothing to draw, just wait out mode 3. With the dot-accurate engine that's as long as the FIFO
+// would've taken (give or take the sprite penalty, see fifo.h), so games timing things off mode 3 don't notice
+static void headless_start (ppu *self, uint64_t time) {
+
+    uint16_t length = DRAWING_CYCLES;
+
+    if (self->accuracy == PPU_DOT_ACCURATE) {
+        uint8_t count = 0;
+        if (self->lcdc & LCDC_SPRITE_ENABLE) {
+            sprites_on_line(self, self->ly, &count);
+        }
+        length += self->scx % 8 + count * 6;
+        if ((self->lcdc & LCDC_WINDOW_ENABLE) && self->window_triggered && self->wx < SCREEN_WIDTH + 7) {
+            length += 6;
+        }
+    }
+    self->drawing_end = time + length;
+
+}
+
+static uint64_t headless_draw_until (ppu *self, uint64_t now) {
+    return self->drawing_end;
+}
+
+static const ppu_engine headless_engine = { headless_start, headless_draw_until };
+
+static const ppu_engine *engine_for (ppu *self) {
+    if (!self->drawing) {
+        return &headless_engine;
+    }
+    return (self->accuracy == PPU_DOT_ACCURATE) ? &fifo_engine : &scanline_engine;
+}
+
+void set_ppu_accuracy (ppu *self, PpuAccuracy accuracy) {
+    self->accuracy = accuracy;
+}
+
+void set_ppu_headless (ppu *self, bool headless) {
+    self->headless = headless;
+}
+
+void draw_frame (ppu *self) {
+    self->draw_next_frame = true;
+}
+
+// Every engine, in the order save states number them
+static const ppu_engine *const engines[] = { &scanline_engine, &fifo_engine, &headless_engine };
+#define ENGINE_COUNT (sizeof(engines) / sizeof(engines[0]))
+
+uint8_t ppu_engine_number (const ppu *self) {
+    for (uint8_t i = 0; i < ENGINE_COUNT; i++) {
+        if (engines[i] == self->engine) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+bool set_ppu_engine_number (ppu *self, uint8_t number) {
+    if (number >= ENGINE_COUNT) {
+        return false;
+    }
+    self->engine = engines[number];
+    return true;
+}
+
+// Games that change things in the middle of a line, and need the dot-accurate engine to look right
+static const char *const dot_accurate_titles[] = {
+    "PREHISTORIK MAN",
+};
+
+PpuAccuracy accuracy_for_title (const char *title) {
+
+    for (size_t i = 0; i < sizeof(dot_accurate_titles) / sizeof(dot_accurate_titles[0]); i++) {
+        if (strcmp(title, dot_accurate_titles[i]) == 0) {
+            return PPU_DOT_ACCURATE;
+        }
+    }
+    return PPU_SCANLINE;
+
+}
+
+
+// --  Modes  --
+
+static void enter_mode (ppu *self, PpuMode mode) {
+    self->mode = mode;
+    self->stat = (self->stat & ~0x03) | mode;
+}
+
+// Back to line 0, and decide whether this frame gets drawn
+static void start_frame (ppu *self) {
+
+    self->ly = 0;
+    self->window_line = 0;
+    self->window_triggered = false;
+
+    self->drawing = !self->headless || self->draw_next_frame;
+    self->draw_next_frame = false;
+
+}
+
+// EVENT_PPU: time for the next mode. time is when this one was due, so the next is timed from that and not from
+// whenever the CPU got around to it
+static void next_mode (void *context, uint64_t time) {
+
+    ppu *self = context;
+    scheduler *events = &self->cpu->scheduler;
+
+    switch (self->mode) {
+
+        case MODE_OAM_SCAN:
+            if (self->ly == self->wy) {
+                self->window_triggered = true;
+            }
+            enter_mode(self, MODE_DRAWING);
+            self->engine = engine_for(self);
+            self->engine->start_drawing(self, time);
+            schedule_event(events, EVENT_PPU, self->engine->draw_until(self, time));
+            break;
+
+        case MODE_DRAWING: {
+            // The engine might not be done yet, and if not it says when to check back
+            uint64_t end = self->engine->draw_until(self, time);
+            if (end > time) {
+                schedule_event(events, EVENT_PPU, end);
+                break;
+            }
+            enter_mode(self, MODE_HBLANK);
+            request_stat(self, STAT_HBLANK_INTERRUPT);
+            schedule_event(events, EVENT_PPU, self->line_start + LINE_CYCLES);
+            break;
+        }
+
+        case MODE_HBLANK:
+            self->ly += 1;
+            compare_ly(self);
+
+            if (self->ly == SCREEN_HEIGHT) {
+                enter_mode(self, MODE_VBLANK);
+                request_interrupt(self->cpu, INTERRUPT_VBLANK);
+                request_stat(self, STAT_VBLANK_INTERRUPT);
+
+                self->frames += 1;
+                if (self->frame_done != NULL) {
+                    self->frame_done(self->frame_context, self->drawing ? &self->framebuffer[0][0] : NULL);
+                }
+                schedule_event(events, EVENT_PPU, time + LINE_CYCLES);
+            } else {
+                enter_mode(self, MODE_OAM_SCAN);
+                request_stat(self, STAT_OAM_INTERRUPT);
+                self->line_start = time;
+                schedule_event(events, EVENT_PPU, time + OAM_SCAN_CYCLES);
+            }
+            break;
+
+        case MODE_VBLANK:
+            self->ly += 1;
+
+            if (self->ly == LINES_PER_FRAME) {
+                // Back to the top for the next frame
+                start_frame(self);
+                enter_mode(self, MODE_OAM_SCAN);
+                request_stat(self, STAT_OAM_INTERRUPT);
+                self->line_start = time;
+                schedule_event(events, EVENT_PPU, time + OAM_SCAN_CYCLES);
+            } else {
+                schedule_event(events, EVENT_PPU, time + LINE_CYCLES);
+            }
+            compare_ly(self);
+            break;
+
+    }
+
+}
+
+// Turning the LCD on starts a frame from the top, and turning it off stops everything at line 0
+static void set_lcd_enabled (ppu *self, bool enabled) {
+
+    start_frame(self);
+
+    if (enabled) {
+        enter_mode(self, MODE_OAM_SCAN);
+        compare_ly(self);
+        self->line_start = self->cpu->cycles;
+        schedule_event(&self->cpu->scheduler, EVENT_PPU, self->cpu->cycles + OAM_SCAN_CYCLES);
+    } else {
+        enter_mode(self, MODE_HBLANK);
+        cancel_event(&self->cpu->scheduler, EVENT_PPU);
+    }
+
+}
+
+
+// --  Registers  --
+
+static uint8_t ppu_read (void *context, uint16_t address) {
+
+    ppu *self = context;
+
+    switch (address) {
+        case LCDC_ADDRESS: return self->lcdc;
+        // Bit 7 doesn't exist
+        case STAT_ADDRESS: return self->stat | 0x80;
+        case SCY_ADDRESS: return self->scy;
+        case SCX_ADDRESS: return self->scx;
+        case LY_ADDRESS: return self->ly;
+        case LYC_ADDRESS: return self->lyc;
+        case BGP_ADDRESS: return self->bgp;
+        case OBP0_ADDRESS: return self->obp0;
+        case OBP1_ADDRESS: return self->obp1;
+        case WY_ADDRESS: return self->wy;
+        case WX_ADDRESS: return self->wx;
+        default: return 0xFF;
+    }
+
+}
+
+static void ppu_write (void *context, uint16_t address, uint8_t value) {
+
+    ppu *self = context;
+    sync_drawing(self);
+
+    switch (address) {
+        case LCDC_ADDRESS: {
+            bool was_enabled = self->lcdc & LCDC_LCD_ENABLE;
+            bool size_changed = (self->lcdc ^ value) & LCDC_SPRITE_SIZE;
+            self->lcdc = value;
+            // Every sprite just got taller or shorter
+            if (size_changed) {
+                rebuild_sprite_lines(self);
+            }
+            if (was_enabled != ((value & LCDC_LCD_ENABLE) != 0)) {
+                set_lcd_enabled(self, !was_enabled);
+            }
+            break;
+        }
+        case STAT_ADDRESS:
+            // Only the interrupt enables can be written
+            self->stat = (self->stat & 0x07) | (value & 0x78);
+            break;
+        case SCY_ADDRESS: self->scy = value; break;
+        case SCX_ADDRESS: self->scx = value; break;
+        // LY is read-only
+        case LY_ADDRESS: break;
+        case LYC_ADDRESS:
+            self->lyc = value;
+            if (self->lcdc & LCDC_LCD_ENABLE) {
+                compare_ly(self);
+            }
+            break;
+        case DMA_ADDRESS: {
+            // OAM DMA: copy 160 bytes from value * 0x100 into OAM. The real thing takes 640 clock cycles, during
+            // which the CPU can only get at HRAM, but games wait it out in HRAM anyway, so just do it now. It
+            // changes every sprite at once, so the sprite lists get redone once at the end instead of per byte
+            uint16_t source = value << 8;
+            uint8_t *oam = bus_memory_write(&self->cpu->bus, OAM_ADDRESS);
+            for (uint16_t i = 0; i < OAM_ENTRIES * 4; i++) {
+                oam[i] = read_byte(&self->cpu->bus, source + i);
+            }
+            rebuild_sprite_lines(self);
+            break;
+        }
+        case BGP_ADDRESS: self->bgp = value; break;
+        case OBP0_ADDRESS: self->obp0 = value; break;
+        case OBP1_ADDRESS: self->obp1 = value; break;
+        case WY_ADDRESS: self->wy = value; break;
+        case WX_ADDRESS: self->wx = value; break;
+    }
+
+}
+
+void init_ppu (ppu *self, cpu *cpu) {
+
+    memset(self, 0, sizeof(ppu));
+    self->cpu = cpu;
+
+    // What the boot ROM leaves behind
+    self->lcdc = 0x91;
+    self->bgp = 0xFC;
+
+    // Reads from tile data stay plain memory, but writes go through vram_write to keep the tile cache honest
+    map_memory(&cpu->bus, 0x80, (TILE_DATA_END - 0x8000) / BUS_PAGE_SIZE, 0x80, false);
+    map_handlers(&cpu->bus, 0x80, (TILE_DATA_END - 0x8000) / BUS_PAGE_SIZE, NULL, vram_write, self);
+    invalidate_tiles(self);
+
+    // Same for OAM, so the sprite lists can follow along
+    map_memory(&cpu->bus, 0xFE, 1, OAM_ADDRESS >> 8, false);
+    map_handlers(&cpu->bus, 0xFE, 1, NULL, oam_write, self);
+    rebuild_sprite_lines(self);
+
+    for (uint16_t address = LCDC_ADDRESS; address <= WX_ADDRESS; address++) {
+        map_io_register(&cpu->bus, address, ppu_read, ppu_write, self);
+    }
+    set_event_handler(&cpu->scheduler, EVENT_PPU, next_mode, self);
+
+    self->accuracy = PPU_SCANLINE;
+    self->engine = &scanline_engine;
+
+    set_lcd_enabled(self, true);
+
+}
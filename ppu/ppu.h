@@ -0,0 +1,240 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../cpu/cpu-struct.h"
+
+/* -- PPU --
+    Every line takes 456 clock cycles: 80 looking through OAM for sprites (mode 2), 172 drawing (mode 3), and the
+    rest waiting for the next line (mode 0, HBlank). After the 144 visible lines come 10 more of VBlank (mode 1), and
+    then it starts over: 70224 clock cycles per frame.
+
+    Each of those mode changes is an event on the scheduler. What happens during mode 3 is up to one of two engines:
+
+     - Scanline (the default): the whole line gets drawn in one go when mode 3 starts, and mode 3 always takes 172
+       clock cycles. Changing scroll or palettes in the middle of a line won't show up until the next one, which
+       almost no game does
+     - Dot-accurate (fifo.c): the pixel FIFO and the tile fetcher run clock cycle by clock cycle, so mid-line
+       changes land on the right pixel and mode 3 takes as long as it really would. It only runs when something
+       needs it to (a write to the PPU's registers, VRAM or OAM, or the end of mode 3), so it's not much slower
+       for games that don't do anything mid-line, just a lot slower for the ones that do
+
+    Headless frames (see set_ppu_headless) go through all the same modes, interrupts and timing, but nothing gets
+    drawn: no tiles decoded, no pixels written. Whether a frame gets drawn is decided when it starts, so it can be
+    switched frame by frame.
+
+    The picture is kept as shades (0 is white, 3 is black), one byte per pixel.
+*/
+
+#define SCREEN_WIDTH 160
+#define SCREEN_HEIGHT 144
+
+#define LINE_CYCLES 456
+#define OAM_SCAN_CYCLES 80
+#define DRAWING_CYCLES 172
+#define HBLANK_CYCLES (LINE_CYCLES - OAM_SCAN_CYCLES - DRAWING_CYCLES)
+#define LINES_PER_FRAME 154
+
+// 0x8000-0x97FF holds 384 tiles of 16 bytes
+#define TILE_COUNT 384
+#define TILE_DATA_END 0x9800
+
+// OAM holds 40 sprites of 4 bytes (Y, X, tile, attributes), and only 10 of them fit on a line
+#define OAM_ADDRESS 0xFE00
+#define OAM_ENTRIES 40
+#define SPRITES_PER_LINE 10
+
+#define LCDC_ADDRESS 0xFF40
+#define STAT_ADDRESS 0xFF41
+#define SCY_ADDRESS 0xFF42
+#define SCX_ADDRESS 0xFF43
+#define LY_ADDRESS 0xFF44
+#define LYC_ADDRESS 0xFF45
+#define DMA_ADDRESS 0xFF46
+#define BGP_ADDRESS 0xFF47
+#define OBP0_ADDRESS 0xFF48
+#define OBP1_ADDRESS 0xFF49
+#define WY_ADDRESS 0xFF4A
+#define WX_ADDRESS 0xFF4B
+
+// LCDC bits
+#define LCDC_BG_ENABLE 0x01
+#define LCDC_SPRITE_ENABLE 0x02
+#define LCDC_SPRITE_SIZE 0x04
+#define LCDC_BG_MAP 0x08
+#define LCDC_TILE_DATA 0x10
+#define LCDC_WINDOW_ENABLE 0x20
+#define LCDC_WINDOW_MAP 0x40
+#define LCDC_LCD_ENABLE 0x80
+
+// STAT bits (besides the mode in the bottom two)
+#define STAT_COINCIDENCE 0x04
+#define STAT_HBLANK_INTERRUPT 0x08
+#define STAT_VBLANK_INTERRUPT 0x10
+#define STAT_OAM_INTERRUPT 0x20
+#define STAT_COINCIDENCE_INTERRUPT 0x40
+
+typedef enum {
+    MODE_HBLANK,
+    MODE_VBLANK,
+    MODE_OAM_SCAN,
+    MODE_DRAWING
+} PpuMode;
+
+typedef enum {
+    PPU_SCANLINE,
+    PPU_DOT_ACCURATE
+} PpuAccuracy;
+
+struct PPU;
+
+// What an engine has to do: start drawing a line, and draw it up to some point
+typedef struct PpuEngine {
+    // Mode 3 just started, at time
+    void (*start_drawing) (struct PPU *self, uint64_t time);
+    // Draw the line up to now. Returns when it got finished if that's happened by now, or else the soonest it could be
+    uint64_t (*draw_until) (struct PPU *self, uint64_t now);
+} ppu_engine;
+
+// Where the dot-accurate engine is in the current line (see fifo.c)
+typedef struct PixelFifo {
+
+    // How far it's drawn, and when it finished (if it has)
+    uint64_t time;
+    uint64_t end;
+    bool done;
+
+    // The next pixel on the screen, and how many from the background still need throwing away for SCX
+    uint8_t x;
+    uint8_t discard;
+
+    // Background pixels waiting to go out
+    uint8_t background[8];
+    uint8_t background_next;
+    uint8_t background_count;
+
+    // The tile fetcher: how many clock cycles into the current tile it is, which tile column it's on, and what it's
+    // read so far. first_fetch is the one at the start of each line that gets thrown away
+    uint8_t fetch_step;
+    uint8_t fetch_column;
+    uint8_t fetch_tile;
+    uint8_t fetch_low;
+    uint8_t fetch_high;
+    bool first_fetch;
+    bool in_window;
+
+    // Sprite pixels lined up with the next 8 on the screen (color index, plus the attributes' palette and priority
+    // bits), the sprites still to come on this line (left to right), and how long the current sprite fetch has left
+    uint8_t sprite_pixels[8];
+    uint8_t sprites[SPRITES_PER_LINE];
+    uint8_t sprite_count;
+    uint8_t next_sprite;
+    uint8_t sprite_stall;
+
+} pixel_fifo;
+
+typedef struct PPU {
+
+    cpu *cpu;
+
+    uint8_t lcdc;
+    uint8_t stat;
+    uint8_t scy;
+    uint8_t scx;
+    uint8_t ly;
+    uint8_t lyc;
+    uint8_t bgp;
+    uint8_t obp0;
+    uint8_t obp1;
+    uint8_t wy;
+    uint8_t wx;
+
+    uint8_t mode;
+    // When the current line started (mode 2)
+    uint64_t line_start;
+    // The window has its own line counter, which only goes up on lines where the window actually showed
+    uint8_t window_line;
+
+    // Every tile already decoded into color indices, 8 rows of 8. Writing to a tile through the bus marks it dirty,
+    // and it gets decoded again the next time something draws it
+    uint8_t tiles[TILE_COUNT][8][8];
+    bool tile_dirty[TILE_COUNT];
+
+    // Which sprites are on each line, kept up to date as OAM gets written instead of searching it every line.
+    // line_masks has a bit for every sprite that covers the line. line_sprites is what actually gets drawn (the
+    // first 10 of those, winners first), and gets redone from the mask when line_dirty says it's stale
+    uint64_t line_masks[SCREEN_HEIGHT];
+    uint8_t line_sprites[SCREEN_HEIGHT][SPRITES_PER_LINE];
+    uint8_t line_sprite_count[SCREEN_HEIGHT];
+    bool line_dirty[SCREEN_HEIGHT];
+
+    // Which engine draws the lines. accuracy is what's been asked for, and engine is what's drawing the current line
+    // (switching only takes effect from the next one)
+    PpuAccuracy accuracy;
+    const ppu_engine *engine;
+    pixel_fifo fifo;
+    // Whether the window has hit WY yet this frame (only the dot-accurate engine cares)
+    bool window_triggered;
+
+    // Whether frames get drawn: headless is the setting, draw_next_frame asks for one frame to be drawn anyway, and
+    // drawing is what was decided for the current frame. When nothing's drawn, mode 3 just ends when it would have
+    bool headless;
+    bool draw_next_frame;
+    bool drawing;
+    uint64_t drawing_end;
+
+    uint8_t framebuffer[SCREEN_HEIGHT][SCREEN_WIDTH];
+    uint64_t frames;
+
+    // Called at the start of every VBlank, once the frame is all drawn (if it's set). framebuffer is NULL for
+    // headless frames
+    void (*frame_done) (void *context, const uint8_t *framebuffer);
+    void *frame_context;
+
+} ppu;
+
+// Which of the 384 tiles a tile number means. BG and window tiles can use signed numbers from 0x9000 (LCDC bit 4
+// off), sprites always go from 0x8000
+static inline uint16_t tile_index (ppu *self, uint8_t tile, bool sprite) {
+    if (sprite || (self->lcdc & LCDC_TILE_DATA)) {
+        return tile;
+    }
+    return 256 + (int8_t) tile;
+}
+
+static inline uint8_t sprite_height (ppu *self) {
+    return (self->lcdc & LCDC_SPRITE_SIZE) ? 16 : 8;
+}
+
+// Hook the PPU's registers up to the bus and its modes to the scheduler, and turn the LCD on
+void init_ppu (ppu *self, cpu *cpu);
+
+// Mark every tile dirty, for when VRAM got changed without going through the bus
+void invalidate_tiles (ppu *self);
+
+// Work out every line's sprites from scratch, for when OAM got changed without going through the bus
+void rebuild_sprite_lines (ppu *self);
+
+// Draw line ly of the framebuffer from what's in VRAM and OAM right now
+void render_scanline (ppu *self);
+
+// The sprites to draw on line y, sorted so the ones that win overlaps come first (which is also left to right)
+const uint8_t *sprites_on_line (ppu *self, uint8_t y, uint8_t *count);
+
+// Pick the engine for lines from the next one on
+void set_ppu_accuracy (ppu *self, PpuAccuracy accuracy);
+// Stop drawing frames (or start again), from the next frame on. draw_frame gets just the next one drawn
+void set_ppu_headless (ppu *self, bool headless);
+void draw_frame (ppu *self);
+
+// Which engine is drawing the current line, as a number that means the same thing from one run to the next (for
+// save states), and back. Returns false for a number that isn't an engine
+uint8_t ppu_engine_number (const ppu *self);
+bool set_ppu_engine_number (ppu *self, uint8_t number);
+
+// The engine a game should get, going by its title in the cartridge header: dot-accurate for the ones known to do
+// things mid-line, scanline for everything else
+PpuAccuracy accuracy_for_title (const char *title);
+
+#endif
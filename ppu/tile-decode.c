@@ -0,0 +1,188 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+// Local libraries
+#include "tile-decode.h"
+
+
+// --  Scalar  --
+
+void decode_tiles_scalar (const uint8_t *planes, uint16_t count, uint8_t *indices) {
+
+    for (uint16_t tile = 0; tile < count; tile++) {
+
+        uint8_t low = planes[tile * 2];
+        uint8_t high = planes[tile * 2 + 1];
+
+        // Pixel 0 is bit 7
+        for (uint8_t x = 0; x < 8; x++) {
+            uint8_t bit = 7 - x;
+            indices[tile * 8 + x] = ((low >> bit) & 1) | (((high >> bit) & 1) << 1);
+        }
+    }
+
+}
+
+void apply_palette_scalar (const uint8_t *indices, uint16_t count, uint8_t palette, uint8_t *shades) {
+
+    for (uint16_t i = 0; i < count; i++) {
+        shades[i] = (palette >> (indices[i] * 2)) & 0x3;
+    }
+
+}
+
+
+// --  SSE2 / SSSE3  --
+
+#if defined(__SSE2__)
+
+// Decode two tile rows (16 pixels) from four bytes: low A, high A, low B, high B
+static inline __m128i decode_pair (uint32_t bytes) {
+
+    // Which bit each pixel comes from, leftmost first, for both tiles
+    const __m128i bit_masks = _mm_set_epi8(
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80,
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80);
+
+    // Spread the bytes out until each one fills 4 lanes: low A x4, high A x4, low B x4, high B x4
+    __m128i v = _mm_cvtsi32_si128((int) bytes);
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+
+    // And then 8 lanes per tile: one register with both low bytes, one with both high bytes
+    __m128i low = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i high = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 1, 1));
+
+    // Each lane keeps only its own bit, which turns into 0xFF if it was set
+    low = _mm_cmpeq_epi8(_mm_and_si128(low, bit_masks), bit_masks);
+    high = _mm_cmpeq_epi8(_mm_and_si128(high, bit_masks), bit_masks);
+
+    return _mm_or_si128(_mm_and_si128(low, _mm_set1_epi8(1)), _mm_and_si128(high, _mm_set1_epi8(2)));
+
+}
+
+void decode_tiles (const uint8_t *planes, uint16_t count, uint8_t *indices) {
+
+    uint16_t tile = 0;
+
+    for (; tile + 2 <= count; tile += 2) {
+        uint32_t bytes;
+        memcpy(&bytes, planes + tile * 2, sizeof(bytes));
+        _mm_storeu_si128((__m128i *) (indices + tile * 8), decode_pair(bytes));
+    }
+
+    // An odd one out at the end
+    if (tile < count) {
+        decode_tiles_scalar(planes + tile * 2, count - tile, indices + tile * 8);
+    }
+
+}
+
+// Map 16 color indices to shades. shades holds the four shades in its first four bytes
+static inline __m128i map_shades (__m128i indices, __m128i shades) {
+
+#if defined(__SSSE3__)
+    // Every index picks its shade straight out of the palette vector
+    return _mm_shuffle_epi8(shades, indices);
+#else
+    // No byte shuffle in plain SSE2, so compare against each index and keep the matching shade
+    uint32_t table = (uint32_t) _mm_cvtsi128_si32(shades);
+    __m128i result = _mm_setzero_si128();
+    for (int index = 0; index < 4; index++) {
+        __m128i match = _mm_cmpeq_epi8(indices, _mm_set1_epi8((char) index));
+        __m128i shade = _mm_set1_epi8((char) ((table >> (index * 8)) & 0xFF));
+        result = _mm_or_si128(result, _mm_and_si128(match, shade));
+    }
+    return result;
+#endif
+
+}
+
+void apply_palette (const uint8_t *indices, uint16_t count, uint8_t palette, uint8_t *shades) {
+
+    __m128i palette_shades = _mm_cvtsi32_si128(
+        (palette & 0x3) | (((palette >> 2) & 0x3) << 8) | (((palette >> 4) & 0x3) << 16) | (((palette >> 6) & 0x3) << 24));
+    uint16_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (indices + i));
+        _mm_storeu_si128((__m128i *) (shades + i), map_shades(v, palette_shades));
+    }
+
+    if (i < count) {
+        apply_palette_scalar(indices + i, count - i, palette, shades + i);
+    }
+
+}
+
+#else
+
+void decode_tiles (const uint8_t *planes, uint16_t count, uint8_t *indices) {
+    decode_tiles_scalar(planes, count, indices);
+}
+
+void apply_palette (const uint8_t *indices, uint16_t count, uint8_t palette, uint8_t *shades) {
+    apply_palette_scalar(indices, count, palette, shades);
+}
+
+#endif
+
+
+// --  Verification  --
+
+bool verify_tile_decoder (void) {
+
+    // Every possible tile row, in pairs so both halves of the vector version get a go at each one. The second row of
+    // each pair is the same bytes swapped around (and one flipped), so the two halves never see the same thing
+    uint8_t planes[4];
+    uint8_t vector[16];
+    uint8_t scalar[16];
+
+    for (uint32_t row = 0; row < 0x10000; row++) {
+
+        planes[0] = row & 0xFF;
+        planes[1] = row >> 8;
+        planes[2] = ~(row >> 8);
+        planes[3] = row & 0xFF;
+
+        decode_tiles(planes, 2, vector);
+        decode_tiles_scalar(planes, 2, scalar);
+        if (memcmp(vector, scalar, sizeof(vector)) != 0) {
+            return false;
+        }
+    }
+
+    // Every palette, over every index in every lane
+    uint8_t indices[32];
+    uint8_t vector_shades[32];
+    uint8_t scalar_shades[32];
+
+    for (uint16_t palette = 0; palette < 0x100; palette++) {
+        // Shifting the pattern around gives every lane every index
+        for (uint8_t shift = 0; shift < 4; shift++) {
+
+            for (uint8_t i = 0; i < 32; i++) {
+                indices[i] = (i * 7 + i / 4 + shift) & 0x3;
+            }
+
+            // 32 goes through the vector path twice, 27 leaves some for the scalar tail
+            for (uint16_t count = 27; count <= 32; count += 5) {
+                apply_palette(indices, count, palette, vector_shades);
+                apply_palette_scalar(indices, count, palette, scalar_shades);
+                if (memcmp(vector_shades, scalar_shades, count) != 0) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+
+}
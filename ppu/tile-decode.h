@@ -0,0 +1,31 @@
+#ifndef TILE_DECODE_H
+#define TILE_DECODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* -- Tile decoding --
+    Every row of a tile is two bytes (bitplanes): the first has bit 0 of each pixel's color index and the second has
+    bit 1, leftmost pixel in bit 7. Turning those into one byte per pixel, and then those color indices into shades
+    through a palette (BGP, OBP0, OBP1: 2 bits per index), is the hottest thing the PPU does.
+
+    With SSE2 (every x86-64 has it) two tile rows get decoded at a time, 16 pixels per register, and with SSSE3 the
+    palette is a single byte shuffle. Everything has a scalar version too, which is what gets used anywhere else,
+    and which the vector versions have to agree with exactly (see verify_tile_decoder).
+*/
+
+// Decode count tile rows. planes holds them one after the other as (low, high) byte pairs, and indices gets
+// count * 8 color indices (0-3), leftmost pixel first
+void decode_tiles (const uint8_t *planes, uint16_t count, uint8_t *indices);
+// Map count color indices to shades (0-3) through a palette register
+void apply_palette (const uint8_t *indices, uint16_t count, uint8_t palette, uint8_t *shades);
+
+// The plain one-pixel-at-a-time versions
+void decode_tiles_scalar (const uint8_t *planes, uint16_t count, uint8_t *indices);
+void apply_palette_scalar (const uint8_t *indices, uint16_t count, uint8_t palette, uint8_t *shades);
+
+// Check the vector versions against the scalar ones for every possible tile row and palette (make check runs it,
+// see tests/tile-decode.c)
+bool verify_tile_decoder (void);
+
+#endif
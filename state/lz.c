@@ -0,0 +1,223 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+// Local libraries
+#include "lz.h"
+
+// Where the last 4 bytes that hashed the same were seen, 2^LZ_HASH_BITS of them
+#define LZ_HASH_BITS 12
+
+
+// --  Compression  --
+
+static inline uint32_t read32 (const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t read64 (const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash (uint32_t value) {
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// A length that didn't fit in its 4 bits of the token: the rest of it, 255 at a time
+static uint8_t *write_length (uint8_t *out, size_t length) {
+
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = length;
+    return out;
+
+}
+
+// One sequence: the literals, then the match (if there is one: length 0 means it's the last sequence)
+static uint8_t *write_sequence (uint8_t *out, const uint8_t *literals, size_t literal_count, size_t offset,
+    size_t length) {
+
+    uint8_t *token = out++;
+    size_t match = (length > 0) ? length - LZ_MIN_MATCH : 0;
+
+    *token = ((literal_count < 15) ? literal_count : 15) << 4;
+    if (literal_count >= 15) {
+        out = write_length(out, literal_count - 15);
+    }
+    memcpy(out, literals, literal_count);
+    out += literal_count;
+
+    if (length == 0) {
+        return out;
+    }
+
+    out[0] = offset & 0xFF;
+    out[1] = offset >> 8;
+    out += 2;
+    *token |= (match < 15) ? match : 15;
+    if (match >= 15) {
+        out = write_length(out, match - 15);
+    }
+    return out;
+
+}
+
+size_t lz_compress (const uint8_t *in, size_t size, uint8_t *out, size_t capacity) {
+
+    // Everything from here on fits, whatever it is (the bound's for the worst case)
+    if (capacity < lz_bound(size)) {
+        return 0;
+    }
+
+    // Positions plus one, so 0 means nothing's been seen with that hash
+    uint32_t table[1 << LZ_HASH_BITS] = {0};
+
+    const uint8_t *start = out;
+    size_t anchor = 0;
+    size_t i = 0;
+
+    while (size >= LZ_MIN_MATCH && i <= size - LZ_MIN_MATCH) {
+
+        uint32_t value = read32(in + i);
+        uint32_t h = hash(value);
+        size_t candidate = table[h];
+        table[h] = i + 1;
+
+        // The longer it's been since the last match, the bigger the steps (data that doesn't compress goes by fast)
+        if (candidate == 0 || i - (candidate - 1) > LZ_MAX_OFFSET || read32(in + candidate - 1) != value) {
+            i += 1 + ((i - anchor) >> 6);
+            continue;
+        }
+        candidate--;
+
+        // 8 bytes at a time while there's room, then one at a time (the first byte that differs is the lowest set
+        // byte of the XOR, on a little-endian host)
+        size_t length = LZ_MIN_MATCH;
+        while (i + length + 8 <= size) {
+            uint64_t difference = read64(in + candidate + length) ^ read64(in + i + length);
+            if (difference != 0) {
+                length += __builtin_ctzll(difference) / 8;
+                goto matched;
+            }
+            length += 8;
+        }
+        while (i + length < size && in[candidate + length] == in[i + length]) {
+            length++;
+        }
+    matched:
+
+        out = write_sequence(out, in + anchor, i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+
+        // The next match is likely to start right here, so make sure the spot just before is in the table
+        if (i >= 2 && i - 2 <= size - LZ_MIN_MATCH) {
+            table[hash(read32(in + i - 2))] = i - 1;
+        }
+    }
+
+    out = write_sequence(out, in + anchor, size - anchor, 0, 0);
+    return out - start;
+
+}
+
+
+// --  Decompression  --
+
+// The rest of a length, if its 4 bits in the token said there was more
+static bool read_length (const uint8_t **in, const uint8_t *end, size_t *length) {
+
+    if (*length < 15) {
+        return true;
+    }
+
+    uint8_t byte;
+    do {
+        if (*in >= end) {
+            return false;
+        }
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+
+}
+
+bool lz_decompress (const uint8_t *in, size_t size, uint8_t *out, size_t out_size) {
+
+    const uint8_t *end = in + size;
+    size_t done = 0;
+
+    while (in < end) {
+
+        uint8_t token = *in++;
+
+        size_t literal_count = token >> 4;
+        if (!read_length(&in, end, &literal_count)) {
+            return false;
+        }
+        if (literal_count > (size_t) (end - in) || literal_count > out_size - done) {
+            return false;
+        }
+        // Short runs of literals go in one fixed-size copy when there's room for it on both sides
+        if (literal_count <= 16 && end - in >= 16 && out_size - done >= 16) {
+            memcpy(out + done, in, 16);
+        } else {
+            memcpy(out + done, in, literal_count);
+        }
+        in += literal_count;
+        done += literal_count;
+
+        // The last sequence ends right after its literals
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t length = token & 0x0F;
+        if (!read_length(&in, end, &length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > done || length > out_size - done) {
+            return false;
+        }
+
+        uint8_t *to = out + done;
+        const uint8_t *from = to - offset;
+        if (offset == 1) {
+            memset(to, *from, length);
+        } else if (offset >= length) {
+            memcpy(to, from, length);
+        } else if (offset >= 8) {
+            // Overlapping, but every 8 bytes copied only read what's already there
+            size_t j = 0;
+            for (; j + 8 <= length; j += 8) {
+                memcpy(to + j, from + j, 8);
+            }
+            for (; j < length; j++) {
+                to[j] = from[j];
+            }
+        } else {
+            for (size_t j = 0; j < length; j++) {
+                to[j] = from[j];
+            }
+        }
+        done += length;
+    }
+
+    return done == out_size;
+
+}
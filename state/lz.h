@@ -0,0 +1,38 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* -- LZ compression --
+    A small LZ77 in the style of LZ4, for save states: fast both ways, and good at what emulator memory is mostly
+    made of (long runs of zeros, and the same few bytes over and over).
+
+    The compressed data is a string of sequences. Each one starts with a token byte: the top 4 bits are how many
+    literal bytes come next, and the bottom 4 how long the match after them is (minus LZ_MIN_MATCH). A 15 in either
+    means the length goes on in the bytes after the token (or after the literals, for the match), 255 at a time
+    until one's less than that. Then come the literals, and a 2-byte little-endian offset back to where the match
+    copies from. The last sequence only has literals, and no offset.
+
+    Matches can overlap where they're being copied to (an offset of 1 is a run of one byte), so they get copied
+    front to back.
+*/
+
+#define LZ_MIN_MATCH 4
+// The furthest back a match can be
+#define LZ_MAX_OFFSET 0xFFFF
+
+// The most size bytes can come out as, if nothing in them matches at all
+static inline size_t lz_bound (size_t size) {
+    return size + size / 255 + 16;
+}
+
+// Compress size bytes from in into out. Returns how many bytes that took, or 0 if it wouldn't fit in capacity
+size_t lz_compress (const uint8_t *in, size_t size, uint8_t *out, size_t capacity);
+
+// Decompress in (size bytes of it) into out, which it has to fill exactly: returns false if it comes out any other
+// size, or if in is broken (it never reads or writes past either end, whatever's in there)
+bool lz_decompress (const uint8_t *in, size_t size, uint8_t *out, size_t out_size);
+
+#endif
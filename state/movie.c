@@ -0,0 +1,353 @@
+// Standard libraries
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+// Local libraries
+#include "movie.h"
+#include "savestate.h"
+#include "../io/joypad.h"
+
+#define MOVIE_MAGIC "GBMOVIE"
+
+typedef struct MovieHeader {
+
+    char magic[8];
+    uint32_t version;
+    uint32_t keyframe_interval;
+    uint64_t frames;
+    uint64_t run_count;
+    uint64_t keyframe_count;
+    // How many bytes the runs and the states take
+    uint64_t runs_size;
+    uint64_t states_size;
+
+} movie_header;
+
+
+// --  Setup  --
+
+void init_movie (movie *self, uint32_t keyframe_interval) {
+    memset(self, 0, sizeof(movie));
+    self->keyframe_interval = (keyframe_interval > 0) ? keyframe_interval : 1;
+}
+
+void free_movie (movie *self) {
+
+    free(self->runs);
+    free(self->keyframes);
+    free(self->states);
+    memset(self, 0, sizeof(movie));
+
+}
+
+// Make room for needed items of size each, doubling so that growing one at a time doesn't copy every time
+static bool reserve (void **array, uint64_t *capacity, uint64_t needed, size_t size) {
+
+    if (needed <= *capacity) {
+        return true;
+    }
+    uint64_t grown = (*capacity > 0) ? *capacity : 16;
+    while (grown < needed) {
+        grown *= 2;
+    }
+
+    void *bigger = realloc(*array, grown * size);
+    if (bigger == NULL) {
+        return false;
+    }
+    *array = bigger;
+    *capacity = grown;
+    return true;
+
+}
+
+
+// --  Recording  --
+
+// Keep emulator's state as the keyframe for the frame about to be recorded
+static bool add_keyframe (movie *self, const emu *emulator) {
+
+    size_t bound = state_size_bound(emulator);
+    if (!reserve((void **) &self->keyframes, &self->keyframe_capacity, self->keyframe_count + 1,
+            sizeof(movie_keyframe)) ||
+        !reserve((void **) &self->states, &self->states_capacity, self->states_size + bound, 1)) {
+        return false;
+    }
+
+    size_t size = save_state(emulator, self->states + self->states_size, bound, true);
+    if (size == 0) {
+        return false;
+    }
+
+    // The run this frame goes in doesn't exist yet, but it's going to be the last one or a new one after it
+    movie_keyframe *key = &self->keyframes[self->keyframe_count++];
+    key->offset = self->states_size;
+    key->size = size;
+    key->run = self->run_count;
+    self->states_size += size;
+    return true;
+
+}
+
+bool record_movie_frame (movie *self, emu *emulator, uint8_t input) {
+
+    bool keyframe = (self->frames % self->keyframe_interval == 0);
+    if (keyframe && !add_keyframe(self, emulator)) {
+        return false;
+    }
+
+    movie_run *last = (self->run_count > 0) ? &self->runs[self->run_count - 1] : NULL;
+    if (last != NULL && last->input == input && last->length < UINT32_MAX) {
+        last->length++;
+    } else {
+        if (!reserve((void **) &self->runs, &self->run_capacity, self->run_count + 1, sizeof(movie_run))) {
+            if (keyframe) {
+                self->keyframe_count--;
+                self->states_size = self->keyframes[self->keyframe_count].offset;
+            }
+            return false;
+        }
+        self->runs[self->run_count++] = (movie_run) { .start = self->frames, .length = 1, .input = input };
+    }
+
+    // Which run the keyframe lands in is only settled now
+    if (keyframe) {
+        self->keyframes[self->keyframe_count - 1].run = self->run_count - 1;
+    }
+
+    self->frames++;
+    set_joypad(&emulator->joypad, input);
+    run_frame(emulator);
+    return true;
+
+}
+
+
+// --  Playing back  --
+
+bool seek_movie (const movie *self, emu *emulator, uint64_t frame) {
+
+    if (frame > self->frames || self->keyframe_count == 0) {
+        return false;
+    }
+
+    // The end of a movie that finished right on a keyframe's frame doesn't have that keyframe yet
+    uint64_t index = frame / self->keyframe_interval;
+    if (index >= self->keyframe_count) {
+        index = self->keyframe_count - 1;
+    }
+    const movie_keyframe *key = &self->keyframes[index];
+    if (!load_state(emulator, self->states + key->offset, key->size)) {
+        return false;
+    }
+
+    // Play the rest of the way, straight through the runs from the keyframe's
+    uint64_t at = index * self->keyframe_interval;
+    for (uint64_t run = key->run; at < frame; run++) {
+        const movie_run *r = &self->runs[run];
+        uint64_t end = r->start + r->length;
+        for (; at < end && at < frame; at++) {
+            set_joypad(&emulator->joypad, r->input);
+            run_frame(emulator);
+        }
+    }
+    return true;
+
+}
+
+uint8_t movie_input (const movie *self, uint64_t frame) {
+
+    // The last run that starts at or before it
+    uint64_t low = 0;
+    uint64_t high = self->run_count;
+    while (high - low > 1) {
+        uint64_t middle = low + (high - low) / 2;
+        if (self->runs[middle].start <= frame) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return (self->run_count > 0) ? self->runs[low].input : 0;
+
+}
+
+
+// --  Files  --
+
+// Lengths go in 7 bits at a time, low bits first, with the top bit set on every byte but the last
+static uint8_t *write_length (uint8_t *out, uint64_t length) {
+
+    while (length >= 0x80) {
+        *out++ = (length & 0x7F) | 0x80;
+        length >>= 7;
+    }
+    *out++ = length;
+    return out;
+
+}
+
+static bool read_length (const uint8_t **in, const uint8_t *end, uint64_t *length) {
+
+    *length = 0;
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+        if (*in >= end) {
+            return false;
+        }
+        uint8_t byte = *(*in)++;
+        *length |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+
+}
+
+bool save_movie_file (const movie *self, const char *path) {
+
+    // A run's length takes 5 bytes at most, and then there's its buttons
+    uint8_t *runs = malloc(self->run_count * 6 + 1);
+    if (runs == NULL) {
+        return false;
+    }
+    uint8_t *next = runs;
+    for (uint64_t i = 0; i < self->run_count; i++) {
+        next = write_length(next, self->runs[i].length);
+        *next++ = self->runs[i].input;
+    }
+
+    movie_header header;
+    memset(&header, 0, sizeof(movie_header));
+    memcpy(header.magic, MOVIE_MAGIC, sizeof(header.magic));
+    header.version = MOVIE_VERSION;
+    header.keyframe_interval = self->keyframe_interval;
+    header.frames = self->frames;
+    header.run_count = self->run_count;
+    header.keyframe_count = self->keyframe_count;
+    header.runs_size = next - runs;
+    header.states_size = self->states_size;
+
+    FILE *file = fopen(path, "wb");
+    bool ok = (file != NULL &&
+        fwrite(&header, sizeof(movie_header), 1, file) == 1 &&
+        fwrite(self->keyframes, sizeof(movie_keyframe), self->keyframe_count, file) == self->keyframe_count &&
+        fwrite(runs, 1, header.runs_size, file) == header.runs_size &&
+        fwrite(self->states, 1, self->states_size, file) == self->states_size);
+    if (file != NULL && fclose(file) != 0) {
+        ok = false;
+    }
+
+    free(runs);
+    return ok;
+
+}
+
+// Fill self in from a whole movie file, checking everything that could send seeking somewhere it shouldn't go.
+// What's in the states gets checked when they're loaded
+static bool read_movie (movie *self, const uint8_t *data, size_t size) {
+
+    movie_header header;
+    if (size < sizeof(movie_header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(movie_header));
+    if (memcmp(header.magic, MOVIE_MAGIC, sizeof(header.magic)) != 0 || header.version != MOVIE_VERSION ||
+        header.keyframe_interval == 0) {
+        return false;
+    }
+
+    // Every frame has a run, every keyframe_interval-th one has a keyframe, and everything adds up to the file
+    uint64_t rest = size - sizeof(movie_header);
+    if (header.run_count > header.frames ||
+        header.keyframe_count != header.frames / header.keyframe_interval +
+            (header.frames % header.keyframe_interval != 0) ||
+        header.keyframe_count > rest / sizeof(movie_keyframe)) {
+        return false;
+    }
+    rest -= header.keyframe_count * sizeof(movie_keyframe);
+    // And a run takes 2 bytes at least
+    if (header.runs_size > rest || header.states_size != rest - header.runs_size ||
+        header.run_count > header.runs_size / 2) {
+        return false;
+    }
+
+    self->keyframe_interval = header.keyframe_interval;
+    if (!reserve((void **) &self->runs, &self->run_capacity, header.run_count, sizeof(movie_run)) ||
+        !reserve((void **) &self->keyframes, &self->keyframe_capacity, header.keyframe_count,
+            sizeof(movie_keyframe)) ||
+        !reserve((void **) &self->states, &self->states_capacity, header.states_size, 1)) {
+        return false;
+    }
+
+    const uint8_t *at = data + sizeof(movie_header);
+    memcpy(self->keyframes, at, header.keyframe_count * sizeof(movie_keyframe));
+    self->keyframe_count = header.keyframe_count;
+    at += header.keyframe_count * sizeof(movie_keyframe);
+
+    const uint8_t *end = at + header.runs_size;
+    for (uint64_t i = 0; i < header.run_count; i++) {
+        uint64_t length;
+        if (!read_length(&at, end, &length) || at >= end || length == 0 || length > UINT32_MAX ||
+            length > header.frames - self->frames) {
+            return false;
+        }
+        self->runs[self->run_count++] = (movie_run) { .start = self->frames, .length = length, .input = *at++ };
+        self->frames += length;
+    }
+    if (at != end || self->frames != header.frames) {
+        return false;
+    }
+
+    memcpy(self->states, at, header.states_size);
+    self->states_size = header.states_size;
+
+    for (uint64_t i = 0; i < self->keyframe_count; i++) {
+        const movie_keyframe *key = &self->keyframes[i];
+        uint64_t frame = i * self->keyframe_interval;
+        if (key->offset > self->states_size || key->size > self->states_size - key->offset ||
+            key->run >= self->run_count || self->runs[key->run].start > frame ||
+            self->runs[key->run].start + self->runs[key->run].length <= frame) {
+            return false;
+        }
+    }
+    return true;
+
+}
+
+bool load_movie_file (movie *self, const char *path) {
+
+    init_movie(self, 1);
+
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) < 0 || info.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    bool ok = read_movie(self, data, info.st_size);
+    munmap(data, info.st_size);
+    if (!ok) {
+        free_movie(self);
+    }
+    return ok;
+
+}
@@ -0,0 +1,84 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../emulator/emulator.h"
+
+/* -- Movies --
+    A recording of a run, as the buttons held on every frame (see joypad.h) from a save state on. The emulator does
+    the same thing every time it's given the same buttons from the same state, so playing them back gets the same
+    run, down to the last bit (the state hash in statehash.h can check that it did).
+
+    The buttons hardly ever change from one frame to the next, so they go in as runs: the buttons, and how many
+    frames they were held for. Playing a long movie back from the start just to look at somewhere near the end
+    would take as long as the run itself did, though, so every keyframe_interval frames it keeps a whole save state
+    too (compressed, see savestate.h), with an index of where each one is and which run of buttons it lands in.
+    Seeking to any frame is loading the keyframe at or before it and playing at most keyframe_interval - 1 frames
+    from there, however far in it is.
+
+    Files are a header, the keyframe index, the runs (each one's length 7 bits at a time, then its buttons) and the
+    keyframes' states one after the other, in the host's byte order like the states themselves.
+*/
+
+#define MOVIE_VERSION 1
+
+typedef struct MovieRun {
+
+    // The frame it starts on, how many it goes on for, and what's held through all of them
+    uint64_t start;
+    uint32_t length;
+    uint8_t input;
+
+} movie_run;
+
+typedef struct MovieKeyframe {
+
+    // Where its state is in states, and how big it is
+    uint64_t offset;
+    uint64_t size;
+    // The run its frame is in
+    uint64_t run;
+
+} movie_keyframe;
+
+typedef struct Movie {
+
+    uint32_t keyframe_interval;
+    uint64_t frames;
+
+    movie_run *runs;
+    uint64_t run_count;
+    uint64_t run_capacity;
+
+    // Keyframe i is the state right before frame i * keyframe_interval
+    movie_keyframe *keyframes;
+    uint64_t keyframe_count;
+    uint64_t keyframe_capacity;
+
+    uint8_t *states;
+    uint64_t states_size;
+    uint64_t states_capacity;
+
+} movie;
+
+// Start an empty movie, with a keyframe every keyframe_interval frames
+void init_movie (movie *self, uint32_t keyframe_interval);
+void free_movie (movie *self);
+
+// Hold input down for the next frame of the movie and run it on emulator (which has to be where the movie's got to,
+// the same one as the last frame, say). Returns false if there wasn't the memory to keep it, without running it
+bool record_movie_frame (movie *self, emu *emulator, uint8_t input);
+
+// Put emulator where it was right before frame (or at the end, for frames), from the keyframe before it. The
+// emulator has to be running the same cartridge. Returns false if the movie doesn't go that far
+bool seek_movie (const movie *self, emu *emulator, uint64_t frame);
+
+// What was held on frame, to play on from where seek_movie left off
+uint8_t movie_input (const movie *self, uint64_t frame);
+
+// Movies as files. Loading sets self up from scratch, like init_movie does (so free it first if it was in use)
+bool save_movie_file (const movie *self, const char *path);
+bool load_movie_file (movie *self, const char *path);
+
+#endif
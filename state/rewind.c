@@ -0,0 +1,329 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+// Local libraries
+#include "lz.h"
+#include "rewind.h"
+#include "savestate.h"
+
+// What goes in front of every snapshot in the ring
+typedef struct Snapshot {
+
+    // How many bytes of it come after this
+    size_t size;
+    // Where the one before it starts (nothing, for the oldest)
+    size_t previous;
+    bool keyframe;
+
+} snapshot;
+
+
+// --  Deltas  --
+
+static inline uint64_t read64 (const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Lengths go in 7 bits at a time, low bits first, with the top bit set on every byte but the last
+static uint8_t *write_length (uint8_t *out, size_t length) {
+
+    while (length >= 0x80) {
+        *out++ = (length & 0x7F) | 0x80;
+        length >>= 7;
+    }
+    *out++ = length;
+    return out;
+
+}
+
+static bool read_length (const uint8_t **in, const uint8_t *end, size_t *length) {
+
+    *length = 0;
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+        if (*in >= end) {
+            return false;
+        }
+        uint8_t byte = *(*in)++;
+        *length |= (size_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+
+}
+
+// state XORed with key, as pairs of runs: how many bytes stayed the same, then how many changed and what they XOR
+// to. Returns how long that came out, or 0 if it's no smaller than the state itself (a keyframe's better then)
+static size_t encode_delta (const uint8_t *state, const uint8_t *key, size_t size, uint8_t *out) {
+
+    const uint8_t *start = out;
+    size_t at = 0;
+
+    while (at < size) {
+
+        size_t same = at;
+        while (at + 8 <= size && read64(state + at) == read64(key + at)) {
+            at += 8;
+        }
+        while (at < size && state[at] == key[at]) {
+            at++;
+        }
+        same = at - same;
+
+        // Changes go on until there's a whole 8 bytes that didn't (a byte here and there isn't worth a new pair)
+        size_t changed = at;
+        while (at < size && !(at + 8 <= size && read64(state + at) == read64(key + at))) {
+            at++;
+        }
+        changed = at - changed;
+
+        // Two lengths take 20 bytes at most
+        if ((size_t) (out - start) + 20 + changed >= size) {
+            return 0;
+        }
+        out = write_length(out, same);
+        out = write_length(out, changed);
+        for (size_t i = at - changed; i < at; i++) {
+            *out++ = state[i] ^ key[i];
+        }
+    }
+
+    return out - start;
+
+}
+
+// XOR a delta into state, which has to be its keyframe's state
+static bool apply_delta (uint8_t *state, size_t size, const uint8_t *delta, size_t delta_size) {
+
+    const uint8_t *end = delta + delta_size;
+    size_t at = 0;
+
+    while (delta < end) {
+
+        size_t same;
+        size_t changed;
+        if (!read_length(&delta, end, &same) || !read_length(&delta, end, &changed)) {
+            return false;
+        }
+        if (same > size - at || changed > size - at - same || changed > (size_t) (end - delta)) {
+            return false;
+        }
+
+        at += same;
+        for (size_t i = 0; i < changed; i++) {
+            state[at + i] ^= delta[i];
+        }
+        at += changed;
+        delta += changed;
+    }
+
+    return true;
+
+}
+
+
+// --  Ring  --
+
+static snapshot read_snapshot (const rewind_buffer *self, size_t at) {
+    snapshot s;
+    memcpy(&s, self->ring + at, sizeof(snapshot));
+    return s;
+}
+
+// Drop the oldest keyframe and every delta against it
+static void drop_oldest (rewind_buffer *self) {
+
+    do {
+        snapshot s = read_snapshot(self, self->first);
+        self->first += sizeof(snapshot) + s.size;
+        if (self->wrapped && self->first == self->limit) {
+            self->first = 0;
+            self->wrapped = false;
+        }
+        self->count--;
+    } while (self->count > 0 && !read_snapshot(self, self->first).keyframe);
+
+    if (self->count == 0) {
+        self->first = 0;
+        self->head = 0;
+        self->wrapped = false;
+    }
+
+}
+
+// Find room for size bytes, dropping the oldest snapshots until there is. A delta can't have its own keyframe
+// dropped, so that gives up and returns false instead (and so does anything bigger than the whole ring)
+static bool make_room (rewind_buffer *self, size_t size, bool keyframe, size_t *at) {
+
+    for (;;) {
+
+        if (!self->wrapped) {
+            if (self->head + size <= self->capacity) {
+                *at = self->head;
+                return true;
+            }
+            if (size <= self->first) {
+                self->limit = self->head;
+                self->wrapped = true;
+                *at = 0;
+                return true;
+            }
+        } else if (self->head + size <= self->first) {
+            *at = self->head;
+            return true;
+        }
+
+        if (self->count == 0 || (!keyframe && self->first == self->key)) {
+            return false;
+        }
+        drop_oldest(self);
+    }
+
+}
+
+// Put the snapshot in encoded at the front of the ring
+static bool add_snapshot (rewind_buffer *self, size_t size, bool keyframe) {
+
+    size_t at;
+    if (!make_room(self, sizeof(snapshot) + size, keyframe, &at)) {
+        return false;
+    }
+
+    snapshot s = { .size = size, .previous = self->newest, .keyframe = keyframe };
+    memcpy(self->ring + at, &s, sizeof(snapshot));
+    memcpy(self->ring + at + sizeof(snapshot), self->encoded, size);
+
+    if (self->count == 0) {
+        self->first = at;
+    }
+    self->head = at + sizeof(snapshot) + size;
+    self->newest = at;
+    self->count++;
+
+    if (keyframe) {
+        self->key = at;
+        self->since_keyframe = 0;
+    } else {
+        self->since_keyframe++;
+    }
+    return true;
+
+}
+
+
+// --  Setup  --
+
+bool init_rewind (rewind_buffer *self, const emu *source, size_t budget, uint32_t keyframe_interval) {
+
+    memset(self, 0, sizeof(rewind_buffer));
+
+    // Two states, somewhere to compress one into, and room in the ring for at least that
+    size_t state_size = state_size_bound(source);
+    size_t encoded_size = lz_bound(state_size);
+    size_t needed = 2 * state_size + encoded_size;
+    if (budget < needed + sizeof(snapshot) + encoded_size) {
+        return false;
+    }
+
+    uint8_t *memory = malloc(budget);
+    if (memory == NULL) {
+        return false;
+    }
+    self->key_state = memory;
+    self->state = memory + state_size;
+    self->encoded = memory + 2 * state_size;
+    self->encoded_size = encoded_size;
+    self->ring = memory + needed;
+    self->capacity = budget - needed;
+
+    self->keyframe_interval = (keyframe_interval > 0) ? keyframe_interval : 1;
+    self->state_size = save_state(source, self->state, state_size, false);
+    return true;
+
+}
+
+void free_rewind (rewind_buffer *self) {
+    // Everything else lives in the same block, after the two states
+    free(self->key_state);
+    memset(self, 0, sizeof(rewind_buffer));
+}
+
+
+// --  Pushing and rewinding  --
+
+bool push_rewind (rewind_buffer *self, const emu *source) {
+
+    if (save_state(source, self->state, self->state_size, false) != self->state_size) {
+        return false;
+    }
+
+    if (self->count > 0 && self->since_keyframe + 1 < self->keyframe_interval) {
+        size_t size = encode_delta(self->state, self->key_state, self->state_size, self->encoded);
+        if (size > 0 && add_snapshot(self, size, false)) {
+            return true;
+        }
+    }
+
+    // A keyframe, either because it's time, or the delta wasn't worth it, or there wasn't room for it without
+    // dropping its own keyframe
+    size_t size = lz_compress(self->state, self->state_size, self->encoded, self->encoded_size);
+    if (size == 0 || !add_snapshot(self, size, true)) {
+        return false;
+    }
+    memcpy(self->key_state, self->state, self->state_size);
+    return true;
+
+}
+
+bool rewind_emu (rewind_buffer *self, emu *target, uint32_t back) {
+
+    if (back >= self->count) {
+        return false;
+    }
+
+    size_t at = self->newest;
+    for (uint32_t i = 0; i < back; i++) {
+        at = read_snapshot(self, at).previous;
+    }
+    snapshot s = read_snapshot(self, at);
+
+    // Its keyframe, and how far back that is
+    size_t key = at;
+    uint32_t since_keyframe = 0;
+    while (!read_snapshot(self, key).keyframe) {
+        key = read_snapshot(self, key).previous;
+        since_keyframe++;
+    }
+
+    if (key != self->key) {
+        snapshot k = read_snapshot(self, key);
+        if (!lz_decompress(self->ring + key + sizeof(snapshot), k.size, self->key_state, self->state_size)) {
+            return false;
+        }
+        self->key = key;
+    }
+    memcpy(self->state, self->key_state, self->state_size);
+    if (!s.keyframe && !apply_delta(self->state, self->state_size, self->ring + at + sizeof(snapshot), s.size)) {
+        return false;
+    }
+    if (!load_state(target, self->state, self->state_size)) {
+        return false;
+    }
+
+    // Everything after it goes. If that was all of the bottom part of a wrapped ring, it isn't wrapped anymore
+    if (self->wrapped && at >= self->first) {
+        self->wrapped = false;
+    }
+    self->head = at + sizeof(snapshot) + s.size;
+    self->newest = at;
+    self->count -= back;
+    self->since_keyframe = since_keyframe;
+    return true;
+
+}
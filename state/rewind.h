@@ -0,0 +1,70 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../emulator/emulator.h"
+
+/* -- Rewind --
+    A ring of save states (see savestate.h), one pushed every frame, that can be gone back through. Most of a state
+    doesn't change from one frame to the next, so only every keyframe_interval-th one goes in whole (compressed,
+    see lz.h). The ones in between go in as the bytes that changed since their keyframe: the state XORed with the
+    keyframe's, which is mostly zeros, with the runs of zeros taken out. Getting any state back is one decompressed
+    keyframe and one delta on top, however far back it is.
+
+    Everything lives in one block of memory the size of the budget: the ring, and the few whole states it needs to
+    work (the keyframe deltas are against, and one to build states in). When a new state doesn't fit, the oldest
+    keyframe goes, along with every delta that needed it, so how far back it reaches depends on how much the game
+    changes from frame to frame, not on a count of frames.
+*/
+
+typedef struct Rewind {
+
+    // The ring. Snapshots go in at head, and the oldest one is at first. When one doesn't fit before the end it
+    // goes at the start instead, and limit is where the ones before it stopped (so the ring holds [first, limit)
+    // and then [0, head))
+    uint8_t *ring;
+    size_t capacity;
+    size_t first;
+    size_t head;
+    size_t limit;
+    bool wrapped;
+
+    size_t newest;
+    uint32_t count;
+
+    // A keyframe every this many snapshots, and how many deltas there have been since the last one (at key)
+    uint32_t keyframe_interval;
+    uint32_t since_keyframe;
+    size_t key;
+
+    // Every state of the same emulator comes out the same size. key_state is the keyframe's, state is for making
+    // new ones and putting old ones back together, and encoded is for compressing them into
+    size_t state_size;
+    uint8_t *key_state;
+    uint8_t *state;
+    uint8_t *encoded;
+    size_t encoded_size;
+
+} rewind_buffer;
+
+// Set up a rewind buffer for source (or any emulator with the same cartridge) that never uses more than budget
+// bytes. Returns false if that isn't enough to hold the states it needs plus a bit of ring, or there isn't the
+// memory
+bool init_rewind (rewind_buffer *self, const emu *source, size_t budget, uint32_t keyframe_interval);
+void free_rewind (rewind_buffer *self);
+
+// Take a snapshot of source (once a frame, usually). Returns false if it didn't fit even with the ring emptied
+bool push_rewind (rewind_buffer *self, const emu *source);
+
+// Load the snapshot that's back snapshots before the newest (0 is the newest) into target, and forget the ones
+// after it, so the next push goes on from there. Returns false if there aren't that many
+bool rewind_emu (rewind_buffer *self, emu *target, uint32_t back);
+
+// How many snapshots it's holding right now
+static inline uint32_t rewind_count (const rewind_buffer *self) {
+    return self->count;
+}
+
+#endif
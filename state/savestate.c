@@ -0,0 +1,435 @@
+// Standard libraries
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+// Local libraries
+#include "lz.h"
+#include "savestate.h"
+#include "../cartridge/cartridge.h"
+#include "../cpu/block-cache.h"
+#include "../cpu/memorybus.h"
+#include "../ppu/ppu.h"
+
+#define STATE_MAGIC "GBSTATE"
+// The cartridge header from the title to the checksums, which a state has to match to load
+#define CARTRIDGE_ID_SIZE (HEADER_GLOBAL_CHECKSUM + 2 - HEADER_TITLE)
+// Bigger than any part gets (the PPU's the biggest, because of the framebuffer)
+#define PART_BUFFER_SIZE 0x8000
+
+typedef struct StateHeader {
+
+    char magic[8];
+    uint16_t version;
+    uint16_t sections;
+    // The whole state, this included
+    uint32_t size;
+    uint8_t cartridge[CARTRIDGE_ID_SIZE];
+
+} state_header;
+
+typedef struct SectionHeader {
+
+    char tag[4];
+    // Which chunk, for memory
+    uint32_t index;
+    // How big it is, and how big it is in the state (the same if it isn't compressed)
+    uint32_t size;
+    uint32_t stored;
+
+} section_header;
+
+
+// --  Parts  --
+
+// A field of the emulator, wherever it is in there
+typedef struct StateField {
+    size_t offset;
+    size_t size;
+} state_field;
+
+#define FIELD(member) { offsetof(emu, member), sizeof(((emu *) NULL)->member) }
+// A channel, up to its sample buffer
+#define CHANNEL(i) { offsetof(emu, apu.channels[i]), offsetof(channel, output) }
+
+static const state_field cpu_fields[] = {
+    FIELD(cpu.cpu_registers), FIELD(cpu.flags), FIELD(cpu.pc), FIELD(cpu.sp),
+    FIELD(cpu.ime), FIELD(cpu.ime_scheduled), FIELD(cpu.halted), FIELD(cpu.locked),
+    FIELD(cpu.cycles),
+};
+
+// The handlers stay, they're the same in every emulator. Which events are pending and when, and the order the heap
+// has them in, is what has to match
+static const state_field scheduler_fields[] = {
+    FIELD(cpu.scheduler.next), FIELD(cpu.scheduler.heap), FIELD(cpu.scheduler.count),
+    FIELD(cpu.scheduler.position), FIELD(cpu.scheduler.times),
+};
+
+static const state_field cartridge_fields[] = {
+    FIELD(cartridge.ram_enabled), FIELD(cartridge.rom_bank), FIELD(cartridge.ram_bank),
+    FIELD(cartridge.bank_high), FIELD(cartridge.banking_mode), FIELD(cartridge.clock), FIELD(cartridge.clock_latch),
+};
+
+static const state_field io_fields[] = {
+    FIELD(timer.counter_start), FIELD(timer.synced), FIELD(timer.tima), FIELD(timer.tma), FIELD(timer.tac),
+    FIELD(serial.sb), FIELD(serial.sc), FIELD(joypad.select), FIELD(joypad.pressed),
+};
+
+// Plus which engine is drawing the current line (see gather)
+static const state_field ppu_fields[] = {
+    FIELD(ppu.lcdc), FIELD(ppu.stat), FIELD(ppu.scy), FIELD(ppu.scx), FIELD(ppu.ly), FIELD(ppu.lyc),
+    FIELD(ppu.bgp), FIELD(ppu.obp0), FIELD(ppu.obp1), FIELD(ppu.wy), FIELD(ppu.wx),
+    FIELD(ppu.mode), FIELD(ppu.line_start), FIELD(ppu.window_line),
+    FIELD(ppu.fifo), FIELD(ppu.window_triggered),
+    FIELD(ppu.draw_next_frame), FIELD(ppu.drawing), FIELD(ppu.drawing_end),
+    FIELD(ppu.framebuffer), FIELD(ppu.frames),
+};
+
+static const state_field apu_fields[] = {
+    FIELD(apu.registers), FIELD(apu.powered), FIELD(apu.sequencer_step), FIELD(apu.synced),
+    CHANNEL(CHANNEL_SQUARE1), CHANNEL(CHANNEL_SQUARE2), CHANNEL(CHANNEL_WAVE), CHANNEL(CHANNEL_NOISE),
+};
+
+static const state_field emulator_fields[] = {
+    FIELD(frames), FIELD(frame_end),
+};
+
+typedef enum {
+    PART_CPU,
+    PART_SCHEDULER,
+    PART_CARTRIDGE,
+    PART_IO,
+    PART_PPU,
+    PART_APU,
+    PART_EMULATOR,
+    PART_COUNT
+} StatePart;
+
+typedef struct Part {
+    char tag[4];
+    const state_field *fields;
+    uint8_t count;
+} state_part;
+
+#define FIELDS(list) list, sizeof(list) / sizeof(list[0])
+
+static const state_part parts[PART_COUNT] = {
+    [PART_CPU] = { "CPU ", FIELDS(cpu_fields) },
+    [PART_SCHEDULER] = { "SCHD", FIELDS(scheduler_fields) },
+    [PART_CARTRIDGE] = { "MBC ", FIELDS(cartridge_fields) },
+    [PART_IO] = { "IO  ", FIELDS(io_fields) },
+    [PART_PPU] = { "PPU ", FIELDS(ppu_fields) },
+    [PART_APU] = { "APU ", FIELDS(apu_fields) },
+    [PART_EMULATOR] = { "EMU ", FIELDS(emulator_fields) },
+};
+
+// Chunks of memory have the same tag, and their index
+static const char memory_tag[4] = "MEM ";
+
+static size_t part_size (StatePart part) {
+
+    size_t size = (part == PART_PPU) ? 1 : 0;
+    for (uint8_t i = 0; i < parts[part].count; i++) {
+        size += parts[part].fields[i].size;
+    }
+    return size;
+
+}
+
+// Every field of a part, one after the other
+static void gather (const emu *self, StatePart part, uint8_t *out) {
+
+    for (uint8_t i = 0; i < parts[part].count; i++) {
+        const state_field *field = &parts[part].fields[i];
+        memcpy(out, (const uint8_t *) self + field->offset, field->size);
+        out += field->size;
+    }
+
+    // The engine's a pointer, so it goes in as a number
+    if (part == PART_PPU) {
+        *out = ppu_engine_number(&self->ppu);
+    }
+
+}
+
+static bool scatter (emu *self, StatePart part, const uint8_t *in) {
+
+    for (uint8_t i = 0; i < parts[part].count; i++) {
+        const state_field *field = &parts[part].fields[i];
+        memcpy((uint8_t *) self + field->offset, in, field->size);
+        in += field->size;
+    }
+
+    if (part == PART_PPU) {
+        return set_ppu_engine_number(&self->ppu, *in);
+    }
+    return true;
+
+}
+
+
+// --  Saving  --
+
+size_t state_size_bound (const emu *self) {
+
+    size_t size = sizeof(state_header);
+    for (uint8_t i = 0; i < PART_COUNT; i++) {
+        size += sizeof(section_header) + lz_bound(part_size(i));
+    }
+    size += self->cpu.bus.chunk_count * (sizeof(section_header) + lz_bound(MEMORY_CHUNK_SIZE));
+    return size;
+
+}
+
+// Write one section at next, compressed if that comes out smaller. Returns where the next one goes, or NULL if it
+// didn't fit before end
+static uint8_t *write_section (uint8_t *next, const uint8_t *end, const char *tag, uint32_t index,
+    const uint8_t *data, size_t size, bool compress) {
+
+    if ((size_t) (end - next) < sizeof(section_header)) {
+        return NULL;
+    }
+
+    section_header section = { .index = index, .size = size, .stored = size };
+    memcpy(section.tag, tag, sizeof(section.tag));
+
+    uint8_t *body = next + sizeof(section_header);
+    size_t room = end - body;
+    if (compress) {
+        size_t stored = lz_compress(data, size, body, room);
+        if (stored > 0 && stored < size) {
+            section.stored = stored;
+        }
+    }
+    if (section.stored == size) {
+        if (room < size) {
+            return NULL;
+        }
+        memcpy(body, data, size);
+    }
+
+    memcpy(next, &section, sizeof(section_header));
+    return body + section.stored;
+
+}
+
+size_t save_state (const emu *self, uint8_t *out, size_t capacity, bool compress) {
+
+    const memorybus *bus = &self->cpu.bus;
+    const uint8_t *end = out + capacity;
+
+    if (capacity < sizeof(state_header)) {
+        return 0;
+    }
+    uint8_t *next = out + sizeof(state_header);
+
+    uint8_t raw[PART_BUFFER_SIZE];
+    for (uint8_t i = 0; i < PART_COUNT && next != NULL; i++) {
+        if (part_size(i) > sizeof(raw)) {
+            return 0;
+        }
+        gather(self, i, raw);
+        next = write_section(next, end, parts[i].tag, 0, raw, part_size(i), compress);
+    }
+    for (uint8_t i = 0; i < bus->chunk_count && next != NULL; i++) {
+        next = write_section(next, end, memory_tag, i, bus->chunks[i]->data, MEMORY_CHUNK_SIZE, compress);
+    }
+    if (next == NULL) {
+        return 0;
+    }
+
+    state_header header;
+    memset(&header, 0, sizeof(state_header));
+    memcpy(header.magic, STATE_MAGIC, sizeof(header.magic));
+    header.version = STATE_VERSION;
+    header.sections = PART_COUNT + bus->chunk_count;
+    header.size = next - out;
+    memcpy(header.cartridge, self->cartridge.rom + HEADER_TITLE, CARTRIDGE_ID_SIZE);
+    memcpy(out, &header, sizeof(state_header));
+
+    return next - out;
+
+}
+
+bool save_state_file (const emu *self, const char *path, bool compress) {
+
+    size_t capacity = state_size_bound(self);
+    uint8_t *buffer = malloc(capacity);
+    if (buffer == NULL) {
+        return false;
+    }
+
+    size_t size = save_state(self, buffer, capacity, compress);
+    FILE *file = (size > 0) ? fopen(path, "wb") : NULL;
+    bool ok = (file != NULL && fwrite(buffer, 1, size, file) == size);
+    if (file != NULL && fclose(file) != 0) {
+        ok = false;
+    }
+
+    free(buffer);
+    return ok;
+
+}
+
+
+// --  Loading  --
+
+// Read the section header at *at and move *at past the section. Returns where its data is, or NULL if it runs
+// past end
+static const uint8_t *next_section (const uint8_t **at, const uint8_t *end, section_header *section) {
+
+    if ((size_t) (end - *at) < sizeof(section_header)) {
+        return NULL;
+    }
+    memcpy(section, *at, sizeof(section_header));
+
+    const uint8_t *body = *at + sizeof(section_header);
+    if (section->stored > (size_t) (end - body)) {
+        return NULL;
+    }
+    *at = body + section->stored;
+    return body;
+
+}
+
+// Which part a section is: PART_COUNT for a chunk of memory, or -1 for a tag we don't know
+static int section_part (const section_header *section) {
+
+    if (memcmp(section->tag, memory_tag, sizeof(section->tag)) == 0) {
+        return PART_COUNT;
+    }
+    for (uint8_t i = 0; i < PART_COUNT; i++) {
+        if (memcmp(section->tag, parts[i].tag, sizeof(section->tag)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+
+}
+
+// A section's data, as it was before it went in, into out
+static bool unpack (const section_header *section, const uint8_t *body, uint8_t *out) {
+
+    if (section->stored == section->size) {
+        memcpy(out, body, section->size);
+        return true;
+    }
+    return lz_decompress(body, section->stored, out, section->size);
+
+}
+
+bool load_state (emu *self, const uint8_t *state, size_t size) {
+
+    memorybus *bus = &self->cpu.bus;
+
+    state_header header;
+    if (size < sizeof(state_header)) {
+        return false;
+    }
+    memcpy(&header, state, sizeof(state_header));
+    if (memcmp(header.magic, STATE_MAGIC, sizeof(header.magic)) != 0 || header.version != STATE_VERSION ||
+        header.size > size || header.size < sizeof(state_header) ||
+        memcmp(header.cartridge, self->cartridge.rom + HEADER_TITLE, CARTRIDGE_ID_SIZE) != 0) {
+        return false;
+    }
+    const uint8_t *end = state + header.size;
+
+    // Make sure every section's where it says it is and the size it should be, and nothing's missing, before
+    // touching anything
+    uint32_t parts_found = 0;
+    uint64_t chunks_found = 0;
+    const uint8_t *at = state + sizeof(state_header);
+    for (uint16_t i = 0; i < header.sections; i++) {
+
+        section_header section;
+        if (next_section(&at, end, &section) == NULL) {
+            return false;
+        }
+
+        int part = section_part(&section);
+        if (part == PART_COUNT) {
+            if (section.index >= bus->chunk_count || section.size != MEMORY_CHUNK_SIZE) {
+                return false;
+            }
+            chunks_found |= 1ull << section.index;
+        } else if (part >= 0) {
+            if (section.size != part_size(part)) {
+                return false;
+            }
+            parts_found |= 1u << part;
+        }
+    }
+    if (parts_found != (1u << PART_COUNT) - 1 || chunks_found != (1ull << bus->chunk_count) - 1) {
+        return false;
+    }
+
+    bool ok = true;
+    at = state + sizeof(state_header);
+    for (uint16_t i = 0; i < header.sections && ok; i++) {
+
+        section_header section;
+        const uint8_t *body = next_section(&at, end, &section);
+        int part = section_part(&section);
+
+        if (part == PART_COUNT) {
+            // Straight into the chunk. One that's shared with a clone gets its own copy first
+            if (__atomic_load_n(&bus->chunks[section.index]->refs, __ATOMIC_ACQUIRE) > 1) {
+                unshare_chunk(bus, section.index);
+            }
+            ok = unpack(&section, body, bus->chunks[section.index]->data);
+        } else if (part >= 0) {
+            uint8_t raw[PART_BUFFER_SIZE];
+            if (section.size > sizeof(raw)) {
+                ok = false;
+                break;
+            }
+            ok = unpack(&section, body, raw) && scatter(self, part, raw);
+        }
+    }
+
+    // The chunks got written without going through the bus, so nothing marked them
+    dirty_all_pages(bus);
+
+    // Work out everything that didn't go in from what did
+    remap_cartridge(&self->cartridge);
+    invalidate_tiles(&self->ppu);
+    rebuild_sprite_lines(&self->ppu);
+    if (self->cpu.blocks != NULL) {
+        block_cache_flush(self->cpu.blocks);
+    }
+    restart_apu_output(&self->apu);
+
+    return ok;
+
+}
+
+bool load_state_file (emu *self, const char *path) {
+
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) < 0 || info.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    void *state = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (state == MAP_FAILED) {
+        return false;
+    }
+
+    bool ok = load_state(self, state, info.st_size);
+    munmap(state, info.st_size);
+    return ok;
+
+}
@@ -0,0 +1,46 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../emulator/emulator.h"
+
+/* -- Save states --
+    Everything a running emulator needs to pick up where another one left off, as one block of bytes: a header, then
+    sections, each one a part of the emulator (the cpu's registers, the scheduler, the mapper, the PPU, the APU, the
+    timer, serial port and joypad) or a 4KB chunk of the bus's memory. Every section can be compressed (see lz.h) or
+    not, on its own: whichever comes out smaller.
+
+    Only what the game can tell apart goes in. Anything that can be worked out again (decoded tiles, the sprites on
+    each line, the page tables, the block cache) gets redone on loading, and settings (headless, audio, which PPU
+    engine to use) stay the way the loading emulator has them. Pointers never go in at all.
+
+    A state only loads into an emulator running the same cartridge, and only with the same STATE_VERSION: the parts
+    go in as the fields of the structs they're in, in the host's byte order, so anything that changes what's in
+    them changes the version too. Sections with a tag the loader doesn't know are skipped.
+
+    Loading reads straight out of whatever it's given, so load_state_file maps the file and decompresses memory
+    right into the bus's chunks from there, without a copy of the file in between.
+*/
+
+#define STATE_VERSION 3
+
+// The biggest a state of this emulator can come out as
+size_t state_size_bound (const emu *self);
+
+// Save self into out. Returns how many bytes it took, or 0 if it didn't fit in capacity. Without compress nothing
+// gets compressed, which is bigger but faster still
+size_t save_state (const emu *self, uint8_t *out, size_t capacity, bool compress);
+
+// Load a state self saved (or another emulator with the same cartridge did). Returns false if it isn't one that
+// fits: that gets checked before anything changes, so self is left as it was. Nothing checks what's inside the
+// sections, though, so a state that's been damaged there can still load as garbage, or stop halfway through a
+// compressed section that doesn't decompress (returning false, with self half loaded)
+bool load_state (emu *self, const uint8_t *state, size_t size);
+
+// The same, to and from a file
+bool save_state_file (const emu *self, const char *path, bool compress);
+bool load_state_file (emu *self, const char *path);
+
+#endif
@@ -0,0 +1,120 @@
+// Standard libraries
+#include <stdint.h>
+#include <string.h>
+// Local libraries
+#include "statehash.h"
+#include "../cpu/flags-register.h"
+#include "../cpu/memorybus.h"
+
+// The primes from xxHash64, whose round this borrows
+#define PRIME_1 0x9E3779B185EBCA87ull
+#define PRIME_2 0xC2B2AE3D27D4EB4Full
+#define PRIME_3 0x165667B19E3779F9ull
+
+
+// --  Hashing  --
+
+static inline uint64_t read64 (const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t rotate (uint64_t value, uint8_t bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t round64 (uint64_t lane, uint64_t value) {
+    return rotate(lane + value * PRIME_2, 31) * PRIME_1;
+}
+
+// Spread every bit of the input over every bit of the output
+static inline uint64_t avalanche (uint64_t h) {
+
+    h ^= h >> 33;
+    h *= PRIME_2;
+    h ^= h >> 29;
+    h *= PRIME_3;
+    h ^= h >> 32;
+    return h;
+
+}
+
+// One page of memory, seeded with which page it is so the same bytes on two pages don't cancel out. It goes
+// through in 4 lanes, each taking every 4th word, so they don't have to wait on each other's multiplies
+static uint64_t hash_page (const uint8_t *data, uint16_t page) {
+
+    uint64_t lanes[4] = { page + PRIME_1, page + PRIME_2, page ^ PRIME_3, page - PRIME_1 };
+    for (uint16_t i = 0; i < BUS_PAGE_SIZE; i += 32) {
+        for (uint8_t lane = 0; lane < 4; lane++) {
+            lanes[lane] = round64(lanes[lane], read64(data + i + lane * 8));
+        }
+    }
+    return avalanche(rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18));
+
+}
+
+static inline const uint8_t *memory_page (const memorybus *bus, uint16_t page) {
+    return bus->chunks[page / MEMORY_CHUNK_PAGES]->data + (page % MEMORY_CHUNK_PAGES) * BUS_PAGE_SIZE;
+}
+
+// Everything in the cpu that isn't memory, the way the game would see it (F worked out from the lazy flags)
+static uint64_t hash_registers (const cpu *cpu) {
+
+    const registers *r = &cpu->cpu_registers;
+    uint8_t f = resolve_flags(&cpu->flags, r->f);
+
+    uint64_t h = PRIME_3;
+    h = round64(h, ((uint64_t) r->a << 56) | ((uint64_t) f << 48) | ((uint64_t) r->b << 40) |
+        ((uint64_t) r->c << 32) | ((uint64_t) r->d << 24) | ((uint64_t) r->e << 16) | (r->h << 8) | r->l);
+    h = round64(h, ((uint64_t) cpu->pc << 32) | ((uint64_t) cpu->sp << 16) | (cpu->locked << 3) | (cpu->ime << 2) |
+        (cpu->ime_scheduled << 1) | cpu->halted);
+    h = round64(h, cpu->cycles);
+    return avalanche(h);
+
+}
+
+
+// --  Keeping it up to date  --
+
+void init_state_hash (state_hash *self, emu *source) {
+
+    const memorybus *bus = &source->cpu.bus;
+
+    memset(self, 0, sizeof(state_hash));
+    for (uint16_t page = 0; page < bus->chunk_count * MEMORY_CHUNK_PAGES; page++) {
+        self->pages[page] = hash_page(memory_page(bus, page), page);
+        self->memory += self->pages[page];
+    }
+
+    track_dirty_pages(&source->cpu.bus, true);
+    clear_dirty_pages(&source->cpu.bus);
+
+}
+
+void free_state_hash (state_hash *self, emu *source) {
+    track_dirty_pages(&source->cpu.bus, false);
+}
+
+uint64_t update_state_hash (state_hash *self, emu *source) {
+
+    memorybus *bus = &source->cpu.bus;
+
+    // A byte of dirty bits at a time, since most of them are clear
+    for (uint16_t i = 0; i < bus->chunk_count * MEMORY_CHUNK_PAGES / 8; i++) {
+
+        uint8_t dirty = bus->dirty[i];
+        while (dirty != 0) {
+            uint16_t page = i * 8 + __builtin_ctz(dirty);
+            dirty &= dirty - 1;
+
+            uint64_t h = hash_page(memory_page(bus, page), page);
+            self->memory += h - self->pages[page];
+            self->pages[page] = h;
+        }
+    }
+    clear_dirty_pages(bus);
+
+    return avalanche(self->memory ^ hash_registers(&source->cpu));
+
+}
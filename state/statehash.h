@@ -0,0 +1,33 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include <stdint.h>
+#include "../cpu/memorybus.h"
+#include "../emulator/emulator.h"
+
+/* -- State hash --
+    A 64-bit hash of an emulator's memory and CPU registers, for telling when two runs that should be the same
+    (lanes in lockstep, a replay and the run it was recorded from) stop being. Every page of memory keeps its own
+    hash, and the memory's is all of those added up, so keeping it up to date only takes rehashing the pages that
+    got written since the last time (see the dirty bits in memorybus.h) and swapping those in. The registers are few
+    enough to just hash every time.
+
+    It owns the bus's dirty bits while it's in use: it turns tracking on, and clears them every update.
+*/
+
+typedef struct StateHash {
+
+    uint64_t pages[MEMORY_PAGE_COUNT];
+    uint64_t memory;
+
+} state_hash;
+
+// Hash all of source's memory, and start tracking which pages get written from here on
+void init_state_hash (state_hash *self, emu *source);
+// Stop tracking them
+void free_state_hash (state_hash *self, emu *source);
+
+// Bring the hash up to date with whatever source has done since the last time (or init), and return it
+uint64_t update_state_hash (state_hash *self, emu *source);
+
+#endif
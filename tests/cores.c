@@ -0,0 +1,151 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+// Local libraries
+#include "test-rom.h"
+#include "../cpu/block-cache.h"
+#include "../cpu/decoder.h"
+#include "../cpu/jit.h"
+#include "../emulator/emulator.h"
+#include "../state/statehash.h"
+
+/* -- Cores test --
+    A random ROM run three ways at once: one instruction at a time, with the block cache, and with the JIT (checking
+    itself against the interpreter). Their state hashes have to agree after every frame.
+
+    Which cores those really are depends on the build (the threaded interpreter with THREADED_INTERPRETER, no JIT
+    without JIT_RECOMPILER), and the hash they finish on has to be the same whatever they are, so make check runs
+    this from two builds and compares what they print.
+*/
+
+#define FRAMES 120
+#define PROGRAM_SIZE 0x1000
+
+enum Core {
+    CORE_INTERPRETER,
+    CORE_BLOCK_CACHE,
+    CORE_JIT,
+    CORE_COUNT
+};
+
+static const char *const core_names[CORE_COUNT] = {"interpreter", "block cache", "JIT"};
+
+static const uint8_t opcodes[] = {
+    // The ALU, on registers and inmediates
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8F,
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9F,
+    0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAF,
+    0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBF,
+    0xC6, 0xCE, 0xD6, 0xDE, 0xE6, 0xEE, 0xF6, 0xFE,
+    // INC, DEC, LD r, n
+    0x04, 0x05, 0x06, 0x0C, 0x0D, 0x0E, 0x14, 0x15, 0x16, 0x1C, 0x1D, 0x1E, 0x24, 0x25, 0x26, 0x2C, 0x2D, 0x2E,
+    0x3C, 0x3D, 0x3E,
+    // LD r, r', 16-bit INC/DEC, rotates, DAA, CPL, SCF, CCF
+    0x41, 0x47, 0x4A, 0x53, 0x5C, 0x65, 0x6F, 0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D,
+    0x03, 0x13, 0x0B, 0x1B, 0x07, 0x0F, 0x17, 0x1F, 0x27, 0x2F, 0x37, 0x3F,
+    // Conditional jumps (over nothing) and CB opcodes on registers
+    0x20, 0x28, 0x30, 0x38, 0xCB
+};
+
+static uint32_t next_random (uint32_t *state) {
+
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+
+}
+
+// Random register-only code, storing A to WRAM now and then so it shows up in the hash, then back to the start
+static uint16_t make_program (uint8_t *program) {
+
+    uint32_t random = 0xC0DE5EED;
+    uint16_t size = 0;
+    uint16_t count = 0;
+
+    while (size < PROGRAM_SIZE - 8) {
+
+        uint8_t code = opcodes[next_random(&random) % sizeof(opcodes)];
+        program[size++] = code;
+
+        if (code == 0x20 || code == 0x28 || code == 0x30 || code == 0x38) {
+            program[size++] = 0;
+        } else if (code == 0xCB) {
+            // Anything but (HL)
+            uint8_t cb = next_random(&random);
+            program[size++] = ((cb & 7) == 6) ? cb + 1 : cb;
+        } else {
+            for (uint8_t i = 1; i < primary_table[code].length; i++) {
+                program[size++] = next_random(&random);
+            }
+        }
+
+        // LD (0xC0nn), A
+        if (++count % 50 == 0) {
+            program[size++] = 0xEA;
+            program[size++] = next_random(&random);
+            program[size++] = 0xC0;
+        }
+    }
+
+    // JP to the start
+    program[size++] = 0xC3;
+    program[size++] = TEST_ROM_CODE & 0xFF;
+    program[size++] = TEST_ROM_CODE >> 8;
+    return size;
+
+}
+
+int main (void) {
+
+    static uint8_t program[PROGRAM_SIZE];
+    uint16_t size = make_program(program);
+    char path[TEST_ROM_PATH_SIZE];
+    if (!write_test_rom(program, size, path)) {
+        printf("cores: couldn't write the test ROM\n");
+        return 1;
+    }
+
+    static emu emulators[CORE_COUNT];
+    state_hash hashes[CORE_COUNT];
+    for (uint8_t core = 0; core < CORE_COUNT; core++) {
+        if (!init_emu(&emulators[core], path)) {
+            printf("cores: couldn't load the test ROM\n");
+            remove(path);
+            return 1;
+        }
+        init_state_hash(&hashes[core], &emulators[core]);
+    }
+    remove(path);
+    enable_block_cache(&emulators[CORE_BLOCK_CACHE].cpu);
+    enable_block_cache(&emulators[CORE_JIT].cpu);
+    enable_jit(&emulators[CORE_JIT].cpu, true);
+
+    uint64_t hash[CORE_COUNT];
+    bool ok = true;
+    for (uint32_t frame = 0; frame < FRAMES && ok; frame++) {
+        for (uint8_t core = 0; core < CORE_COUNT; core++) {
+            run_frame(&emulators[core]);
+            hash[core] = update_state_hash(&hashes[core], &emulators[core]);
+        }
+        for (uint8_t core = 1; core < CORE_COUNT; core++) {
+            if (hash[core] != hash[CORE_INTERPRETER]) {
+                printf("cores: frame %u: the %s came out different from the interpreter\n", frame, core_names[core]);
+                ok = false;
+            }
+        }
+    }
+
+    for (uint8_t core = 0; core < CORE_COUNT; core++) {
+        free_state_hash(&hashes[core], &emulators[core]);
+        free_emu(&emulators[core]);
+    }
+
+    if (!ok) {
+        return 1;
+    }
+    printf("cores: ok (%u frames, finished on %016llx)\n", FRAMES, (unsigned long long) hash[CORE_INTERPRETER]);
+    return 0;
+
+}
@@ -0,0 +1,215 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+// Local libraries
+#include "test-rom.h"
+#include "../batch/lockstep.h"
+#include "../cpu/decoder.h"
+#include "../cpu/instructions-helpers.h"
+#include "../cpu/memorybus.h"
+
+/* -- Lockstep test --
+    Random programs in WRAM, run by 16 lanes in lockstep and by 16 emulators on their own, which have to end up the
+    same. The programs stick mostly to what the lockstep core runs itself (register loads, the ALU, INC/DEC, jumps
+    that go different ways depending on the lane), with some stack and CB opcodes thrown in to split the lanes up.
+*/
+
+#define PROGRAMS 20
+#define PROGRAM_SIZE 0x3F0
+#define FRAMES 3
+
+static const uint8_t opcodes[] = {
+    // INC, DEC, LD r, n
+    0x04, 0x05, 0x06, 0x0C, 0x0D, 0x0E, 0x14, 0x15, 0x16, 0x1C, 0x1D, 0x1E, 0x24, 0x25, 0x26, 0x2C, 0x2D, 0x2E,
+    0x3C, 0x3D, 0x3E,
+    // 16-bit loads and INC/DEC, CPL, SCF, CCF, NOP
+    0x01, 0x11, 0x21, 0x03, 0x13, 0x23, 0x0B, 0x1B, 0x2B, 0x2F, 0x37, 0x3F, 0x00,
+    // Jumps
+    0x20, 0x28, 0x30, 0x38, 0x18, 0xC2, 0xCA, 0xD2, 0xDA,
+    // LD r, r'
+    0x40, 0x41, 0x47, 0x4A, 0x53, 0x5C, 0x65, 0x6F, 0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7F,
+    // The ALU, on registers and inmediates
+    0x80, 0x81, 0x88, 0x89, 0x90, 0x92, 0x98, 0x9B, 0xA0, 0xA4, 0xA8, 0xAD, 0xB0, 0xB7, 0xB8, 0xBC, 0x87, 0x8F,
+    0x97, 0x9F, 0xA7, 0xAF, 0xBF, 0xC6, 0xCE, 0xD6, 0xDE, 0xE6, 0xEE, 0xF6, 0xFE,
+    // PUSH (always followed by a POP), DAA, rotates, CB
+    0xC5, 0xE5, 0x27, 0x07, 0x17, 0xCB
+};
+
+static uint32_t next_random (uint32_t *state) {
+
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+
+}
+
+// A random program that loops back to its start, made to run from 0xC000. Returns its size
+static uint16_t make_program (uint32_t *random, uint8_t *program) {
+
+    uint16_t size = 0;
+    uint16_t starts[PROGRAM_SIZE];
+    uint16_t start_count = 0;
+
+    while (size < PROGRAM_SIZE) {
+
+        uint8_t code = opcodes[next_random(random) % sizeof(opcodes)];
+        starts[start_count++] = size;
+        program[size++] = code;
+
+        if (code == 0xC5 || code == 0xE5) {
+            // POP into a different pair than the one pushed
+            program[size++] = (code == 0xC5) ? 0xD1 : 0xC1;
+        } else if (code == 0xCB) {
+            program[size++] = next_random(random);
+        } else if (code == 0x18 || code == 0x20 || code == 0x28 || code == 0x30 || code == 0x38) {
+            // Back to one of the last few instructions, or just on to the next one
+            uint16_t back = start_count - 1 - next_random(random) % 8;
+            int16_t offset = starts[back < start_count ? back : 0] - (size + 1);
+            if (offset < -128 || next_random(random) % 2) {
+                offset = 0;
+            }
+            program[size++] = (uint8_t) offset;
+        } else if (code == 0xC2 || code == 0xCA || code == 0xD2 || code == 0xDA) {
+            uint16_t target = 0xC000 + starts[next_random(random) % start_count];
+            program[size++] = target & 0xFF;
+            program[size++] = target >> 8;
+        } else if (code == 0x21) {
+            // HL always points into WRAM, past the program, for the CB opcodes on (HL)
+            uint16_t target = 0xC400 + next_random(random) % 0x1000;
+            program[size++] = target & 0xFF;
+            program[size++] = target >> 8;
+        } else {
+            for (uint8_t i = 1; i < primary_table[code].length; i++) {
+                program[size++] = next_random(random);
+            }
+        }
+    }
+
+    // JP 0xC000
+    program[size++] = 0xC3;
+    program[size++] = 0x00;
+    program[size++] = 0xC0;
+    return size;
+
+}
+
+// Put the program in WRAM and start it with these registers
+static void load_program (emu *emulator, const uint8_t *program, uint16_t size, const uint8_t *values) {
+
+    for (uint16_t i = 0; i < size; i++) {
+        write_byte(&emulator->cpu.bus, 0xC000 + i, program[i]);
+    }
+
+    registers *r = &emulator->cpu.cpu_registers;
+    r->a = values[0];
+    r->b = values[1];
+    r->c = values[2];
+    r->d = values[3];
+    r->e = values[4];
+    r->h = 0xC8;
+    r->l = values[5];
+    set_f(&emulator->cpu, values[6] & 0xF0);
+    emulator->cpu.pc = 0xC000;
+    emulator->cpu.sp = 0xDFF0;
+
+}
+
+static bool same_state (emu *a, emu *b) {
+
+    cpu *x = &a->cpu;
+    cpu *y = &b->cpu;
+    registers *r = &x->cpu_registers;
+    registers *s = &y->cpu_registers;
+
+    // F can be waiting to be worked out (see the lazy flags in flags-register.h), so it's compared resolved
+    return r->a == s->a && r->b == s->b && r->c == s->c && r->d == s->d && r->e == s->e && r->h == s->h &&
+        r->l == s->l && get_f(x) == get_f(y) &&
+        x->pc == y->pc && x->sp == y->sp && x->cycles == y->cycles &&
+        memcmp(bus_memory(&x->bus, 0xC000), bus_memory(&y->bus, 0xC000), 0x1000) == 0 &&
+        memcmp(bus_memory(&x->bus, 0xD000), bus_memory(&y->bus, 0xD000), 0x1000) == 0;
+
+}
+
+int main (void) {
+
+    // JR -2: the programs get put in WRAM and jumped to by hand
+    static const uint8_t idle[] = {0x18, 0xFE};
+    char path[TEST_ROM_PATH_SIZE];
+    if (!write_test_rom(idle, sizeof(idle), path)) {
+        printf("lockstep: couldn't write the test ROM\n");
+        return 1;
+    }
+
+    static emu together[LOCKSTEP_LANES];
+    static emu alone[LOCKSTEP_LANES];
+    emu *lanes[LOCKSTEP_LANES];
+    uint8_t program[PROGRAM_SIZE + 8];
+    uint32_t random = 0x12345678;
+    uint32_t failed = 0;
+    uint64_t lockstep_instructions = 0;
+
+    for (uint32_t run = 0; run < PROGRAMS; run++) {
+
+        uint16_t size = make_program(&random, program);
+
+        for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+
+            if (!init_emu(&together[lane], path) || !init_emu(&alone[lane], path)) {
+                printf("lockstep: couldn't load the test ROM\n");
+                remove(path);
+                return 1;
+            }
+
+            // Some lanes start out the same, so they stay together for a while
+            uint8_t values[7];
+            for (uint8_t i = 0; i < sizeof(values); i++) {
+                values[i] = (lane % 3 == 0) ? 0x11 * (i + 1) : next_random(&random);
+            }
+            load_program(&together[lane], program, size, values);
+            load_program(&alone[lane], program, size, values);
+            lanes[lane] = &together[lane];
+        }
+
+        lockstep runner;
+        init_lockstep(&runner, lanes, LOCKSTEP_LANES);
+        for (uint8_t frame = 0; frame < FRAMES; frame++) {
+            run_lockstep_frame(&runner);
+            for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+                run_frame(&alone[lane]);
+            }
+        }
+        lockstep_instructions += runner.lockstep_instructions;
+
+        for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            if (!same_state(&together[lane], &alone[lane])) {
+                printf("lockstep: program %u, lane %u came out different running alone (PC %04X, %04X alone)\n",
+                    run, lane, together[lane].cpu.pc, alone[lane].cpu.pc);
+                failed++;
+                break;
+            }
+        }
+
+        for (uint8_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            free_emu(&together[lane]);
+            free_emu(&alone[lane]);
+        }
+    }
+
+    remove(path);
+
+    // Nothing ran in lockstep at all would mean this didn't test anything
+    if (lockstep_instructions == 0) {
+        printf("lockstep: nothing ran in lockstep\n");
+        return 1;
+    }
+    if (failed > 0) {
+        return 1;
+    }
+    printf("lockstep: ok (%u programs, %llu instructions in lockstep)\n", PROGRAMS,
+        (unsigned long long) lockstep_instructions);
+    return 0;
+
+}
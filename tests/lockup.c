@@ -0,0 +1,75 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+// Local libraries
+#include "test-rom.h"
+#include "../cpu/block-cache.h"
+#include "../cpu/interrupts.h"
+#include "../cpu/memorybus.h"
+#include "../emulator/emulator.h"
+
+/* -- Lock-up test --
+    An opcode that doesn't exist locks the CPU up for good, even with interrupts on and one pending every frame.
+    Runs once on the interpreter and once with the block cache.
+*/
+
+#define FRAMES 10
+
+// Turn the VBlank interrupt on and run straight into 0xD3
+static const uint8_t lockup[] = {
+    0x3E, 0x01,             // LD A, 0x01
+    0xE0, 0xFF,             // LDH (0xFF), A
+    0xFB,                   // EI
+    0x00,                   // NOP
+    0xD3                    // (doesn't exist)
+};
+
+static bool run (const char *path, bool block_cache) {
+
+    static emu emulator;
+    if (!init_emu(&emulator, path)) {
+        printf("lockup: couldn't load the test ROM\n");
+        return false;
+    }
+    if (block_cache) {
+        enable_block_cache(&emulator.cpu);
+    }
+
+    uint16_t sp = emulator.cpu.sp;
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        run_frame(&emulator);
+    }
+
+    // Stuck right after the 0xD3, with the VBlank interrupt still waiting and nothing pushed for it
+    cpu *c = &emulator.cpu;
+    bool ok = c->locked && c->halted && c->pc == TEST_ROM_CODE + sizeof(lockup) && c->sp == sp &&
+        (*bus_memory(&c->bus, IF_ADDRESS) & 0x01) != 0;
+    if (!ok) {
+        printf("lockup: %s: the CPU got going again (PC %04X, SP %04X)\n", block_cache ? "block cache" : "interpreter",
+            c->pc, c->sp);
+    }
+
+    free_emu(&emulator);
+    return ok;
+
+}
+
+int main (void) {
+
+    char path[TEST_ROM_PATH_SIZE];
+    if (!write_test_rom(lockup, sizeof(lockup), path)) {
+        printf("lockup: couldn't write the test ROM\n");
+        return 1;
+    }
+
+    bool ok = run(path, false) && run(path, true);
+    remove(path);
+
+    if (!ok) {
+        return 1;
+    }
+    printf("lockup: ok (%u frames, with and without the block cache)\n", FRAMES);
+    return 0;
+
+}
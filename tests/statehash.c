@@ -0,0 +1,118 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+// Local libraries
+#include "test-rom.h"
+#include "../cpu/block-cache.h"
+#include "../emulator/emulator.h"
+#include "../state/savestate.h"
+#include "../state/statehash.h"
+
+/* -- State hash test --
+    The incremental state hash, kept up to date frame by frame, against one worked out from scratch on a copy of the
+    emulator every frame. Halfway through, an older state gets loaded, which changes every page at once without a
+    single write going through the bus. Runs once on the interpreter and once with the block cache.
+*/
+
+#define FRAMES 300
+#define SAVE_FRAME 60
+#define LOAD_FRAME 180
+
+// Sweeps through WRAM incrementing bytes here and there, dropping a byte into HRAM and the tile map as it goes
+static const uint8_t sweep[] = {
+    0x21, 0x00, 0xC0,       // LD HL, 0xC000
+    0x34,                   // loop: INC (HL)
+    0x7D,                   // LD A, L
+    0xC6, 0x3B,             // ADD A, 0x3B
+    0x6F,                   // LD L, A
+    0x30, 0xF9,             // JR NC, loop
+    0x24,                   // INC H
+    0xE0, 0x90,             // LDH (0x90), A
+    0xEA, 0x00, 0x98,       // LD (0x9800), A
+    0x7C,                   // LD A, H
+    0xFE, 0xE0,             // CP 0xE0
+    0x20, 0xEE,             // JR NZ, loop
+    0x26, 0xC0,             // LD H, 0xC0
+    0x18, 0xEA              // JR loop
+};
+
+// The hash of source, from scratch
+static uint64_t full_hash (emu *source) {
+
+    static emu copy;
+    state_hash hash;
+
+    clone_emu(&copy, source);
+    init_state_hash(&hash, &copy);
+    uint64_t result = update_state_hash(&hash, &copy);
+    free_state_hash(&hash, &copy);
+    free_emu(&copy);
+    return result;
+
+}
+
+static bool run (const char *path, bool block_cache) {
+
+    static emu emulator;
+    static uint8_t state[1 << 20];
+    size_t state_size = 0;
+    state_hash hash;
+    uint32_t wrong = 0;
+
+    if (!init_emu(&emulator, path)) {
+        printf("statehash: couldn't load the test ROM\n");
+        return false;
+    }
+    if (block_cache) {
+        enable_block_cache(&emulator.cpu);
+    }
+    init_state_hash(&hash, &emulator);
+
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+
+        run_frame(&emulator);
+        if (frame == SAVE_FRAME) {
+            state_size = save_state(&emulator, state, sizeof(state), false);
+        }
+        if (frame == LOAD_FRAME && !load_state(&emulator, state, state_size)) {
+            printf("statehash: couldn't load the state back\n");
+            wrong++;
+            break;
+        }
+
+        uint64_t incremental = update_state_hash(&hash, &emulator);
+        uint64_t full = full_hash(&emulator);
+        if (incremental != full) {
+            if (wrong == 0) {
+                printf("statehash: frame %u%s: %016llx kept up to date, %016llx from scratch\n", frame,
+                    block_cache ? " (block cache)" : "", (unsigned long long) incremental, (unsigned long long) full);
+            }
+            wrong++;
+        }
+    }
+
+    free_state_hash(&hash, &emulator);
+    free_emu(&emulator);
+    return wrong == 0;
+
+}
+
+int main (void) {
+
+    char path[TEST_ROM_PATH_SIZE];
+    if (!write_test_rom(sweep, sizeof(sweep), path)) {
+        printf("statehash: couldn't write the test ROM\n");
+        return 1;
+    }
+
+    bool ok = run(path, false) && run(path, true);
+    remove(path);
+
+    if (!ok) {
+        return 1;
+    }
+    printf("statehash: ok (%u frames, with and without the block cache)\n", FRAMES);
+    return 0;
+
+}
@@ -0,0 +1,47 @@
+// Standard libraries
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+// Local libraries
+#include "test-rom.h"
+#include "../cartridge/cartridge.h"
+
+bool write_test_rom (const uint8_t *code, size_t size, char *path) {
+
+    static uint8_t rom[2 * ROM_BANK_SIZE];
+
+    if (size > sizeof(rom) - TEST_ROM_CODE) {
+        return false;
+    }
+
+    // NOP, JP 0x0150
+    memset(rom, 0, sizeof(rom));
+    memcpy(rom + 0x0100, "\x00\xC3\x50\x01", 4);
+    memcpy(rom + HEADER_TITLE, "TEST", 4);
+    rom[HEADER_TYPE] = 0x00;
+    rom[HEADER_ROM_SIZE] = 0x00;
+    rom[HEADER_RAM_SIZE] = 0x00;
+    uint8_t checksum = 0;
+    for (uint16_t address = HEADER_TITLE; address < HEADER_CHECKSUM; address++) {
+        checksum = checksum - rom[address] - 1;
+    }
+    rom[HEADER_CHECKSUM] = checksum;
+    memcpy(rom + TEST_ROM_CODE, code, size);
+
+    snprintf(path, TEST_ROM_PATH_SIZE, "/tmp/gameboy-test-XXXXXX");
+    int file = mkstemp(path);
+    if (file < 0) {
+        return false;
+    }
+    bool written = write(file, rom, sizeof(rom)) == (ssize_t) sizeof(rom);
+    close(file);
+    if (!written) {
+        remove(path);
+    }
+    return written;
+
+}
@@ -0,0 +1,21 @@
+#ifndef TEST_ROM_H
+#define TEST_ROM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* -- Test ROMs --
+    The tests can't count on any games being around, so they make their own: a 32KB cartridge without a mapper (or
+    RAM), with a good header, that jumps straight to code at 0x0150.
+*/
+
+#define TEST_ROM_CODE 0x0150
+// Room for a path from write_test_rom
+#define TEST_ROM_PATH_SIZE 64
+
+// Write a ROM running code (size bytes of it) to a new file, and put its name in path. Loaded cartridges keep the
+// ROM mapped, so the file can be removed as soon as everything that needs it has loaded it
+bool write_test_rom (const uint8_t *code, size_t size, char *path);
+
+#endif
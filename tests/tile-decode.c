@@ -0,0 +1,19 @@
+// Standard libraries
+#include <stdio.h>
+// Local libraries
+#include "../ppu/tile-decode.h"
+
+/* -- Tile decoder test --
+    The vector tile decoder and palette against the scalar ones, for every tile row and palette there is.
+*/
+
+int main (void) {
+
+    if (!verify_tile_decoder()) {
+        printf("tile-decode: the vector tile decoder doesn't agree with the scalar one\n");
+        return 1;
+    }
+    printf("tile-decode: ok\n");
+    return 0;
+
+}